@@ -0,0 +1,91 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_CORE__GROUNDEDFACT_HPP_
+#define PLANSYS2_CORE__GROUNDEDFACT_HPP_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+
+#include "plansys2_core/SymbolTable.hpp"
+
+namespace plansys2
+{
+
+/// GroundedFact is the compact form of a grounded predicate or function.
+/**
+ * The name and the arguments are SymbolTable ids. Up to kInlineArgs arguments are stored
+ * inline, so most facts are compared and hashed without touching the heap. Two facts are
+ * equal if they have the same node type, name and arguments; the value of a function
+ * is not part of its identity.
+ */
+class GroundedFact
+{
+public:
+  using Id = SymbolTable::Id;
+  static constexpr std::size_t kInlineArgs = 4;
+
+  GroundedFact() = default;
+  GroundedFact(uint8_t node_type, Id name, const std::vector<Id> & args, double value = 0.0);
+
+  uint8_t getNodeType() const {return node_type_;}
+  Id getName() const {return name_;}
+  std::size_t getArity() const {return arity_;}
+  Id getArg(std::size_t i) const
+  {
+    return i < kInlineArgs ? inline_args_[i] : overflow_args_[i - kInlineArgs];
+  }
+  double getValue() const {return value_;}
+  void setValue(double value) {value_ = value;}
+
+  std::size_t hash() const;
+
+  bool operator==(const GroundedFact & other) const;
+  bool operator!=(const GroundedFact & other) const {return !(*this == other);}
+
+private:
+  uint8_t node_type_ {0};
+  uint16_t arity_ {0};
+  Id name_ {SymbolTable::npos};
+  std::array<Id, kInlineArgs> inline_args_ {};
+  std::vector<Id> overflow_args_;
+  double value_ {0.0};
+};
+
+struct GroundedFactHash
+{
+  std::size_t operator()(const GroundedFact & fact) const {return fact.hash();}
+};
+
+/// Get the compact form of a predicate or function node, interning its symbols.
+GroundedFact toGroundedFact(const plansys2_msgs::msg::Node & node);
+
+/// Get the compact form of a predicate or function node without interning anything.
+/**
+ * \param[in] node The predicate or function.
+ * \return The fact, or nothing if some of its symbols were never interned, which means
+ *   that no stored fact can be equal to it.
+ */
+std::optional<GroundedFact> findGroundedFact(const plansys2_msgs::msg::Node & node);
+
+/// Get the node of a fact. Parameters only have their names set.
+plansys2_msgs::msg::Node toNode(const GroundedFact & fact);
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_CORE__GROUNDEDFACT_HPP_
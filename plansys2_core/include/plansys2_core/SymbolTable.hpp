@@ -0,0 +1,79 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_CORE__SYMBOLTABLE_HPP_
+#define PLANSYS2_CORE__SYMBOLTABLE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace plansys2
+{
+
+/// SymbolTable maps names (instances, types, predicates, functions) to dense integer ids.
+/**
+ * There is a single table per process, so ids can be shared among the experts living in it.
+ * Symbols are never removed: an id remains valid, and keeps naming the same string, for the
+ * whole life of the process. It is safe to use from several threads.
+ */
+class SymbolTable
+{
+public:
+  using Id = uint32_t;
+  static constexpr Id npos = std::numeric_limits<Id>::max();
+
+  static SymbolTable & getInstance();
+
+  /// Get the id of a name, adding it to the table if it was not there.
+  /**
+   * \param[in] name The name to intern.
+   * \return The id of the name.
+   */
+  Id intern(const std::string & name);
+
+  /// Get the id of a name, without adding it to the table.
+  /**
+   * \param[in] name The name to look for.
+   * \return The id of the name, or nothing if it has never been interned.
+   */
+  std::optional<Id> lookup(const std::string & name) const;
+
+  /// Get the name of an id returned by intern.
+  /**
+   * \param[in] id The id of the symbol.
+   * \return The name. The reference remains valid for the life of the process.
+   */
+  const std::string & getName(Id id) const;
+
+  std::size_t size() const;
+
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable & operator=(const SymbolTable &) = delete;
+
+private:
+  SymbolTable() = default;
+
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<std::string, Id> ids_;
+  std::deque<std::string> names_;
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_CORE__SYMBOLTABLE_HPP_
@@ -0,0 +1,120 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_core/GroundedFact.hpp"
+
+#include <optional>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+
+namespace plansys2
+{
+
+GroundedFact::GroundedFact(
+  uint8_t node_type, Id name, const std::vector<Id> & args, double value)
+: node_type_(node_type),
+  arity_(static_cast<uint16_t>(args.size())),
+  name_(name),
+  value_(value)
+{
+  for (std::size_t i = 0; i < args.size(); i++) {
+    if (i < kInlineArgs) {
+      inline_args_[i] = args[i];
+    } else {
+      overflow_args_.push_back(args[i]);
+    }
+  }
+}
+
+std::size_t
+GroundedFact::hash() const
+{
+  std::size_t seed = (static_cast<std::size_t>(name_) << 8) | node_type_;
+  for (std::size_t i = 0; i < arity_; i++) {
+    seed ^= getArg(i) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+  }
+  return seed;
+}
+
+bool
+GroundedFact::operator==(const GroundedFact & other) const
+{
+  if (node_type_ != other.node_type_ || name_ != other.name_ || arity_ != other.arity_) {
+    return false;
+  }
+  for (std::size_t i = 0; i < arity_ && i < kInlineArgs; i++) {
+    if (inline_args_[i] != other.inline_args_[i]) {
+      return false;
+    }
+  }
+  return overflow_args_ == other.overflow_args_;
+}
+
+GroundedFact
+toGroundedFact(const plansys2_msgs::msg::Node & node)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  std::vector<GroundedFact::Id> args;
+  args.reserve(node.parameters.size());
+  for (const auto & param : node.parameters) {
+    args.push_back(symbols.intern(param.name));
+  }
+
+  return GroundedFact(node.node_type, symbols.intern(node.name), args, node.value);
+}
+
+std::optional<GroundedFact>
+findGroundedFact(const plansys2_msgs::msg::Node & node)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  auto name = symbols.lookup(node.name);
+  if (!name) {
+    return {};
+  }
+
+  std::vector<GroundedFact::Id> args;
+  args.reserve(node.parameters.size());
+  for (const auto & param : node.parameters) {
+    auto arg = symbols.lookup(param.name);
+    if (!arg) {
+      return {};
+    }
+    args.push_back(arg.value());
+  }
+
+  return GroundedFact(node.node_type, name.value(), args, node.value);
+}
+
+plansys2_msgs::msg::Node
+toNode(const GroundedFact & fact)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  plansys2_msgs::msg::Node node;
+  node.node_type = fact.getNodeType();
+  node.name = symbols.getName(fact.getName());
+  node.value = fact.getValue();
+  node.negate = false;
+  node.parameters.resize(fact.getArity());
+  for (std::size_t i = 0; i < fact.getArity(); i++) {
+    node.parameters[i].name = symbols.getName(fact.getArg(i));
+  }
+  return node;
+}
+
+}  // namespace plansys2
@@ -0,0 +1,77 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_core/SymbolTable.hpp"
+
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+
+namespace plansys2
+{
+
+SymbolTable &
+SymbolTable::getInstance()
+{
+  static SymbolTable instance;
+  return instance;
+}
+
+SymbolTable::Id
+SymbolTable::intern(const std::string & name)
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto inserted = ids_.emplace(name, static_cast<Id>(names_.size()));
+  if (inserted.second) {
+    names_.push_back(name);
+  }
+  return inserted.first->second;
+}
+
+std::optional<SymbolTable::Id>
+SymbolTable::lookup(const std::string & name) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = ids_.find(name);
+  if (it != ids_.end()) {
+    return it->second;
+  } else {
+    return {};
+  }
+}
+
+const std::string &
+SymbolTable::getName(Id id) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return names_.at(id);
+}
+
+std::size_t
+SymbolTable::size() const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return names_.size();
+}
+
+}  // namespace plansys2
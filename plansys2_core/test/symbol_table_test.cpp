@@ -0,0 +1,80 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_core/SymbolTable.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+
+TEST(symbol_table, intern_lookup)
+{
+  auto & symbols = plansys2::SymbolTable::getInstance();
+
+  ASSERT_FALSE(symbols.lookup("symbol_table_test_r2d2").has_value());
+
+  auto id = symbols.intern("symbol_table_test_r2d2");
+  ASSERT_EQ(symbols.intern("symbol_table_test_r2d2"), id);
+  ASSERT_EQ(symbols.lookup("symbol_table_test_r2d2").value(), id);
+  ASSERT_EQ(symbols.getName(id), "symbol_table_test_r2d2");
+
+  auto other = symbols.intern("symbol_table_test_kitchen");
+  ASSERT_NE(other, id);
+  ASSERT_EQ(symbols.getName(other), "symbol_table_test_kitchen");
+}
+
+TEST(symbol_table, grounded_fact)
+{
+  auto pred_1 = plansys2::toGroundedFact(
+    parser::pddl::fromStringPredicate("(robot_at r2d2 kitchen)"));
+  auto pred_2 = plansys2::toGroundedFact(
+    parser::pddl::fromStringPredicate("(robot_at r2d2 kitchen)"));
+  auto pred_3 = plansys2::toGroundedFact(
+    parser::pddl::fromStringPredicate("(robot_at kitchen r2d2)"));
+
+  ASSERT_EQ(pred_1, pred_2);
+  ASSERT_EQ(pred_1.hash(), pred_2.hash());
+  ASSERT_NE(pred_1, pred_3);
+  ASSERT_EQ(pred_1.getArity(), 2u);
+  ASSERT_EQ(parser::pddl::toString(plansys2::toNode(pred_1)), "(robot_at r2d2 kitchen)");
+
+  auto long_1 = plansys2::toGroundedFact(
+    parser::pddl::fromStringPredicate("(path a b c d e f)"));
+  auto long_2 = plansys2::toGroundedFact(
+    parser::pddl::fromStringPredicate("(path a b c d e g)"));
+  ASSERT_NE(long_1, long_2);
+  ASSERT_EQ(parser::pddl::toString(plansys2::toNode(long_1)), "(path a b c d e f)");
+
+  auto func_1 = parser::pddl::fromStringFunction("(= (distance wp1 wp2) 3.0)");
+  auto func_2 = parser::pddl::fromStringFunction("(= (distance wp1 wp2) 5.0)");
+  ASSERT_EQ(plansys2::toGroundedFact(func_1), plansys2::toGroundedFact(func_2));
+  ASSERT_EQ(plansys2::toGroundedFact(func_2).getValue(), 5.0);
+  ASSERT_NE(plansys2::toGroundedFact(func_1), pred_1);
+
+  ASSERT_FALSE(
+    plansys2::findGroundedFact(
+      parser::pddl::fromStringPredicate("(robot_at r2d2 symbol_table_test_nowhere)")));
+  ASSERT_EQ(
+    plansys2::findGroundedFact(
+      parser::pddl::fromStringPredicate("(robot_at r2d2 kitchen)")).value(), pred_1);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,8 +15,10 @@
 #ifndef PLANSYS2_DOMAIN_EXPERT__DOMAINEXPERT_HPP_
 #define PLANSYS2_DOMAIN_EXPERT__DOMAINEXPERT_HPP_
 
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
@@ -54,6 +56,42 @@ public:
    */
   std::vector<std::string> getTypes();
 
+  /// Determine if a type is one of the types returned by getTypes.
+  /**
+   * \param[in] type The name of the type.
+   * \return true if the type exists.
+   */
+  bool existType(const std::string & type) const;
+
+  /// Get the id of a type, to check subtypes with isSubtype without looking up the names.
+  /**
+   * The ids are valid until the domain is extended.
+   * \param[in] type The name of the type.
+   * \return The id of the type. If the type does not exist, the value returned has not value.
+   */
+  std::optional<uint32_t> getTypeId(const std::string & type) const;
+
+  /// Determine if a type is another type or one of its direct or indirect subtypes.
+  /**
+   * The subtypes of every type are computed once per domain, so this is a single bit test.
+   * \param[in] type The id of the type to check.
+   * \param[in] super_type The id of the type it should be.
+   * \return true if type is super_type or one of its subtypes.
+   */
+  bool isSubtype(uint32_t type, uint32_t super_type) const
+  {
+    return (subtypes_[super_type * subtype_words_ + type / 64] >> (type % 64)) & 1u;
+  }
+
+  /// Determine if a type is another type or one of its direct or indirect subtypes.
+  /**
+   * \param[in] type The name of the type to check.
+   * \param[in] super_type The name of the type it should be.
+   * \return true if type is super_type or one of its subtypes. false if some type does not
+   *    exist.
+   */
+  bool isSubtype(const std::string & type, const std::string & super_type) const;
+
   /// Get the predicates existing in the domain.
   /**
    * \return The vector containing the name of the predicates.
@@ -128,8 +166,17 @@ public:
   bool existDomain(const std::string & domain_name);
 
 private:
+  // Compute the subtypes of every type of domain_
+  void computeSubtypes();
+
   std::shared_ptr<parser::pddl::Domain> domain_;
   DomainReader domains_;
+
+  // Type name -> its index in domain_->types, used as its id
+  std::unordered_map<std::string, uint32_t> type_ids_;
+  // One row of subtype_words_ words per type, with the bits of the type and its subtypes set
+  std::size_t subtype_words_ {0};
+  std::vector<uint64_t> subtypes_;
 };
 
 }  // namespace plansys2
@@ -42,6 +42,38 @@ DomainExpert::extendDomain(const std::string & domain)
     std::cerr << "\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\nError parsing PDDL: " << e.what() << std::endl;
     std::cerr << "Error parsing PDDL: " << e.what() << std::endl;
   }
+
+  computeSubtypes();
+}
+
+void
+DomainExpert::computeSubtypes()
+{
+  const auto & types = domain_->types;
+
+  type_ids_.clear();
+  for (uint32_t i = 0; i < types.size(); i++) {
+    type_ids_[types[i]->name] = i;
+  }
+
+  subtype_words_ = (types.size() + 63) / 64;
+  subtypes_.assign(types.size() * subtype_words_, 0);
+
+  for (uint32_t i = 0; i < types.size(); i++) {
+    uint64_t * row = &subtypes_[i * subtype_words_];
+    std::vector<const parser::pddl::Type *> pending {types[i]};
+    while (!pending.empty()) {
+      const auto * type = pending.back();
+      pending.pop_back();
+
+      auto id = type_ids_.find(type->name);
+      if (id == type_ids_.end() || (row[id->second / 64] >> (id->second % 64)) & 1u) {
+        continue;
+      }
+      row[id->second / 64] |= uint64_t{1} << (id->second % 64);
+      pending.insert(pending.end(), type->subtypes.begin(), type->subtypes.end());
+    }
+  }
 }
 
 std::vector<std::string>
@@ -56,6 +88,32 @@ DomainExpert::getTypes()
   return ret;
 }
 
+bool
+DomainExpert::existType(const std::string & type) const
+{
+  auto id = getTypeId(type);
+  return domain_->typed && id.has_value() && id.value() > 0;
+}
+
+std::optional<uint32_t>
+DomainExpert::getTypeId(const std::string & type) const
+{
+  auto it = type_ids_.find(type);
+  if (it == type_ids_.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+bool
+DomainExpert::isSubtype(const std::string & type, const std::string & super_type) const
+{
+  auto type_id = getTypeId(type);
+  auto super_type_id = getTypeId(super_type);
+  return type_id.has_value() && super_type_id.has_value() &&
+         isSubtype(type_id.value(), super_type_id.value());
+}
+
 std::vector<plansys2::Predicate>
 DomainExpert::getPredicates()
 {
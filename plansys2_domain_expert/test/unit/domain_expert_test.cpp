@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <regex>
@@ -407,6 +408,48 @@ TEST(domain_expert, sub_types)
   }
 }
 
+TEST(domain_expert, type_hierarchy)
+{
+  std::string domain_str =
+    "(define (domain hierarchy)\n"
+    "(:requirements :typing)\n"
+    "(:types\n"
+    "  place robot - object\n"
+    "  room - place\n"
+    "  teleporter_room kitchen - room\n"
+    ")\n"
+    "(:predicates (robot_at ?r - robot ?p - place))\n"
+    ")\n";
+
+  plansys2::DomainExpert domain_expert(domain_str);
+
+  ASSERT_TRUE(domain_expert.existType("teleporter_room"));
+  ASSERT_FALSE(domain_expert.existType("garden"));
+  ASSERT_FALSE(domain_expert.getTypeId("garden").has_value());
+
+  ASSERT_TRUE(domain_expert.isSubtype("place", "place"));
+  ASSERT_TRUE(domain_expert.isSubtype("room", "place"));
+  ASSERT_TRUE(domain_expert.isSubtype("kitchen", "place"));
+  ASSERT_TRUE(domain_expert.isSubtype("teleporter_room", "room"));
+  ASSERT_FALSE(domain_expert.isSubtype("place", "room"));
+  ASSERT_FALSE(domain_expert.isSubtype("kitchen", "teleporter_room"));
+  ASSERT_FALSE(domain_expert.isSubtype("robot", "place"));
+  ASSERT_FALSE(domain_expert.isSubtype("garden", "place"));
+
+  auto kitchen = domain_expert.getTypeId("kitchen");
+  auto place = domain_expert.getTypeId("place");
+  ASSERT_TRUE(kitchen.has_value() && place.has_value());
+  ASSERT_TRUE(domain_expert.isSubtype(kitchen.value(), place.value()));
+  ASSERT_FALSE(domain_expert.isSubtype(place.value(), kitchen.value()));
+
+  auto predicate = domain_expert.getPredicate("robot_at");
+  ASSERT_TRUE(predicate.has_value());
+  auto sub_types = predicate.value().parameters[1].sub_types;
+  std::sort(sub_types.begin(), sub_types.end());
+  std::vector<std::string> expected {"kitchen", "room", "teleporter_room"};
+  ASSERT_EQ(sub_types, expected);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
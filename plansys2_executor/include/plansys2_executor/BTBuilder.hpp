@@ -27,6 +27,7 @@
 
 #include "plansys2_domain_expert/DomainExpertClient.hpp"
 #include "plansys2_problem_expert/ProblemExpertClient.hpp"
+#include "plansys2_problem_expert/State.hpp"
 #include "plansys2_executor/ActionExecutor.hpp"
 #include "plansys2_core/Types.hpp"
 #include "plansys2_msgs/msg/durative_action.hpp"
@@ -54,8 +55,15 @@ struct GraphNode
   int node_num;
   int level_num;
 
-  std::vector<plansys2::Predicate> predicates;
-  std::vector<plansys2::Function> functions;
+  plansys2::State state;
+
+  /// The predicates of state, as the member that state replaced held them. O(size of state).
+  [[deprecated("use state, or state.getPredicates()")]]
+  std::vector<plansys2::Predicate> predicates() const {return state.getPredicates();}
+
+  /// The functions of state, as the member that state replaced held them. O(size of state).
+  [[deprecated("use state, or state.getFunctions()")]]
+  std::vector<plansys2::Function> functions() const {return state.getFunctions();}
 
   std::set<GraphNode::Ptr> in_arcs;
   std::set<GraphNode::Ptr> out_arcs;
@@ -73,7 +81,9 @@ struct Graph
 class BTBuilder
 {
 public:
-  explicit BTBuilder(rclcpp::Node::SharedPtr node, const std::string & bt_action = "");
+  explicit BTBuilder(
+    rclcpp::Node::SharedPtr node, const std::string & bt_action = "",
+    const std::string & problem_context = "");
 
   Graph::Ptr get_graph(const plansys2_msgs::msg::Plan & current_plan);
   std::string get_tree(const plansys2_msgs::msg::Plan & current_plan);
@@ -94,15 +104,13 @@ protected:
 
   bool is_action_executable(
     const ActionStamped & action,
-    std::vector<plansys2::Predicate> & predicates,
-    std::vector<plansys2::Function> & functions) const;
+    plansys2::State & state) const;
   std::pair<std::string, uint8_t> get_base(
     const plansys2_msgs::msg::Tree & tree,
     uint32_t node_id = 0);
   std::list<GraphNode::Ptr> get_roots(
     std::vector<plansys2::ActionStamped> & action_sequence,
-    std::vector<plansys2::Predicate> & predicates,
-    std::vector<plansys2::Function> & functions,
+    plansys2::State & state,
     int & node_counter);
   GraphNode::Ptr get_node_satisfy(
     const plansys2_msgs::msg::Tree & requirement,
@@ -117,8 +125,7 @@ protected:
   void remove_existing_requirements(
     const plansys2_msgs::msg::Tree & tree,
     std::vector<uint32_t> & requirements,
-    std::vector<plansys2::Predicate> & predicates,
-    std::vector<plansys2::Function> & functions) const;
+    plansys2::State & state) const;
   bool is_parallelizable(
     const plansys2::ActionStamped & action,
     const std::list<GraphNode::Ptr> & ret) const;
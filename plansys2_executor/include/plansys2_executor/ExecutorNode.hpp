@@ -21,6 +21,7 @@
 #include <map>
 
 #include "plansys2_domain_expert/DomainExpertClient.hpp"
+#include "plansys2_problem_expert/CompiledTree.hpp"
 #include "plansys2_problem_expert/ProblemExpertClient.hpp"
 #include "plansys2_planner/PlannerClient.hpp"
 #include "plansys2_executor/ActionExecutor.hpp"
@@ -92,6 +93,13 @@ protected:
 
   std::optional<std::vector<plansys2_msgs::msg::Tree>> getOrderedSubGoals();
 
+  // Get the conditions and effects of a grounded action of a plan, compiled. Each action
+  // is requested to the domain expert and compiled once per plan, as the domain may change
+  // between plans
+  std::shared_ptr<const CompiledDurativeAction> getCompiledAction(const std::string & action);
+
+  std::map<std::string, std::shared_ptr<const CompiledDurativeAction>> compiled_actions_;
+
   rclcpp::Service<plansys2_msgs::srv::GetPlan>::SharedPtr get_plan_service_;
 
   rclcpp_action::GoalResponse handle_goal(
@@ -36,10 +36,12 @@ namespace plansys2
 
 BTBuilder::BTBuilder(
   rclcpp::Node::SharedPtr node,
-  const std::string & bt_action)
+  const std::string & bt_action,
+  const std::string & problem_context)
 {
   domain_client_ = std::make_shared<plansys2::DomainExpertClient>();
-  problem_client_ = std::make_shared<plansys2::ProblemExpertClient>();
+  problem_client_ = std::make_shared<plansys2::ProblemExpertClient>(
+    false, std::chrono::milliseconds(100), problem_context);
 
   if (bt_action != "") {
     bt_action_ = bt_action;
@@ -62,12 +64,11 @@ WAIT_AT_START_ACTIONS
 bool
 BTBuilder::is_action_executable(
   const ActionStamped & action,
-  std::vector<plansys2::Predicate> & predicates,
-  std::vector<plansys2::Function> & functions) const
+  plansys2::State & state) const
 {
-  return check(action.action->at_start_requirements, predicates, functions) &&
-         check(action.action->over_all_requirements, predicates, functions) &&
-         check(action.action->at_end_requirements, predicates, functions);
+  return check(action.action->at_start_requirements, state) &&
+         check(action.action->over_all_requirements, state) &&
+         check(action.action->at_end_requirements, state);
 }
 
 std::pair<std::string, uint8_t>
@@ -153,7 +154,7 @@ BTBuilder::get_node_satisfy(
       continue;
     }
 
-    if (check(requirement, node->predicates, node->functions, node_id)) {
+    if (check(requirement, node->state, node_id)) {
       ret = node;
     }
   }
@@ -164,7 +165,7 @@ BTBuilder::get_node_satisfy(
       continue;
     }
 
-    if (check(requirement, node->predicates, node->functions, node_id)) {
+    if (check(requirement, node->state, node_id)) {
       ret = node;
     }
   }
@@ -176,7 +177,7 @@ BTBuilder::get_node_satisfy(
       continue;
     }
 
-    if (check(requirement, node->predicates, node->functions, node_id)) {
+    if (check(requirement, node->state, node_id)) {
       ret = node;
     }
   }
@@ -188,7 +189,7 @@ BTBuilder::get_node_satisfy(
       continue;
     }
 
-    if (check(requirement, node->predicates, node->functions, node_id)) {
+    if (check(requirement, node->state, node_id)) {
       ret = node;
     }
   }
@@ -199,7 +200,7 @@ BTBuilder::get_node_satisfy(
       continue;
     }
 
-    if (check(requirement, node->predicates, node->functions, node_id)) {
+    if (check(requirement, node->state, node_id)) {
       ret = node;
     }
   }
@@ -265,8 +266,7 @@ BTBuilder::get_node_satisfy(
 std::list<GraphNode::Ptr>
 BTBuilder::get_roots(
   std::vector<plansys2::ActionStamped> & action_sequence,
-  std::vector<plansys2::Predicate> & predicates,
-  std::vector<plansys2::Function> & functions,
+  plansys2::State & state,
   int & node_counter)
 {
   std::list<GraphNode::Ptr> ret;
@@ -274,7 +274,7 @@ BTBuilder::get_roots(
   auto it = action_sequence.begin();
   while (it != action_sequence.end()) {
     const auto & action = *it;
-    if (is_action_executable(action, predicates, functions) && is_parallelizable(action, ret)) {
+    if (is_action_executable(action, state) && is_parallelizable(action, ret)) {
       auto new_root = GraphNode::make_shared();
       new_root->action = action;
       new_root->node_num = node_counter++;
@@ -294,12 +294,11 @@ void
 BTBuilder::remove_existing_requirements(
   const plansys2_msgs::msg::Tree & tree,
   std::vector<uint32_t> & requirements,
-  std::vector<plansys2::Predicate> & predicates,
-  std::vector<plansys2::Function> & functions) const
+  plansys2::State & state) const
 {
   auto it = requirements.begin();
   while (it != requirements.end()) {
-    if (check(tree, predicates, functions, *it)) {
+    if (check(tree, state, *it)) {
       it = requirements.erase(it);
     } else {
       ++it;
@@ -350,32 +349,24 @@ BTBuilder::get_graph(const plansys2_msgs::msg::Plan & current_plan)
   auto graph = Graph::make_shared();
 
   auto action_sequence = get_plan_actions(current_plan);
-  auto predicates = problem_client_->getPredicates();
-  auto functions = problem_client_->getFunctions();
+  const plansys2::State initial_state(
+    problem_client_->getPredicates(), problem_client_->getFunctions());
+  auto state = initial_state;
 
-  graph->roots = get_roots(action_sequence, predicates, functions, node_counter);
+  graph->roots = get_roots(action_sequence, state, node_counter);
 
   // Apply root actions
   for (auto & action_node : graph->roots) {
     // Create a local copy of the state
-    action_node->predicates = problem_client_->getPredicates();
-    action_node->functions = problem_client_->getFunctions();
+    action_node->state = initial_state;
 
     // Apply the effects to the local node state
-    apply(
-      action_node->action.action->at_start_effects,
-      action_node->predicates, action_node->functions);
-    apply(
-      action_node->action.action->at_end_effects,
-      action_node->predicates, action_node->functions);
+    apply(action_node->action.action->at_start_effects, action_node->state);
+    apply(action_node->action.action->at_end_effects, action_node->state);
 
     // Apply the effects to the global state
-    apply(
-      action_node->action.action->at_start_effects,
-      predicates, functions);
-    apply(
-      action_node->action.action->at_end_effects,
-      predicates, functions);
+    apply(action_node->action.action->at_start_effects, state);
+    apply(action_node->action.action->at_end_effects, state);
   }
 
 
@@ -420,16 +411,11 @@ BTBuilder::get_graph(const plansys2_msgs::msg::Plan & current_plan)
         node_satisfy->out_arcs.insert(new_node);
 
         // Copy the state from the parent node
-        new_node->predicates = node_satisfy->predicates;
-        new_node->functions = node_satisfy->functions;
+        new_node->state = node_satisfy->state;
 
         // Apply the effects of the new node
-        apply(
-          new_node->action.action->at_start_effects,
-          new_node->predicates, new_node->functions);
-        apply(
-          new_node->action.action->at_end_effects,
-          new_node->predicates, new_node->functions);
+        apply(new_node->action.action->at_start_effects, new_node->state);
+        apply(new_node->action.action->at_end_effects, new_node->state);
 
         it_at_start = at_start_requirements.erase(it_at_start);
       } else {
@@ -453,16 +439,11 @@ BTBuilder::get_graph(const plansys2_msgs::msg::Plan & current_plan)
         node_satisfy->out_arcs.insert(new_node);
 
         // Copy the state from the parent node
-        new_node->predicates = node_satisfy->predicates;
-        new_node->functions = node_satisfy->functions;
+        new_node->state = node_satisfy->state;
 
         // Apply the effects of the new node
-        apply(
-          new_node->action.action->at_start_effects,
-          new_node->predicates, new_node->functions);
-        apply(
-          new_node->action.action->at_end_effects,
-          new_node->predicates, new_node->functions);
+        apply(new_node->action.action->at_start_effects, new_node->state);
+        apply(new_node->action.action->at_end_effects, new_node->state);
 
         it_over_all = over_all_requirements.erase(it_over_all);
       } else {
@@ -486,16 +467,11 @@ BTBuilder::get_graph(const plansys2_msgs::msg::Plan & current_plan)
         node_satisfy->out_arcs.insert(new_node);
 
         // Copy the state from the parent node
-        new_node->predicates = node_satisfy->predicates;
-        new_node->functions = node_satisfy->functions;
+        new_node->state = node_satisfy->state;
 
         // Apply the effects of the new node
-        apply(
-          new_node->action.action->at_start_effects,
-          new_node->predicates, new_node->functions);
-        apply(
-          new_node->action.action->at_end_effects,
-          new_node->predicates, new_node->functions);
+        apply(new_node->action.action->at_start_effects, new_node->state);
+        apply(new_node->action.action->at_end_effects, new_node->state);
 
         it_at_end = at_end_requirements.erase(it_at_end);
       } else {
@@ -504,14 +480,11 @@ BTBuilder::get_graph(const plansys2_msgs::msg::Plan & current_plan)
     }
 
     remove_existing_requirements(
-      action_sequence.begin()->action->at_start_requirements, at_start_requirements, predicates,
-      functions);
+      action_sequence.begin()->action->at_start_requirements, at_start_requirements, state);
     remove_existing_requirements(
-      action_sequence.begin()->action->over_all_requirements, over_all_requirements, predicates,
-      functions);
+      action_sequence.begin()->action->over_all_requirements, over_all_requirements, state);
     remove_existing_requirements(
-      action_sequence.begin()->action->at_end_requirements, at_end_requirements, predicates,
-      functions);
+      action_sequence.begin()->action->at_end_requirements, at_end_requirements, state);
 
     for (const auto & req : at_start_requirements) {
       std::cerr << "===> [" << parser::pddl::toString(
@@ -21,11 +21,13 @@
 #include <fstream>
 #include <map>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "plansys2_executor/ExecutorNode.hpp"
 #include "plansys2_executor/ActionExecutor.hpp"
 #include "plansys2_executor/BTBuilder.hpp"
+#include "plansys2_problem_expert/HypotheticalState.hpp"
 #include "plansys2_problem_expert/Utils.hpp"
 #include "plansys2_pddl_parser/Utils.h"
 
@@ -66,6 +68,7 @@ ExecutorNode::ExecutorNode()
   this->declare_parameter<std::string>("default_action_bt_xml_filename", "");
   this->declare_parameter<bool>("enable_dotgraph_legend", true);
   this->declare_parameter<bool>("print_graph", false);
+  this->declare_parameter<std::string>("problem_context", "");
   this->declare_parameter("action_timeouts.actions", std::vector<std::string>{});
   // Declaring individual action parameters so they can be queried on the command line
   auto action_timeouts_actions = this->get_parameter("action_timeouts.actions").as_string_array();
@@ -135,7 +138,11 @@ ExecutorNode::on_configure(const rclcpp_lifecycle::State & state)
 
   aux_node_ = std::make_shared<rclcpp::Node>("executor_helper");
   domain_client_ = std::make_shared<plansys2::DomainExpertClient>();
-  problem_client_ = std::make_shared<plansys2::ProblemExpertClient>();
+  compiled_actions_.clear();
+  // Plans are executed on the knowledge of this context of the problem expert
+  problem_client_ = std::make_shared<plansys2::ProblemExpertClient>(
+    false, std::chrono::milliseconds(100),
+    this->get_parameter("problem_context").as_string());
   planner_client_ = std::make_shared<plansys2::PlannerClient>();
 
   execution_info_pub_ = create_publisher<plansys2_msgs::msg::ActionExecutionInfo>(
@@ -171,6 +178,7 @@ ExecutorNode::on_cleanup(const rclcpp_lifecycle::State & state)
 {
   RCLCPP_INFO(get_logger(), "[%s] Cleaning up...", get_name());
   dotgraph_pub_.reset();
+  compiled_actions_.clear();
   RCLCPP_INFO(get_logger(), "[%s] Cleaned up", get_name());
 
   return CallbackReturnT::SUCCESS;
@@ -217,46 +225,63 @@ ExecutorNode::getOrderedSubGoals()
   }
 
   auto goal = problem_client_->getGoal();
-  auto local_predicates = problem_client_->getPredicates();
-  auto local_functions = problem_client_->getFunctions();
+  HypotheticalState state(problem_client_->getPredicates(), problem_client_->getFunctions());
 
   std::vector<plansys2_msgs::msg::Tree> ordered_goals;
-  std::vector<uint32_t> unordered_subgoals = parser::pddl::getSubtrees(goal);
+  std::vector<std::pair<uint32_t, CompiledTree>> unordered_subgoals;
+  for (auto subgoal : parser::pddl::getSubtrees(goal)) {
+    unordered_subgoals.emplace_back(subgoal, CompiledTree(goal, subgoal));
+  }
+
+  auto move_satisfied_subgoals = [&]() {
+      for (auto it = unordered_subgoals.begin(); it != unordered_subgoals.end(); ) {
+        if (it->second.check(state)) {
+          plansys2_msgs::msg::Tree new_goal;
+          parser::pddl::fromString(
+            new_goal, "(and " + parser::pddl::toString(goal, it->first) + ")");
+          ordered_goals.push_back(new_goal);
+          it = unordered_subgoals.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    };
 
   // just in case some goals are already satisfied
-  for (auto it = unordered_subgoals.begin(); it != unordered_subgoals.end(); ) {
-    if (check(goal, local_predicates, local_functions, *it)) {
-      plansys2_msgs::msg::Tree new_goal;
-      parser::pddl::fromString(new_goal, "(and " + parser::pddl::toString(goal, (*it)) + ")");
-      ordered_goals.push_back(new_goal);
-      it = unordered_subgoals.erase(it);
-    } else {
-      ++it;
-    }
-  }
+  move_satisfied_subgoals();
 
   for (const auto & plan_item : current_plan_.value().items) {
-    std::shared_ptr<plansys2_msgs::msg::DurativeAction> action =
-      domain_client_->getDurativeAction(
-      get_action_name(plan_item.action), get_action_params(plan_item.action));
-    apply(action->at_start_effects, local_predicates, local_functions);
-    apply(action->at_end_effects, local_predicates, local_functions);
-
-    for (auto it = unordered_subgoals.begin(); it != unordered_subgoals.end(); ) {
-      if (check(goal, local_predicates, local_functions, *it)) {
-        plansys2_msgs::msg::Tree new_goal;
-        parser::pddl::fromString(new_goal, "(and " + parser::pddl::toString(goal, (*it)) + ")");
-        ordered_goals.push_back(new_goal);
-        it = unordered_subgoals.erase(it);
-      } else {
-        ++it;
-      }
+    auto action = getCompiledAction(plan_item.action);
+    if (action != nullptr) {
+      action->at_start_effects.apply(state);
+      action->at_end_effects.apply(state);
     }
+
+    move_satisfied_subgoals();
   }
 
   return ordered_goals;
 }
 
+std::shared_ptr<const CompiledDurativeAction>
+ExecutorNode::getCompiledAction(const std::string & action)
+{
+  auto expression = get_action_expression(action);
+
+  auto it = compiled_actions_.find(expression);
+  if (it == compiled_actions_.end()) {
+    std::shared_ptr<plansys2_msgs::msg::DurativeAction> durative_action =
+      domain_client_->getDurativeAction(
+      get_action_name(action), get_action_params(action));
+    if (durative_action == nullptr) {
+      return nullptr;
+    }
+    it = compiled_actions_.emplace(
+      expression, std::make_shared<CompiledDurativeAction>(*durative_action)).first;
+  }
+  return it->second;
+}
+
 void
 ExecutorNode::get_plan_service_callback(
   const std::shared_ptr<rmw_request_id_t> request_header,
@@ -305,6 +330,7 @@ ExecutorNode::execute(const std::shared_ptr<GoalHandleExecutePlan> goal_handle)
   cancel_plan_requested_ = false;
 
   current_plan_ = goal_handle->get_goal()->plan;
+  compiled_actions_.clear();
 
   if (!current_plan_.has_value()) {
     RCLCPP_ERROR(get_logger(), "No plan found");
@@ -342,7 +368,7 @@ ExecutorNode::execute(const std::shared_ptr<GoalHandleExecutePlan> goal_handle)
   }
   ordered_sub_goals_ = getOrderedSubGoals();
 
-  BTBuilder bt_builder(aux_node_, action_bt_xml_);
+  BTBuilder bt_builder(aux_node_, action_bt_xml_, problem_client_->getContext());
   auto blackboard = BT::Blackboard::create();
 
   blackboard->set("action_map", action_map);
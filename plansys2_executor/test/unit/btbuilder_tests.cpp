@@ -76,7 +76,8 @@ public:
     std::vector<plansys2::Predicate> & predicates,
     std::vector<plansys2::Function> & functions) const
   {
-    return BTBuilder::is_action_executable(action, predicates, functions);
+    plansys2::State state(predicates, functions);
+    return BTBuilder::is_action_executable(action, state);
   }
 
   plansys2::Graph::Ptr get_graph(const plansys2_msgs::msg::Plan & current_plan)
@@ -90,7 +91,8 @@ public:
     std::vector<plansys2::Function> & functions,
     int & node_counter)
   {
-    return BTBuilder::get_roots(action_sequence, predicates, functions, node_counter);
+    plansys2::State state(predicates, functions);
+    return BTBuilder::get_roots(action_sequence, state, node_counter);
   }
 
   plansys2::GraphNode::Ptr get_node_satisfy(
@@ -123,7 +125,8 @@ public:
     std::vector<plansys2::Predicate> & predicates,
     std::vector<plansys2::Function> & functions) const
   {
-    BTBuilder::remove_existing_requirements(tree, requirements, predicates, functions);
+    plansys2::State state(predicates, functions);
+    BTBuilder::remove_existing_requirements(tree, requirements, state);
   }
 };
 
@@ -519,14 +522,10 @@ TEST(btbuilder_tests, test_plan_2)
   ASSERT_EQ(roots.size(), 3u);
   // Apply roots actions
   for (auto & action_node : roots) {
-    action_node->predicates = problem_client->getPredicates();
-    action_node->functions = problem_client->getFunctions();
-    plansys2::apply(
-      action_node->action.action->at_start_effects,
-      action_node->predicates, action_node->functions);
-    plansys2::apply(
-      action_node->action.action->at_end_effects,
-      action_node->predicates, action_node->functions);
+    action_node->state = plansys2::State(
+      problem_client->getPredicates(), problem_client->getFunctions());
+    plansys2::apply(action_node->action.action->at_start_effects, action_node->state);
+    plansys2::apply(action_node->action.action->at_end_effects, action_node->state);
     plansys2::apply(
       action_node->action.action->at_start_effects,
       predicates, functions);
@@ -36,9 +36,11 @@ public:
 		return name;
 	}
 
+	// Appends the names of the direct and indirect subtypes
 	virtual void getSubTypesNames( std::vector<std::string> & typesNames) const {
-		for (Type subtype : subtypes ) {
-			typesNames.push_back(subtype.name);
+		for ( const Type * subtype : subtypes ) {
+			typesNames.push_back( subtype->name );
+			subtype->getSubTypesNames( typesNames );
 		}
 	}
 
@@ -0,0 +1,151 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__APPLICABLEACTIONTRACKER_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__APPLICABLEACTIONTRACKER_HPP_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ProblemExpertInterface.hpp"
+
+namespace plansys2
+{
+
+/// ApplicableActionTracker keeps the durative actions that can start in a problem expert.
+/**
+ * Every durative action of the domain is grounded with all the instances of the types of
+ * its parameters. The conditions an action needs to start are the conjuncts of its at start
+ * and over all requirements, and each grounded action keeps how many of them do not hold.
+ * A reverse index from each fact to the grounded actions that refer to it lets update()
+ * re-evaluate only the conjuncts changed by a delta, and the actions with no unsatisfied
+ * conjunct are kept in a list, so getting them is O(number of applicable actions).
+ *
+ * Adding an instance grounds only the actions that have it as argument, and removing one
+ * drops them. A reset delta grounds everything again. Changes to the domain are not tracked.
+ *
+ * It is not thread safe: the owner must not run it concurrently with changes to the knowledge.
+ */
+class ApplicableActionTracker
+{
+public:
+  using Id = uint64_t;
+
+  /// Create a tracker over a problem expert, which is only read, grounding all the actions.
+  ApplicableActionTracker(
+    std::shared_ptr<DomainExpert> domain_expert,
+    std::shared_ptr<ProblemExpertInterface> problem_expert);
+
+  /// Update the grounded actions and their unsatisfied conditions with a delta.
+  /**
+   * It must be called after the changes of the delta are applied to the problem expert.
+   * \param[in] delta The changes to the knowledge.
+   */
+  void update(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Get the grounded actions that can start, as "(move r2d2 wp1 wp2)", in no given order.
+  std::vector<std::string> getApplicableActions() const;
+
+  /// Get the number of unsatisfied conditions of a grounded action.
+  /**
+   * \param[in] action The grounded action, as "(move r2d2 wp1 wp2)".
+   * \return The number, or nothing if there is no such grounded action.
+   */
+  std::optional<uint32_t> getUnsatisfied(const std::string & action) const;
+
+  /// Get the number of grounded actions.
+  std::size_t size() const {return actions_.size();}
+
+  /// Get the number of conjuncts evaluated since the tracker was created.
+  uint64_t getEvaluations() const {return evaluations_;}
+
+private:
+  // A durative action of the domain, with its at start and over all requirements in a
+  // single tree whose arguments are the placeholders "?0", "?1"... of its parameters
+  struct Schema
+  {
+    std::string name;
+    std::vector<std::optional<uint32_t>> parameter_types;
+    plansys2_msgs::msg::Tree condition;
+    // Root nodes of the conjuncts of the requirements
+    std::vector<uint32_t> conjuncts;
+  };
+
+  struct GroundedAction
+  {
+    // As "(move r2d2 wp1 wp2)"
+    std::string action;
+    std::vector<std::string> arguments;
+    std::size_t schema;
+    plansys2_msgs::msg::Tree condition;
+    std::vector<bool> satisfied;
+    // Facts of the condition, with the conjunct they are in
+    std::vector<std::pair<GroundedFact, uint32_t>> facts;
+    uint32_t unsatisfied {0};
+    // Position in applicable_, if it is applicable
+    std::size_t position {0};
+  };
+
+  void groundAll();
+  void addInstance(const plansys2::Instance & instance);
+  void removeInstance(const std::string & name);
+
+  // Ground a schema with every combination of the candidates of each parameter
+  void ground(
+    std::size_t schema, const std::vector<std::vector<std::string>> & candidates);
+  void addAction(std::size_t schema, const std::vector<std::string> & arguments);
+  void removeAction(Id id);
+
+  // Get the instances that can be an argument of a given type
+  std::vector<std::string> getCandidates(std::optional<uint32_t> type) const;
+
+  bool evaluate(const plansys2_msgs::msg::Tree & condition, uint32_t node_id);
+  void setApplicable(Id id, bool applicable);
+  // Add the conjuncts that refer to the changed facts, as (grounded action, conjunct)
+  void collectDirty(
+    const std::vector<plansys2_msgs::msg::Node> & changes,
+    std::set<std::pair<Id, uint32_t>> & dirty) const;
+
+  std::shared_ptr<DomainExpert> domain_expert_;
+  std::shared_ptr<ProblemExpertInterface> problem_expert_;
+
+  std::vector<Schema> schemas_;
+  // Instance name -> type id, if the type is in the domain
+  std::map<std::string, std::optional<uint32_t>> instances_;
+
+  Id next_id_ {1};
+  std::unordered_map<Id, GroundedAction> actions_;
+  std::unordered_map<std::string, Id> actions_by_string_;
+  std::unordered_map<std::string, std::unordered_set<Id>> actions_by_instance_;
+  std::unordered_map<GroundedFact, std::unordered_set<Id>, GroundedFactHash> actions_by_fact_;
+  std::vector<Id> applicable_;
+  uint64_t evaluations_ {0};
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__APPLICABLEACTIONTRACKER_HPP_
@@ -0,0 +1,256 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__COMPILEDTREE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__COMPILEDTREE_HPP_
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "plansys2_msgs/msg/durative_action.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/GroundedFact.hpp"
+
+namespace plansys2
+{
+
+/// CompiledTree is an expression compiled to a flat program, to be evaluated many times.
+/**
+ * The nodes of the expression are compiled in post-order to an array of instructions, that
+ * an interpreter runs with a stack of values, without recursion. The facts are converted
+ * to their compact form when compiling, so evaluating a fact is a lookup of its GroundedFact
+ * in the state, without building or comparing any string. NOT nodes are resolved when
+ * compiling, by flipping the negation of the facts below them. When the expression is not
+ * applied, an AND or an OR jumps past its remaining children once its result is decided.
+ *
+ * The result is the one of plansys2::evaluate on the same expression. The program does not
+ * depend on the state, so it can be evaluated on any number of states, from any thread.
+ */
+class CompiledTree
+{
+public:
+  /// An empty program, that is the expression without nodes: true, and does nothing.
+  CompiledTree() = default;
+
+  /// Compile an expression.
+  /**
+   * \param[in] tree The expression, without variables.
+   * \param[in] node_id The root node of the expression.
+   */
+  explicit CompiledTree(const plansys2_msgs::msg::Tree & tree, uint32_t node_id = 0);
+
+  /// Evaluate the expression on a state.
+  /**
+   * The state may be a State, a HypotheticalState, or any class with the same existPredicate,
+   * addPredicate, removePredicate, getFunctionValue and setFunctionValue methods for
+   * GroundedFact.
+   * \param[in] state The state.
+   * \param[in] apply Apply the expression, as an effect, to the state.
+   * \return (success, truth value of a boolean expression, value of a numeric expression)
+   */
+  template<class StateT>
+  std::tuple<bool, bool, double> evaluate(StateT & state, bool apply = false) const;
+
+  /// Check a condition on a state.
+  template<class StateT>
+  bool check(StateT & state) const {return std::get<1>(evaluate(state, false));}
+
+  /// Apply an effect to a state.
+  /**
+   * \return false if the effect could not be applied, as when it modifies a function the
+   *   state does not have.
+   */
+  template<class StateT>
+  bool apply(StateT & state) const {return std::get<0>(evaluate(state, true));}
+
+  /// Get the number of instructions of the program.
+  std::size_t size() const {return instructions_.size();}
+
+private:
+  enum class OpCode : uint8_t
+  {
+    PREDICATE,
+    FUNCTION,
+    NUMBER,
+    AND,
+    OR,
+    SHORT_CIRCUIT,
+    EXPRESSION,
+    FUNCTION_MODIFIER,
+    INVALID
+  };
+
+  // argument is the index of the fact for PREDICATE, FUNCTION and FUNCTION_MODIFIER (the
+  // function it modifies), and the number of operands for AND, OR and SHORT_CIRCUIT, whose
+  // operands are the values of the children of its AND or OR evaluated so far. type is the
+  // expression_type or modifier_type of the node, and for SHORT_CIRCUIT whether it is in an
+  // AND. target is the instruction after the AND or OR of a SHORT_CIRCUIT
+  struct Instruction
+  {
+    OpCode op;
+    uint8_t type;
+    bool negate;
+    uint32_t argument;
+    double number;
+    uint32_t target {0};
+  };
+
+  struct Value
+  {
+    bool success;
+    bool truth;
+    double value;
+  };
+
+  static constexpr uint32_t kNoFact = UINT32_MAX;
+  static constexpr std::size_t kLocalStackSize = 32;
+
+  // Append the instructions of a node and its children. Return the stack size they need
+  std::size_t compile(const plansys2_msgs::msg::Tree & tree, uint32_t node_id, bool negate);
+  uint32_t addFact(const plansys2_msgs::msg::Node & node);
+
+  static Value computeExpression(uint8_t expression_type, const Value & l, const Value & r);
+  static Value computeModifier(uint8_t modifier_type, const Value & l, const Value & r);
+
+  std::vector<Instruction> instructions_;
+  std::vector<GroundedFact> facts_;
+  std::size_t stack_size_ {0};
+};
+
+/// The conditions and effects of a grounded durative action, compiled once to be evaluated
+/// on many states.
+struct CompiledDurativeAction
+{
+  CompiledDurativeAction() = default;
+  explicit CompiledDurativeAction(const plansys2_msgs::msg::DurativeAction & action);
+
+  CompiledTree at_start_requirements;
+  CompiledTree over_all_requirements;
+  CompiledTree at_end_requirements;
+  CompiledTree at_start_effects;
+  CompiledTree at_end_effects;
+};
+
+template<class StateT>
+std::tuple<bool, bool, double>
+CompiledTree::evaluate(StateT & state, bool apply) const
+{
+  if (instructions_.empty()) {  // No expression
+    return std::make_tuple(true, true, 0);
+  }
+
+  Value local_stack[kLocalStackSize];
+  std::vector<Value> heap_stack;
+  Value * stack = local_stack;
+  if (stack_size_ > kLocalStackSize) {
+    heap_stack.resize(stack_size_);
+    stack = heap_stack.data();
+  }
+
+  std::size_t top = 0;
+  std::size_t next = 0;
+  while (next < instructions_.size()) {
+    const auto & instruction = instructions_[next++];
+    switch (instruction.op) {
+      case OpCode::PREDICATE: {
+          const auto & fact = facts_[instruction.argument];
+          bool exist = state.existPredicate(fact);
+          if (!apply) {
+            stack[top++] = {true, instruction.negate != exist, 0};
+          } else if (instruction.negate) {
+            if (exist) {
+              state.removePredicate(fact);
+            }
+            stack[top++] = {true, false, 0};
+          } else {
+            if (!exist) {
+              state.addPredicate(fact);
+            }
+            stack[top++] = {true, true, 0};
+          }
+          break;
+        }
+
+      case OpCode::FUNCTION: {
+          auto value = state.getFunctionValue(facts_[instruction.argument]);
+          stack[top++] = {value.has_value(), false, value.value_or(0)};
+          break;
+        }
+
+      case OpCode::NUMBER:
+        stack[top++] = {true, true, instruction.number};
+        break;
+
+      case OpCode::AND:
+      case OpCode::OR: {
+          bool is_and = instruction.op == OpCode::AND;
+          Value result {true, is_and, 0};
+          for (std::size_t i = top - instruction.argument; i < top; i++) {
+            result.success = result.success && stack[i].success;
+            result.truth = is_and ? result.truth && stack[i].truth : result.truth || stack[i].truth;
+          }
+          top -= instruction.argument;
+          stack[top++] = result;
+          break;
+        }
+
+      case OpCode::SHORT_CIRCUIT: {
+          bool is_and = instruction.type;
+          if (apply || stack[top - 1].truth == is_and) {
+            break;
+          }
+          Value result {true, !is_and, 0};
+          for (std::size_t i = top - instruction.argument; i < top; i++) {
+            result.success = result.success && stack[i].success;
+          }
+          top -= instruction.argument;
+          stack[top++] = result;
+          next = instruction.target;
+          break;
+        }
+
+      case OpCode::EXPRESSION:
+        top--;
+        stack[top - 1] = computeExpression(instruction.type, stack[top - 1], stack[top]);
+        break;
+
+      case OpCode::FUNCTION_MODIFIER: {
+          top--;
+          auto result = computeModifier(instruction.type, stack[top - 1], stack[top]);
+          if (result.success && apply) {
+            if (instruction.argument == kNoFact) {
+              result.success = false;
+            } else {
+              state.setFunctionValue(facts_[instruction.argument], result.value);
+            }
+          }
+          stack[top - 1] = result;
+          break;
+        }
+
+      case OpCode::INVALID:
+        stack[top++] = {false, false, 0};
+        break;
+    }
+  }
+
+  return std::make_tuple(stack[0].success, stack[0].truth, stack[0].value);
+}
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__COMPILEDTREE_HPP_
@@ -0,0 +1,125 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__CONDITIONWATCHER_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__CONDITIONWATCHER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_problem_expert/ProblemExpertInterface.hpp"
+
+namespace plansys2
+{
+
+/// ConditionWatcher tracks the truth value of a set of conditions over a problem expert.
+/**
+ * Each watch keeps the facts (predicates and functions) its condition refers to. A reverse
+ * index from each fact to the watches that refer to it lets update() re-evaluate only the
+ * watches affected by a delta, so the cost of an update does not depend on the number of
+ * unrelated watches.
+ *
+ * A watch can have an owner, as the node that requested it, so its watches can be dropped
+ * if the owner goes away without removing them.
+ *
+ * It is not thread safe: the owner must not run it concurrently with changes to the knowledge.
+ */
+class ConditionWatcher
+{
+public:
+  using Id = uint64_t;
+
+  /// Create a watcher over a problem expert, which is only read.
+  explicit ConditionWatcher(std::shared_ptr<ProblemExpertInterface> problem_expert);
+
+  /// Start watching a condition.
+  /**
+   * \param[in] condition A condition without variables, as the preconditions of an action.
+   * \param[in] owner Who the watch belongs to. A watch without owner is never expired.
+   * \return The id of the new watch.
+   */
+  Id addWatch(const plansys2_msgs::msg::Tree & condition, const std::string & owner = "");
+
+  /// Stop watching a condition.
+  /**
+   * \return false if there is no watch with this id.
+   */
+  bool removeWatch(Id id);
+
+  /// Get the current truth value of a watched condition.
+  /**
+   * \return The value, or nothing if there is no watch with this id.
+   */
+  std::optional<bool> getValue(Id id) const;
+
+  std::size_t size() const {return watches_.size();}
+
+  /// Remove the watches whose owner is gone.
+  /**
+   * A watch is removed when its owner is missing in two consecutive calls, so an owner that
+   * has just appeared, and is not known yet by the caller, does not lose its watches.
+   * \param[in] live_owners The owners that are still alive.
+   * \return The ids of the removed watches.
+   */
+  std::vector<Id> expireWatches(const std::unordered_set<std::string> & live_owners);
+
+  /// Re-evaluate the watches that refer to the facts changed by a delta.
+  /**
+   * It must be called after the changes of the delta are applied to the problem expert.
+   * A reset delta re-evaluates all the watches.
+   * \param[in] delta The changes to the knowledge.
+   * \return The watches whose truth value has flipped, with their new value.
+   */
+  std::vector<std::pair<Id, bool>> update(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Get the number of watches re-evaluated by update() since the watcher was created.
+  uint64_t getEvaluations() const {return evaluations_;}
+
+private:
+  struct Watch
+  {
+    plansys2_msgs::msg::Tree condition;
+    std::vector<GroundedFact> facts;
+    bool value;
+    std::string owner;
+    // The owner was missing in the last call to expireWatches
+    bool owner_missing {false};
+  };
+
+  bool evaluate(const plansys2_msgs::msg::Tree & condition);
+  void collectDirty(
+    const std::vector<plansys2_msgs::msg::Node> & changes,
+    std::unordered_set<Id> & dirty) const;
+
+  std::shared_ptr<ProblemExpertInterface> problem_expert_;
+
+  Id next_id_ {1};
+  std::unordered_map<Id, Watch> watches_;
+  std::unordered_map<GroundedFact, std::unordered_set<Id>, GroundedFactHash> watches_by_fact_;
+  uint64_t evaluations_ {0};
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__CONDITIONWATCHER_HPP_
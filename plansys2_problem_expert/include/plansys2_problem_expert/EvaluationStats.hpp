@@ -0,0 +1,168 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__EVALUATIONSTATS_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__EVALUATIONSTATS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+/// EvaluationStats records how the children of AND and OR nodes evaluate, to order them.
+/**
+ * When it is passed to evaluate, every child of an AND or an OR that is checked, but not
+ * applied, is recorded by its expression: how many times it has been evaluated, how many of
+ * them it was true, and the time it took. With reordering enabled, the children of each AND
+ * or OR are then evaluated from the one with the lowest expected cost to decide the result,
+ * which is its mean time divided by the probability of being false, for an AND, or true, for
+ * an OR. Children without statistics go first, in their original order.
+ *
+ * It is not thread safe.
+ */
+class EvaluationStats
+{
+public:
+  /// Statistics of a subexpression.
+  struct Entry
+  {
+    uint64_t evaluations {0};
+    uint64_t true_count {0};
+    std::chrono::nanoseconds time {0};
+  };
+
+  /// Create the statistics, with the reordering of the children enabled or not.
+  explicit EvaluationStats(bool reorder = true);
+
+  /// Whether the children of AND and OR nodes are reordered.
+  bool getReorder() const {return reorder_;}
+  void setReorder(bool reorder) {reorder_ = reorder;}
+
+  /// Record an evaluation of a subexpression.
+  /**
+   * \param[in] key The subexpression, as a string.
+   * \param[in] value Its truth value.
+   * \param[in] time The time the evaluation took.
+   */
+  void record(const std::string & key, bool value, std::chrono::nanoseconds time);
+
+  /// Record that some children were not evaluated, as the result was already decided.
+  void recordSkipped(uint64_t count) {skipped_ += count;}
+
+  /// Get the order in which to evaluate the children of an AND or an OR.
+  /**
+   * \param[in] keys The children, as strings, in their original order.
+   * \param[in] decisive_value The value that decides the result: false for an AND, true for
+   *   an OR.
+   * \return The positions in keys, in the order to evaluate them.
+   */
+  std::vector<std::size_t> getOrder(
+    const std::vector<std::string> & keys, bool decisive_value) const;
+
+  /// Get the statistics of a subexpression, if it has been evaluated.
+  std::optional<Entry> getEntry(const std::string & key) const;
+
+  /// Get the statistics of all the subexpressions evaluated.
+  const std::unordered_map<std::string, Entry> & getEntries() const {return entries_;}
+
+  /// Number of children evaluated.
+  uint64_t getEvaluations() const {return evaluations_;}
+
+  /// Number of children not evaluated, as the result was already decided.
+  uint64_t getSkipped() const {return skipped_;}
+
+  /// Forget all the statistics and counters.
+  void reset();
+
+private:
+  // Expected time to decide the result of the parent, in nanoseconds
+  double getScore(const std::string & key, bool decisive_value) const;
+
+  bool reorder_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t evaluations_ {0};
+  uint64_t skipped_ {0};
+};
+
+/// Evaluate an AND or an OR node, from the results of its children.
+/**
+ * When the node is not applied, its children are evaluated until one decides the result.
+ * \param[in] tree The expression.
+ * \param[in] node_id The AND or OR node.
+ * \param[in] apply Whether the expression is applied.
+ * \param[in] negate Whether the node is negated.
+ * \param[in,out] stats If not null, the statistics to record the children in and order them.
+ * \param[in] evaluate_child Callable that evaluates the child with the id it gets.
+ * \return (success, truth value, 0)
+ */
+template<class EvaluateChild>
+std::tuple<bool, bool, double> evaluateAndOr(
+  const plansys2_msgs::msg::Tree & tree, uint32_t node_id, bool apply, bool negate,
+  EvaluationStats * stats, EvaluateChild evaluate_child)
+{
+  const auto & children = tree.nodes[node_id].children;
+  bool is_and = tree.nodes[node_id].node_type == plansys2_msgs::msg::Node::AND;
+  bool success = true;
+  bool truth_value = is_and;
+
+  // Effects are applied in full, so they are neither recorded nor reordered
+  bool record = stats != nullptr && !apply;
+  std::vector<std::string> keys;
+  std::vector<std::size_t> order;
+  if (record) {
+    for (auto child_id : children) {
+      keys.push_back(parser::pddl::toString(tree, child_id, negate));
+    }
+    order = stats->getOrder(keys, !is_and);
+  }
+
+  for (std::size_t i = 0; i < children.size(); i++) {
+    std::size_t child = record ? order[i] : i;
+    std::chrono::steady_clock::time_point start;
+    if (record) {
+      start = std::chrono::steady_clock::now();
+    }
+    std::tuple<bool, bool, double> result = evaluate_child(children[child]);
+    if (record) {
+      stats->record(keys[child], std::get<1>(result), std::chrono::steady_clock::now() - start);
+    }
+
+    success = success && std::get<0>(result);
+    truth_value = is_and ?
+      truth_value && std::get<1>(result) : truth_value || std::get<1>(result);
+
+    if (!apply && truth_value != is_and) {
+      if (record) {
+        stats->recordSkipped(children.size() - i - 1);
+      }
+      break;
+    }
+  }
+  return std::make_tuple(success, truth_value, 0);
+}
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__EVALUATIONSTATS_HPP_
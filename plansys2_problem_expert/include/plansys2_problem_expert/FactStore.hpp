@@ -0,0 +1,308 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__FACTSTORE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__FACTSTORE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+inline void hashCombine(std::size_t & seed, std::size_t value)
+{
+  seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+/// Hash of a grounded predicate or function: node type, name and argument names.
+/**
+ * It is consistent with parser::pddl::checkNodeEquality for PREDICATE and FUNCTION nodes.
+ */
+struct NodeHash
+{
+  std::size_t operator()(const plansys2_msgs::msg::Node & node) const
+  {
+    std::size_t seed = std::hash<uint8_t>()(node.node_type);
+    hashCombine(seed, std::hash<std::string>()(node.name));
+    for (const auto & param : node.parameters) {
+      hashCombine(seed, std::hash<std::string>()(param.name));
+    }
+    return seed;
+  }
+};
+
+struct NodeEqual
+{
+  bool operator()(
+    const plansys2_msgs::msg::Node & first,
+    const plansys2_msgs::msg::Node & second) const
+  {
+    return parser::pddl::checkNodeEquality(first, second);
+  }
+};
+
+/// Instances are identified only by their name.
+struct ParamHash
+{
+  std::size_t operator()(const plansys2_msgs::msg::Param & param) const
+  {
+    return std::hash<std::string>()(param.name);
+  }
+};
+
+struct ParamEqual
+{
+  bool operator()(
+    const plansys2_msgs::msg::Param & first,
+    const plansys2_msgs::msg::Param & second) const
+  {
+    return parser::pddl::checkParamEquality(first, second);
+  }
+};
+
+/// FactStore keeps a set of items with O(1) membership, insertion and removal.
+/**
+ * Each stored item gets an id that is stable until the item is removed. Items are kept
+ * in a doubly linked list over their slots, so iterating the store (or calling values())
+ * returns them in insertion order, exactly as the plain vectors used to do.
+ *
+ * The fields used by Hash and Equal must not be modified through operator[].
+ */
+template<class T, class Hash, class Equal>
+class FactStore
+{
+public:
+  using Id = uint32_t;
+  static constexpr Id npos = std::numeric_limits<Id>::max();
+
+  class const_iterator
+  {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator(const FactStore * store, Id id)
+    : store_(store), id_(id) {}
+
+    reference operator*() const {return store_->slots_[id_].item;}
+    pointer operator->() const {return &store_->slots_[id_].item;}
+    const_iterator & operator++() {id_ = store_->slots_[id_].next; return *this;}
+    const_iterator operator++(int) {const_iterator ret = *this; ++(*this); return ret;}
+    bool operator==(const const_iterator & other) const {return id_ == other.id_;}
+    bool operator!=(const const_iterator & other) const {return id_ != other.id_;}
+    Id id() const {return id_;}
+
+private:
+    const FactStore * store_;
+    Id id_;
+  };
+
+  FactStore() = default;
+
+  /// Get the id of a stored item.
+  /**
+   * \param[in] item The item to look for.
+   * \return The id of the item, or npos if it is not in the store.
+   */
+  Id find(const T & item) const
+  {
+    return find(item, Hash()(item));
+  }
+
+  bool contains(const T & item) const
+  {
+    return find(item) != npos;
+  }
+
+  /// Insert an item at the end of the store, if it is not already there.
+  /**
+   * \param[in] item The item to insert.
+   * \return pair(id, inserted). If the item already existed, id is the id of the stored one.
+   */
+  std::pair<Id, bool> insert(const T & item)
+  {
+    std::size_t hash = Hash()(item);
+    Id id = find(item, hash);
+    if (id != npos) {
+      return {id, false};
+    }
+
+    if (free_.empty()) {
+      id = static_cast<Id>(slots_.size());
+      slots_.push_back(Slot{item, hash, npos, npos, true});
+    } else {
+      id = free_.back();
+      free_.pop_back();
+      slots_[id] = Slot{item, hash, npos, npos, true};
+    }
+
+    linkBack(id);
+    index_.emplace(hash, id);
+    size_++;
+
+    return {id, true};
+  }
+
+  /// Remove an item from the store.
+  /**
+   * \param[in] item The item to remove.
+   * \return true if the item was in the store.
+   */
+  bool erase(const T & item)
+  {
+    Id id = find(item);
+    if (id == npos) {
+      return false;
+    }
+    erase(id);
+    return true;
+  }
+
+  void erase(Id id)
+  {
+    auto range = index_.equal_range(slots_[id].hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == id) {
+        index_.erase(it);
+        break;
+      }
+    }
+
+    unlink(id);
+    slots_[id] = Slot{T(), 0, npos, npos, false};
+    free_.push_back(id);
+    size_--;
+  }
+
+  /// Move an item to the end of the iteration order, keeping its id.
+  void moveToBack(Id id)
+  {
+    if (id != tail_) {
+      unlink(id);
+      linkBack(id);
+    }
+  }
+
+  bool alive(Id id) const {return id < slots_.size() && slots_[id].alive;}
+
+  const T & operator[](Id id) const {return slots_[id].item;}
+  T & operator[](Id id) {return slots_[id].item;}
+
+  /// Get a copy of the stored items, in insertion order.
+  std::vector<T> values() const
+  {
+    std::vector<T> ret;
+    ret.reserve(size_);
+    for (const auto & item : *this) {
+      ret.push_back(item);
+    }
+    return ret;
+  }
+
+  const_iterator begin() const {return const_iterator(this, head_);}
+  const_iterator end() const {return const_iterator(this, npos);}
+
+  std::size_t size() const {return size_;}
+  bool empty() const {return size_ == 0;}
+
+  void reserve(std::size_t size)
+  {
+    slots_.reserve(size);
+    index_.reserve(size);
+  }
+
+  void clear()
+  {
+    slots_.clear();
+    free_.clear();
+    index_.clear();
+    head_ = tail_ = npos;
+    size_ = 0;
+  }
+
+private:
+  struct Slot
+  {
+    T item;
+    std::size_t hash;
+    Id prev;
+    Id next;
+    bool alive;
+  };
+
+  Id find(const T & item, std::size_t hash) const
+  {
+    auto range = index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (Equal()(slots_[it->second].item, item)) {
+        return it->second;
+      }
+    }
+    return npos;
+  }
+
+  void linkBack(Id id)
+  {
+    slots_[id].prev = tail_;
+    slots_[id].next = npos;
+    if (tail_ != npos) {
+      slots_[tail_].next = id;
+    } else {
+      head_ = id;
+    }
+    tail_ = id;
+  }
+
+  void unlink(Id id)
+  {
+    Id prev = slots_[id].prev;
+    Id next = slots_[id].next;
+    if (prev != npos) {
+      slots_[prev].next = next;
+    } else {
+      head_ = next;
+    }
+    if (next != npos) {
+      slots_[next].prev = prev;
+    } else {
+      tail_ = prev;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<Id> free_;
+  std::unordered_multimap<std::size_t, Id> index_;
+  Id head_ {npos};
+  Id tail_ {npos};
+  std::size_t size_ {0};
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__FACTSTORE_HPP_
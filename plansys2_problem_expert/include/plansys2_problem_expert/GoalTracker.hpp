@@ -0,0 +1,77 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__GOALTRACKER_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__GOALTRACKER_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "plansys2_msgs/msg/goal_status.hpp"
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_problem_expert/ConditionWatcher.hpp"
+#include "plansys2_problem_expert/ProblemExpertInterface.hpp"
+
+namespace plansys2
+{
+
+/// GoalTracker follows the satisfaction of each subgoal of the goal of a problem expert.
+/**
+ * Each subgoal is a watch of a ConditionWatcher, so a delta only re-evaluates the subgoals
+ * that refer to the facts it changes, instead of the whole goal.
+ *
+ * It is not thread safe: the owner must not run it concurrently with changes to the knowledge.
+ */
+class GoalTracker
+{
+public:
+  /// Create a tracker over a problem expert, which is only read.
+  explicit GoalTracker(std::shared_ptr<ProblemExpertInterface> problem_expert);
+
+  /// Start tracking a goal, evaluating all its subgoals.
+  /**
+   * \param[in] goal The goal. Its subgoals are the conjuncts of its top level and, or the
+   *   whole goal if it is not a conjunction.
+   */
+  void setGoal(const plansys2::Goal & goal);
+
+  /// Update the satisfaction of the subgoals with the changes of a delta.
+  /**
+   * It must be called after the changes of the delta are applied to the problem expert.
+   * If the delta changes the goal, the new one is tracked from then on.
+   * \param[in] delta The changes to the knowledge.
+   * \return true if the goal or the satisfaction of any subgoal has changed.
+   */
+  bool update(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Whether all the subgoals are satisfied. It is false if there is no goal.
+  bool isSatisfied() const;
+
+  /// Get the subgoals split by their satisfaction. The revision is not set.
+  plansys2_msgs::msg::GoalStatus getStatus() const;
+
+private:
+  std::shared_ptr<ProblemExpertInterface> problem_expert_;
+  std::unique_ptr<ConditionWatcher> watcher_;
+
+  std::vector<plansys2_msgs::msg::Tree> subgoals_;
+  std::vector<ConditionWatcher::Id> watches_;
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__GOALTRACKER_HPP_
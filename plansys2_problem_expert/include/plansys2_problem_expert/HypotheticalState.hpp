@@ -0,0 +1,131 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__HYPOTHETICALSTATE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__HYPOTHETICALSTATE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_core/Types.hpp"
+
+namespace plansys2
+{
+
+/// HypotheticalState is a set of predicates and function values to simulate actions on.
+/**
+ * A state is a stack of layers: an immutable base, shared with the states forked from it,
+ * and an overlay with the changes made since the last fork. Forking freezes the overlay as
+ * a new layer of the base, so it is O(1) and does not copy any fact; the original and the
+ * fork then change their own overlays without seeing each other's changes. Every layer maps
+ * the facts it changes to their new value, so a lookup is a hash lookup per layer. When
+ * there are more than kMaxDepth layers, all but the bottom one, that holds the facts the
+ * state was created with, are merged into one, so that merge copies the changes made since
+ * the state was created, and not the state itself.
+ *
+ * A state is not thread safe, but states that share layers can be used from different
+ * threads, as shared layers are never modified.
+ */
+class HypotheticalState
+{
+public:
+  /// Layers kept before they are merged into one.
+  static constexpr std::size_t kMaxDepth = 16;
+
+  HypotheticalState() = default;
+
+  /// Create a state with some predicates and functions, as those of a problem.
+  HypotheticalState(
+    const std::vector<plansys2::Predicate> & predicates,
+    const std::vector<plansys2::Function> & functions);
+
+  /// Get a new state equal to this one, that changes independently of it.
+  HypotheticalState fork();
+
+  bool existPredicate(const GroundedFact & predicate) const;
+  bool existPredicate(const plansys2_msgs::msg::Node & predicate) const;
+  void addPredicate(const GroundedFact & predicate);
+  void addPredicate(const plansys2_msgs::msg::Node & predicate);
+  void removePredicate(const GroundedFact & predicate);
+  void removePredicate(const plansys2_msgs::msg::Node & predicate);
+
+  /// Get the value of a function, if the state has it.
+  std::optional<double> getFunctionValue(const GroundedFact & function) const;
+  std::optional<double> getFunctionValue(const plansys2_msgs::msg::Node & function) const;
+
+  /// Set the value of a function, adding it if the state does not have it.
+  void setFunctionValue(const GroundedFact & function, double value);
+  void setFunctionValue(const plansys2_msgs::msg::Node & function, double value);
+
+  /// Evaluate an expression on this state, as plansys2::evaluate does on vectors.
+  /**
+   * \param[in] tree The expression, without variables.
+   * \param[in] apply Apply the expression, as an effect, to this state.
+   * \param[in] node_id The root node of the expression.
+   * \param[in] negate Invert the truth value.
+   * \return (success, truth value of a boolean expression, value of a numeric expression)
+   */
+  std::tuple<bool, bool, double> evaluate(
+    const plansys2_msgs::msg::Tree & tree, bool apply = false, uint32_t node_id = 0,
+    bool negate = false);
+
+  /// Check a condition, as the preconditions of an action, on this state.
+  bool check(const plansys2_msgs::msg::Tree & tree, uint32_t node_id = 0);
+
+  /// Apply an effect of an action to this state.
+  /**
+   * \return false if the effect could not be applied, as when it modifies a function the
+   *   state does not have.
+   */
+  bool apply(const plansys2_msgs::msg::Tree & tree, uint32_t node_id = 0);
+
+  /// Get the predicates of the state. O(size of the state).
+  std::vector<plansys2::Predicate> getPredicates() const;
+
+  /// Get the functions of the state. O(size of the state).
+  std::vector<plansys2::Function> getFunctions() const;
+
+  /// Get the number of frozen layers under the overlay.
+  std::size_t getDepth() const {return base_ == nullptr ? 0 : base_->depth + 1;}
+
+private:
+  struct Layer
+  {
+    std::shared_ptr<const Layer> parent;
+    std::size_t depth {0};
+    // Changed fact -> whether it holds after the change
+    std::unordered_map<GroundedFact, bool, GroundedFactHash> predicates;
+    std::unordered_map<GroundedFact, double, GroundedFactHash> functions;
+  };
+
+  // Move the overlay to a new layer of the base, merging the layers if there are too many
+  void freeze();
+
+  // Get the layers from the top (the overlay) to the bottom
+  std::vector<const Layer *> getLayers() const;
+
+  std::shared_ptr<const Layer> base_;
+  Layer overlay_;
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__HYPOTHETICALSTATE_HPP_
@@ -0,0 +1,89 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__KNOWLEDGEREPLICA_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__KNOWLEDGEREPLICA_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_problem_expert/FactStore.hpp"
+
+namespace plansys2
+{
+
+/// KnowledgeReplica is a copy of the knowledge of a ProblemExpert, kept up to date with deltas.
+/**
+ * It does not validate anything: the changes were already validated by the ProblemExpert
+ * that generated them. It is not thread safe.
+ */
+class KnowledgeReplica
+{
+public:
+  KnowledgeReplica() = default;
+
+  /// Apply the changes of a delta, if they are the next ones for this replica.
+  /**
+   * A reset delta that holds the whole knowledge (base_revision == revision) is applied if
+   * it is newer than the replica, or of another epoch. Other deltas are applied only on top
+   * of their base revision, in the epoch of the replica.
+   * \param[in] delta The changes to apply.
+   * \return false if the delta is not the next one, so the replica needs a snapshot to resync.
+   *   Deltas older than the replica are ignored and return true.
+   */
+  bool apply(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Whether the replica has been initialized with a snapshot, and has not missed any delta.
+  bool isSynced() const {return synced_;}
+  uint64_t getRevision() const {return revision_;}
+  uint64_t getEpoch() const {return epoch_;}
+
+  std::vector<plansys2::Instance> getInstances() const;
+  std::optional<plansys2::Instance> getInstance(const std::string & name) const;
+
+  std::vector<plansys2::Predicate> getPredicates() const;
+  bool existPredicate(const plansys2::Predicate & predicate) const;
+  std::optional<plansys2::Predicate> getPredicate(const std::string & expr) const;
+
+  std::vector<plansys2::Function> getFunctions() const;
+  bool existFunction(const plansys2::Function & function) const;
+  std::optional<plansys2::Function> getFunction(const std::string & expr) const;
+  /// Get the value of a function, as a node of an expression, if the replica has it.
+  std::optional<double> getFunctionValue(const plansys2::Function & function) const;
+
+  plansys2::Goal getGoal() const {return goal_;}
+
+private:
+  void applyChanges(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  bool synced_ {false};
+  uint64_t revision_ {0};
+  uint64_t epoch_ {0};
+
+  FactStore<plansys2::Instance, ParamHash, ParamEqual> instances_;
+  FactStore<plansys2::Predicate, NodeHash, NodeEqual> predicates_;
+  FactStore<plansys2::Function, NodeHash, NodeEqual> functions_;
+  plansys2::Goal goal_;
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__KNOWLEDGEREPLICA_HPP_
@@ -0,0 +1,128 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__KNOWLEDGESTORAGE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__KNOWLEDGESTORAGE_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+
+namespace plansys2
+{
+
+/// KnowledgeStorage keeps the knowledge of a ProblemExpert on disk.
+/**
+ * The storage is a directory with two files:
+ *  - knowledge.snapshot: the whole knowledge at some revision.
+ *  - knowledge.wal: the deltas applied after that snapshot, appended as they happen.
+ *
+ * Both use the same binary encoding of KnowledgeDelta. Each record of the log is checksummed,
+ * so a record torn by a crash is detected, and the log is replayed up to the last good one.
+ * writeSnapshot() compacts the storage: the log is started again from the new snapshot.
+ *
+ * All the methods are thread safe.
+ */
+class KnowledgeStorage
+{
+public:
+  /// When appended deltas are flushed to the disk.
+  enum class Durability
+  {
+    NONE,    // Left to the operating system
+    BATCH,   // At most every sync_period, and in sync()
+    ALWAYS   // Before append() returns
+  };
+
+  /// Create a storage in a directory, which is created if it does not exist.
+  /**
+   * \param[in] directory The directory of the storage files.
+   * \param[in] durability When the appended deltas are flushed to the disk.
+   * \param[in] sync_period Maximum time between flushes with Durability::BATCH.
+   */
+  KnowledgeStorage(
+    const std::string & directory,
+    Durability durability = Durability::BATCH,
+    std::chrono::nanoseconds sync_period = std::chrono::milliseconds(100));
+  ~KnowledgeStorage();
+
+  KnowledgeStorage(const KnowledgeStorage &) = delete;
+  KnowledgeStorage & operator=(const KnowledgeStorage &) = delete;
+
+  /// Get the Durability named durability_str ("none", "batch" or "always").
+  static std::optional<Durability> getDurability(const std::string & durability_str);
+
+  /// Whether the storage has a snapshot to load.
+  bool exists() const;
+
+  /// Load the stored knowledge: the snapshot, and then the deltas of the log.
+  /**
+   * \param[in] problem_expert The problem expert where the knowledge is loaded.
+   * \return false if there is no valid snapshot or it could not be loaded.
+   */
+  bool load(ProblemExpert & problem_expert);
+
+  /// Append a delta to the log.
+  /**
+   * \param[in] delta A delta from ProblemExpert::takeDelta.
+   * \return false if the delta could not be written.
+   */
+  bool append(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Replace the stored knowledge with a snapshot, and start an empty log after it.
+  /**
+   * \param[in] snapshot A snapshot from ProblemExpert::getSnapshot.
+   * \return false if the snapshot could not be written. The previous storage is kept then.
+   */
+  bool writeSnapshot(const plansys2_msgs::msg::KnowledgeDelta & snapshot);
+
+  /// Flush to the disk the deltas appended since the last flush.
+  void sync();
+
+  /// Get the number of deltas in the log.
+  std::size_t getLogSize() const;
+
+  /// Encode a delta in the binary format of the storage.
+  static std::string encode(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
+  /// Decode a delta encoded with encode().
+  /**
+   * \return The delta, or nothing if data is not a valid encoding.
+   */
+  static std::optional<plansys2_msgs::msg::KnowledgeDelta> decode(const std::string & data);
+
+private:
+  bool openLog(uint64_t base_revision);
+  void syncLocked();
+
+  std::string directory_;
+  Durability durability_;
+  std::chrono::nanoseconds sync_period_;
+
+  mutable std::mutex mutex_;
+  int log_fd_ {-1};
+  std::size_t log_size_ {0};
+  bool pending_sync_ {false};
+  std::chrono::steady_clock::time_point last_sync_;
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__KNOWLEDGESTORAGE_HPP_
@@ -15,25 +15,44 @@
 #ifndef PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERT_HPP_
 #define PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERT_HPP_
 
+#include <functional>
 #include <optional>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
 #include "plansys2_msgs/msg/node.hpp"
 #include "plansys2_msgs/msg/param.hpp"
 #include "plansys2_msgs/msg/tree.hpp"
 
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_core/SymbolTable.hpp"
+#include "plansys2_pddl_parser/Domain.h"
 #include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/FactStore.hpp"
 #include "plansys2_problem_expert/ProblemExpertInterface.hpp"
 #include "plansys2_domain_expert/DomainExpert.hpp"
 
 namespace plansys2
 {
 
+/// ProblemExpert keeps the instances, predicates, functions and goal of the problem.
+/**
+ * The methods that do not change the knowledge can be called concurrently from several
+ * threads. Methods that change it must not run at the same time as any other method.
+ */
 class ProblemExpert : public ProblemExpertInterface
 {
 public:
+  /// Immutable copy of a set of items. It does not change when the knowledge changes.
+  template<class T>
+  using Snapshot = std::shared_ptr<const std::vector<T>>;
+
   explicit ProblemExpert(std::shared_ptr<DomainExpert> & domain_expert);
 
   std::vector<plansys2::Instance> getInstances();
@@ -47,6 +66,24 @@ public:
   bool existPredicate(const plansys2::Predicate & predicate);
   std::optional<plansys2::Predicate> getPredicate(const std::string & expr);
 
+  /// Get the predicates that match a pattern.
+  /**
+   * Arguments of the pattern whose name starts with '?' are unbound and match any instance.
+   * An unbound argument that appears more than once has to match the same instance in all
+   * its positions. The other arguments have to match exactly. The matches are found from
+   * the index of the most selective bound argument, without scanning all the predicates.
+   * They are sorted in an order that does not change while the knowledge does not change,
+   * so the pages of a query are consistent if the revision is the same.
+   * \param[in] pattern The predicate to match.
+   * \param[in] offset Number of matches to skip.
+   * \param[in] max_results Maximum number of matches to return. 0 returns all of them.
+   * \param[out] total If not null, the number of matches of the pattern, in all pages.
+   * \return The matches from offset on.
+   */
+  std::vector<plansys2::Predicate> queryPredicates(
+    const plansys2::Predicate & pattern, std::size_t offset = 0, std::size_t max_results = 0,
+    std::size_t * total = nullptr);
+
   std::vector<plansys2::Function> getFunctions();
   bool addFunction(const plansys2::Function & function);
   bool removeFunction(const plansys2::Function & function);
@@ -61,29 +98,206 @@ public:
   bool clearGoal();
   bool clearKnowledge();
 
+  /// Apply a set of changes as a single transaction.
+  /**
+   * Every change is validated against the state the knowledge would have after the update
+   * before anything is modified, so either all of them are applied or none is.
+   * \param[in] update The changes to apply.
+   * \return true if the update was valid and has been applied.
+   */
+  bool updateKnowledge(const KnowledgeUpdate & update);
+
+  /// Apply an effect without variables as a single transaction.
+  /**
+   * The changes of the effect are staged on top of the knowledge, and then committed with
+   * updateKnowledge, so nothing changes if the effect or any of its changes is not valid.
+   * \param[in] tree The effect.
+   * \param[in] node_id The root node of the effect.
+   * \return (success, truth value, value), as plansys2::evaluate.
+   */
+  std::tuple<bool, bool, double> applyEffect(
+    const plansys2_msgs::msg::Tree & tree, uint32_t node_id = 0);
+
   std::string getProblem();
   bool addProblem(const std::string & problem_str);
 
+  /// Add many instances and already grounded facts at once.
+  /**
+   * Everything is validated before anything is added, so either all of it is added or
+   * nothing is. The argument types of a predicate or function are looked up in the domain
+   * once per name, instead of once per fact as addPredicate and addFunction do.
+   * Facts that already exist are skipped, and existing functions get the new value.
+   * \param[in] instances The instances to add. None of them may exist already.
+   * \param[in] predicates The predicates to add, which may refer to the new instances.
+   * \param[in] functions The functions to add, which may refer to the new instances.
+   * \return true if everything was valid and has been added.
+   */
+  bool addFacts(
+    const std::vector<plansys2::Instance> & instances,
+    const std::vector<GroundedFact> & predicates,
+    const std::vector<GroundedFact> & functions);
+
+  /// Set the values of existing functions, without the validation of updateFunction.
+  /**
+   * Meant for numeric fluents updated at a high rate: each function is a lookup of its id
+   * and a store of its value in the slot of that id. Functions that do not exist are skipped.
+   * \param[in] functions The functions, with their new values.
+   * \return The number of functions whose value has changed.
+   */
+  std::size_t setFunctionValues(const std::vector<GroundedFact> & functions);
+
+  /// Get the revision of the knowledge. Every change to the knowledge increases it.
+  uint64_t getRevision() const {return revision_;}
+
+  /// Start or stop recording the changes made to the knowledge.
+  void setDeltaTracking(bool enabled);
+
+  /// Get the changes recorded since the previous call, and start a new record.
+  /**
+   * \return The changes from the revision of the previous call to the current one.
+   */
+  plansys2_msgs::msg::KnowledgeDelta takeDelta();
+
+  /// Get the whole knowledge as a reset delta at the current revision.
+  plansys2_msgs::msg::KnowledgeDelta getSnapshot();
+
+  /// Apply the changes of a delta from takeDelta or getSnapshot.
+  /**
+   * A delta lists as removed the items that were added and removed again after its base
+   * revision. Removals of items that do not exist are ignored for that reason.
+   * \param[in] delta The changes to apply.
+   * \return false if some item could not be added.
+   */
+  bool applyDelta(const plansys2_msgs::msg::KnowledgeDelta & delta);
+
   bool existInstance(const std::string & name);
   bool isValidType(const std::string & type);
   bool isValidPredicate(const plansys2::Predicate & predicate);
   bool isValidFunction(const plansys2::Function & function);
   bool isValidGoal(const plansys2::Goal & goal);
 
+  /// Get the instances, predicates or functions as an immutable snapshot.
+  /**
+   * The snapshot is built by the first call after a change, and shared by the next calls
+   * until the knowledge changes again, so reading an unchanged knowledge is O(1) and does
+   * not copy anything. A change creates a new snapshot and leaves the old ones untouched.
+   */
+  Snapshot<plansys2::Instance> getInstancesSnapshot();
+  Snapshot<plansys2::Predicate> getPredicatesSnapshot();
+  Snapshot<plansys2::Function> getFunctionsSnapshot();
+
 private:
+  using PredicateStore = FactStore<GroundedFact, GroundedFactHash, std::equal_to<GroundedFact>>;
+  using FunctionStore = FactStore<GroundedFact, GroundedFactHash, std::equal_to<GroundedFact>>;
+  // Posting lists: instance symbol -> ids of the facts that have it as argument
+  using InstanceReferences =
+    std::unordered_map<SymbolTable::Id, std::unordered_set<uint32_t>>;
+
+  // A predicate name, an argument position and the instance in that position
+  struct ArgumentKey
+  {
+    SymbolTable::Id name;
+    uint32_t position;
+    SymbolTable::Id value;
+
+    bool operator==(const ArgumentKey & other) const
+    {
+      return name == other.name && position == other.position && value == other.value;
+    }
+  };
+
+  struct ArgumentKeyHash
+  {
+    std::size_t operator()(const ArgumentKey & key) const
+    {
+      std::size_t seed = std::hash<SymbolTable::Id>()(key.name);
+      hashCombine(seed, std::hash<uint32_t>()(key.position));
+      hashCombine(seed, std::hash<SymbolTable::Id>()(key.value));
+      return seed;
+    }
+  };
+
+  // Add or remove a stored predicate from the indexes
+  void indexPredicate(const GroundedFact & predicate, PredicateStore::Id id);
+  void unindexPredicate(const GroundedFact & predicate, PredicateStore::Id id);
+
   bool checkPredicateTreeTypes(
     const plansys2_msgs::msg::Tree & tree,
     std::shared_ptr<DomainExpert> & domain_expert_,
     uint8_t node_id = 0);
 
+  // Add facts already validated. Existing predicates are skipped, existing functions updated
+  void insertFacts(
+    const std::vector<plansys2::Instance> & instances,
+    const std::vector<GroundedFact> & predicates,
+    const std::vector<GroundedFact> & functions);
+
+  // Get the type of an instance, if it exists
+  std::optional<std::string> getInstanceType(SymbolTable::Id name);
+
   bool removeFunctionsReferencing(const plansys2_msgs::msg::Param & param);
   bool removePredicatesReferencing(const plansys2_msgs::msg::Param & param);
 
-  std::vector<plansys2::Instance> instances_;
-  std::vector<plansys2::Predicate> predicates_;
-  std::vector<plansys2::Function> functions_;
+  /// Get the node of a stored fact, with the types of its arguments set from the instances.
+  plansys2_msgs::msg::Node fromGroundedFact(const GroundedFact & fact);
+
+  /// Get the domain of domain_expert_ parsed, parsing it again only if it has changed.
+  std::shared_ptr<parser::pddl::Domain> getParsedDomain();
+
+  // Each change increases the revision and, if tracking is enabled, is recorded as the
+  // net effect on the changed item, so recording is O(1) whatever the number of changes
+  void recordInstance(const plansys2::Instance & instance, bool added);
+  void recordPredicate(const GroundedFact & predicate, bool added);
+  void recordFunction(const GroundedFact & function, bool added);
+  void recordGoal();
+  void recordReset();
+
+  FactStore<plansys2::Instance, ParamHash, ParamEqual> instances_;
+  PredicateStore predicates_;
+  FunctionStore functions_;
+  InstanceReferences predicate_references_;
+  // Ids of the predicates of each name, and of each name with each instance in each position
+  std::unordered_map<SymbolTable::Id, std::unordered_set<uint32_t>> predicates_by_name_;
+  std::unordered_map<ArgumentKey, std::unordered_set<uint32_t>, ArgumentKeyHash>
+  predicates_by_argument_;
+  InstanceReferences function_references_;
   plansys2::Goal goal_;
 
+  // Reset by every change of the items they contain. Concurrent readers build them
+  // under snapshot_mutex_
+  std::mutex snapshot_mutex_;
+  Snapshot<plansys2::Instance> instances_snapshot_;
+  Snapshot<plansys2::Predicate> predicates_snapshot_;
+  Snapshot<plansys2::Function> functions_snapshot_;
+
+  // Sections of the text of getProblem(), kept until a change of their content. Added
+  // predicates are appended to their section, and changed functions invalidate only their
+  // own line, so a call after a few changes formats only the changed facts
+  std::mutex problem_text_mutex_;
+  std::string parsed_domain_str_;
+  std::shared_ptr<parser::pddl::Domain> parsed_domain_;
+  std::optional<std::string> objects_text_;
+  std::optional<std::string> predicates_text_;
+  std::optional<std::string> functions_text_;
+  std::optional<std::string> goal_text_;
+  std::unordered_map<GroundedFact, std::string, GroundedFactHash> function_lines_;
+
+  struct InstanceChange
+  {
+    bool removed {false};
+    std::optional<plansys2::Instance> added;
+  };
+
+  uint64_t revision_ {0};
+  bool delta_tracking_ {false};
+  uint64_t delta_base_revision_ {0};
+  bool delta_reset_ {false};
+  bool delta_goal_changed_ {false};
+  std::unordered_map<std::string, InstanceChange> instance_changes_;
+  // Changed fact -> whether it exists after the change
+  std::unordered_map<GroundedFact, bool, GroundedFactHash> predicate_changes_;
+  std::unordered_map<GroundedFact, bool, GroundedFactHash> function_changes_;
+
   std::shared_ptr<DomainExpert> domain_expert_;
 };
 
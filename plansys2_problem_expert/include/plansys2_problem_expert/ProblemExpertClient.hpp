@@ -15,21 +15,33 @@
 #ifndef PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERTCLIENT_HPP_
 #define PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERTCLIENT_HPP_
 
+#include <chrono>
+#include <condition_variable>
 #include <optional>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include "plansys2_problem_expert/KnowledgeReplica.hpp"
 #include "plansys2_problem_expert/ProblemExpertInterface.hpp"
 #include "plansys2_core/Types.hpp"
 
+#include "plansys2_msgs/msg/function_updates.hpp"
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
 #include "plansys2_msgs/msg/node.hpp"
 #include "plansys2_msgs/msg/param.hpp"
 #include "plansys2_msgs/msg/tree.hpp"
 #include "plansys2_msgs/srv/add_problem.hpp"
 #include "plansys2_msgs/srv/add_problem_goal.hpp"
+#include "plansys2_msgs/srv/add_watch.hpp"
 #include "plansys2_msgs/srv/affect_node.hpp"
 #include "plansys2_msgs/srv/affect_param.hpp"
+#include "plansys2_msgs/srv/evaluate_tree.hpp"
+#include "plansys2_msgs/srv/get_applicable_actions.hpp"
 #include "plansys2_msgs/srv/exist_node.hpp"
+#include "plansys2_msgs/srv/get_knowledge_snapshot.hpp"
 #include "plansys2_msgs/srv/get_problem.hpp"
 #include "plansys2_msgs/srv/get_problem_goal.hpp"
 #include "plansys2_msgs/srv/get_problem_instance_details.hpp"
@@ -37,8 +49,11 @@
 #include "plansys2_msgs/srv/get_node_details.hpp"
 #include "plansys2_msgs/srv/get_states.hpp"
 #include "plansys2_msgs/srv/is_problem_goal_satisfied.hpp"
+#include "plansys2_msgs/srv/query_predicates.hpp"
 #include "plansys2_msgs/srv/remove_problem_goal.hpp"
+#include "plansys2_msgs/srv/remove_watch.hpp"
 #include "plansys2_msgs/srv/clear_problem_knowledge.hpp"
+#include "plansys2_msgs/srv/update_knowledge.hpp"
 
 #include "rclcpp/rclcpp.hpp"
 
@@ -48,7 +63,27 @@ namespace plansys2
 class ProblemExpertClient : public ProblemExpertInterface
 {
 public:
-  ProblemExpertClient();
+  /// Create a client of the problem expert.
+  /**
+   * In cached mode, the client keeps a replica of the knowledge, updated in background
+   * from problem_expert/knowledge_delta, and answers instance, predicate, function and goal
+   * queries from it. Writes are always sent to the problem expert. A read issued after a
+   * write of this client waits up to cache_timeout for the replica to reach the revision
+   * of that write; if it does not, or the replica is not synced, the read is sent to the
+   * problem expert.
+   * All the requests of the client go to one problem context of the problem expert.
+   * \param[in] use_cache Enable the cached mode.
+   * \param[in] cache_timeout Maximum time a read waits for the replica.
+   * \param[in] context The problem context. "" is the default one.
+   */
+  explicit ProblemExpertClient(
+    bool use_cache = false,
+    std::chrono::nanoseconds cache_timeout = std::chrono::milliseconds(100),
+    const std::string & context = "");
+  ~ProblemExpertClient();
+
+  /// Get the problem context the requests of this client go to.
+  const std::string & getContext() const {return context_;}
 
   std::vector<plansys2::Instance> getInstances();
   bool addInstance(const plansys2::Instance & instance);
@@ -61,6 +96,19 @@ public:
   bool existPredicate(const plansys2::Predicate & predicate);
   std::optional<plansys2::Predicate> getPredicate(const std::string & predicate);
 
+  /// Get the predicates that match a pattern, as ProblemExpert::queryPredicates.
+  /**
+   * The query is always sent to the problem expert, which has indexes to answer it.
+   * \param[in] pattern The predicate to match, as "(robot_at ?r wp1)".
+   * \param[in] offset Number of matches to skip.
+   * \param[in] max_results Maximum number of matches to return. 0 returns all of them.
+   * \param[out] total If not null, the number of matches of the pattern, in all pages.
+   * \return The matches from offset on.
+   */
+  std::vector<plansys2::Predicate> queryPredicates(
+    const plansys2::Predicate & pattern, std::size_t offset = 0, std::size_t max_results = 0,
+    std::size_t * total = nullptr);
+
   std::vector<plansys2::Function> getFunctions();
   bool addFunction(const plansys2::Function & function);
   bool removeFunction(const plansys2::Function & function);
@@ -68,6 +116,15 @@ public:
   bool updateFunction(const plansys2::Function & function);
   std::optional<plansys2::Function> getFunction(const std::string & function);
 
+  /// Send new values of existing functions, without waiting for them to be applied.
+  /**
+   * Meant for numeric fluents that change at a high rate. The values are published in
+   * problem_expert/function_updates, and the problem expert applies the last value of each
+   * function once per function_updates_period. Unlike updateFunction, nothing is reported
+   * back: values of functions that do not exist are ignored.
+   */
+  void publishFunctions(const std::vector<plansys2::Function> & functions);
+
   plansys2::Goal getGoal();
   bool setGoal(const plansys2::Goal & goal);
   bool isGoalSatisfied(const plansys2::Goal & goal);
@@ -75,10 +132,65 @@ public:
   bool clearGoal();
   bool clearKnowledge();
 
+  /// Apply a set of changes in a single request. Either all of them are applied or none.
+  bool updateKnowledge(const KnowledgeUpdate & update);
+
+  bool addInstances(const std::vector<plansys2::Instance> & instances);
+  bool removeInstances(const std::vector<plansys2::Instance> & instances);
+  bool addPredicates(const std::vector<plansys2::Predicate> & predicates);
+  bool removePredicates(const std::vector<plansys2::Predicate> & predicates);
+  bool addFunctions(const std::vector<plansys2::Function> & functions);
+  bool removeFunctions(const std::vector<plansys2::Function> & functions);
+
   std::string getProblem();
   bool addProblem(const std::string & problem_str);
 
+  /// Evaluate or apply a whole expression in the problem expert, in a single request.
+  /**
+   * The result is the one of plansys2::evaluate on the problem expert, but the leaves are
+   * evaluated by the problem expert, without a request per predicate or function, and
+   * no other change of the knowledge is interleaved with them.
+   * In cached mode, an expression that is not applied is evaluated on the replica when it
+   * can serve reads, with no request at all.
+   * \param[in] tree The expression, without variables.
+   * \param[in] apply Apply the expression, as an effect, to the knowledge.
+   * \param[in] node_id The root node of the expression.
+   * \return (success, truth value of a boolean expression, value of a numeric expression)
+   */
+  std::tuple<bool, bool, double> evaluate(
+    const plansys2_msgs::msg::Tree & tree, bool apply = false, uint32_t node_id = 0);
+
+  /// Ask the problem expert to watch a condition.
+  /**
+   * Each time the truth value of the condition changes, a plansys2_msgs::msg::WatchEvent
+   * with the id of the watch is published in problem_expert/watch_events. The watch belongs
+   * to the node of this client, whose name is unique, and is removed if that node goes away.
+   * \param[in] condition A condition without variables.
+   * \param[out] value If not null, the truth value of the condition when the watch is added.
+   * \return The id of the watch, or nothing if it could not be added.
+   */
+  std::optional<uint64_t> addWatch(
+    const plansys2_msgs::msg::Tree & condition, bool * value = nullptr);
+
+  /// Stop watching a condition added with addWatch.
+  bool removeWatch(uint64_t id);
+
+  /// Get the grounded durative actions that can start now.
+  /**
+   * The problem expert keeps, for each grounded action, the number of conditions of its
+   * at start and over all requirements that do not hold, so the answer does not require
+   * grounding and checking every action.
+   * \return The actions, as "(move r2d2 wp1 wp2)", in no given order.
+   */
+  std::vector<std::string> getApplicableActions();
+
 private:
+  // Get a lock on the replica if the read can be served by it, or an empty lock if not
+  std::shared_lock<std::shared_mutex> acquireCache();
+  void updateMinCacheRevision(uint64_t epoch, uint64_t revision);
+  void knowledgeDeltaCallback(const plansys2_msgs::msg::KnowledgeDelta::SharedPtr msg);
+  void requestSnapshot();
+
   rclcpp::Client<plansys2_msgs::srv::AddProblem>::SharedPtr
     add_problem_client_;
   rclcpp::Client<plansys2_msgs::srv::AddProblemGoal>::SharedPtr
@@ -99,6 +211,8 @@ private:
     get_problem_predicate_details_client_;
   rclcpp::Client<plansys2_msgs::srv::GetStates>::SharedPtr
     get_problem_predicates_client_;
+  rclcpp::Client<plansys2_msgs::srv::QueryPredicates>::SharedPtr
+    query_predicates_client_;
   rclcpp::Client<plansys2_msgs::srv::GetNodeDetails>::SharedPtr
     get_problem_function_details_client_;
   rclcpp::Client<plansys2_msgs::srv::GetStates>::SharedPtr
@@ -121,9 +235,56 @@ private:
     exist_problem_function_client_;
   rclcpp::Client<plansys2_msgs::srv::AffectNode>::SharedPtr
     update_problem_function_client_;
+  rclcpp::Client<plansys2_msgs::srv::EvaluateTree>::SharedPtr evaluate_client_;
+  rclcpp::Client<plansys2_msgs::srv::EvaluateTree>::SharedPtr apply_client_;
   rclcpp::Client<plansys2_msgs::srv::IsProblemGoalSatisfied>::SharedPtr
     is_problem_goal_satisfied_client_;
+  rclcpp::Client<plansys2_msgs::srv::AddWatch>::SharedPtr
+    add_watch_client_;
+  rclcpp::Client<plansys2_msgs::srv::RemoveWatch>::SharedPtr
+    remove_watch_client_;
+  rclcpp::Client<plansys2_msgs::srv::GetApplicableActions>::SharedPtr
+    get_applicable_actions_client_;
+  rclcpp::Client<plansys2_msgs::srv::UpdateKnowledge>::SharedPtr
+    update_knowledge_client_;
   rclcpp::Node::SharedPtr node_;
+  rclcpp::Publisher<plansys2_msgs::msg::FunctionUpdates>::SharedPtr function_updates_pub_;
+  std::string context_;
+
+  // Last results of the full queries, only requested again if the revision changed
+  std::vector<plansys2::Predicate> last_predicates_;
+  uint64_t last_predicates_revision_ {0};
+  uint64_t last_predicates_epoch_ {0};
+  std::vector<plansys2::Function> last_functions_;
+  uint64_t last_functions_revision_ {0};
+  uint64_t last_functions_epoch_ {0};
+  std::string last_problem_;
+  uint64_t last_problem_revision_ {0};
+  uint64_t last_problem_epoch_ {0};
+
+  bool use_cache_;
+  std::chrono::nanoseconds cache_timeout_;
+  KnowledgeReplica replica_;
+  std::shared_mutex cache_mutex_;
+  std::condition_variable_any cache_cond_;
+  // Revision of the last write of this client, guarded by cache_mutex_. An epoch of 0 means
+  // no write yet
+  uint64_t min_cache_epoch_ {0};
+  uint64_t min_cache_revision_ {0};
+  // Snapshot request waiting for its response. It is sent again if the response does not
+  // arrive in time, as it is lost if the problem expert restarts meanwhile
+  bool snapshot_pending_ {false};
+  uint64_t snapshot_request_id_ {0};
+  std::chrono::steady_clock::time_point snapshot_request_time_;
+
+  // The replica is updated from its own node, spun in cache_thread_
+  rclcpp::Node::SharedPtr cache_node_;
+  rclcpp::executors::SingleThreadedExecutor::SharedPtr cache_executor_;
+  std::thread cache_thread_;
+  rclcpp::Subscription<plansys2_msgs::msg::KnowledgeDelta>::SharedPtr knowledge_delta_sub_;
+  rclcpp::Client<plansys2_msgs::srv::GetKnowledgeSnapshot>::SharedPtr
+    get_knowledge_snapshot_client_;
+  rclcpp::TimerBase::SharedPtr snapshot_timer_;
 };
 
 }  // namespace plansys2
@@ -27,6 +27,20 @@
 namespace plansys2
 {
 
+/// A set of changes to the knowledge, applied all at once by updateKnowledge.
+/**
+ * Removals are applied before additions, so a fact can be replaced in a single update.
+ */
+struct KnowledgeUpdate
+{
+  std::vector<plansys2::Instance> add_instances;
+  std::vector<plansys2::Predicate> add_predicates;
+  std::vector<plansys2::Function> add_functions;
+  std::vector<plansys2::Instance> remove_instances;
+  std::vector<plansys2::Predicate> remove_predicates;
+  std::vector<plansys2::Function> remove_functions;
+};
+
 class ProblemExpertInterface
 {
 public:
@@ -56,6 +70,7 @@ public:
 
   virtual bool clearGoal() = 0;
   virtual bool clearKnowledge() = 0;
+  virtual bool updateKnowledge(const KnowledgeUpdate & update) = 0;
 
   virtual std::string getProblem() = 0;
   virtual bool addProblem(const std::string & problem_str) = 0;
@@ -15,29 +15,52 @@
 #ifndef PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERTNODE_HPP_
 #define PLANSYS2_PROBLEM_EXPERT__PROBLEMEXPERTNODE_HPP_
 
+#include <atomic>
+#include <map>
 #include <memory>
-
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "plansys2_problem_expert/ApplicableActionTracker.hpp"
+#include "plansys2_problem_expert/ConditionWatcher.hpp"
+#include "plansys2_problem_expert/GoalTracker.hpp"
+#include "plansys2_problem_expert/KnowledgeStorage.hpp"
 #include "plansys2_problem_expert/ProblemExpert.hpp"
 
 #include "std_msgs/msg/string.hpp"
 #include "std_msgs/msg/empty.hpp"
 #include "lifecycle_msgs/msg/state.hpp"
 #include "lifecycle_msgs/msg/transition.hpp"
+#include "plansys2_msgs/msg/function_updates.hpp"
+#include "plansys2_msgs/msg/goal_status.hpp"
 #include "plansys2_msgs/msg/knowledge.hpp"
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/watch_event.hpp"
+#include "plansys2_msgs/srv/affect_context.hpp"
 #include "plansys2_msgs/srv/affect_node.hpp"
 #include "plansys2_msgs/srv/affect_param.hpp"
 #include "plansys2_msgs/srv/add_problem.hpp"
 #include "plansys2_msgs/srv/add_problem_goal.hpp"
+#include "plansys2_msgs/srv/add_watch.hpp"
+#include "plansys2_msgs/srv/evaluate_tree.hpp"
 #include "plansys2_msgs/srv/exist_node.hpp"
+#include "plansys2_msgs/srv/get_applicable_actions.hpp"
+#include "plansys2_msgs/srv/get_knowledge_snapshot.hpp"
 #include "plansys2_msgs/srv/get_problem.hpp"
+#include "plansys2_msgs/srv/get_problem_contexts.hpp"
 #include "plansys2_msgs/srv/get_problem_goal.hpp"
 #include "plansys2_msgs/srv/get_problem_instance_details.hpp"
 #include "plansys2_msgs/srv/get_problem_instances.hpp"
 #include "plansys2_msgs/srv/get_node_details.hpp"
 #include "plansys2_msgs/srv/get_states.hpp"
 #include "plansys2_msgs/srv/is_problem_goal_satisfied.hpp"
+#include "plansys2_msgs/srv/query_predicates.hpp"
 #include "plansys2_msgs/srv/remove_problem_goal.hpp"
+#include "plansys2_msgs/srv/remove_watch.hpp"
 #include "plansys2_msgs/srv/clear_problem_knowledge.hpp"
+#include "plansys2_msgs/srv/update_knowledge.hpp"
 
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
@@ -60,7 +83,12 @@ public:
   CallbackReturnT on_shutdown(const rclcpp_lifecycle::State & state);
   CallbackReturnT on_error(const rclcpp_lifecycle::State & state);
 
-  plansys2_msgs::msg::Knowledge::SharedPtr get_knowledge_as_msg() const;
+  /// Get the whole knowledge of a problem context.
+  /**
+   * \return The knowledge, or nullptr if there is no such context.
+   */
+  plansys2_msgs::msg::Knowledge::SharedPtr get_knowledge_as_msg(
+    const std::string & context = "") const;
 
   void add_problem_service_callback(
     const std::shared_ptr<rmw_request_id_t> request_header,
@@ -112,6 +140,11 @@ public:
     const std::shared_ptr<plansys2_msgs::srv::GetStates::Request> request,
     const std::shared_ptr<plansys2_msgs::srv::GetStates::Response> response);
 
+  void query_predicates_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::QueryPredicates::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::QueryPredicates::Response> response);
+
   void get_problem_function_details_service_callback(
     const std::shared_ptr<rmw_request_id_t> request_header,
     const std::shared_ptr<plansys2_msgs::srv::GetNodeDetails::Request> request,
@@ -167,13 +200,120 @@ public:
     const std::shared_ptr<plansys2_msgs::srv::ExistNode::Request> request,
     const std::shared_ptr<plansys2_msgs::srv::ExistNode::Response> response);
 
+  void evaluate_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Response> response);
+
+  void apply_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Response> response);
+
   void update_problem_function_service_callback(
     const std::shared_ptr<rmw_request_id_t> request_header,
     const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
     const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response);
 
+  void update_knowledge_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::UpdateKnowledge::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::UpdateKnowledge::Response> response);
+
+  void get_knowledge_snapshot_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::GetKnowledgeSnapshot::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::GetKnowledgeSnapshot::Response> response);
+
+  void add_watch_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::AddWatch::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::AddWatch::Response> response);
+
+  void remove_watch_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::RemoveWatch::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::RemoveWatch::Response> response);
+
+  void get_applicable_actions_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::GetApplicableActions::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::GetApplicableActions::Response> response);
+
+  void add_problem_context_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::AffectContext::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::AffectContext::Response> response);
+
+  void remove_problem_context_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::AffectContext::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::AffectContext::Response> response);
+
+  void get_problem_contexts_service_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<plansys2_msgs::srv::GetProblemContexts::Request> request,
+    const std::shared_ptr<plansys2_msgs::srv::GetProblemContexts::Response> response);
+
 private:
-  std::shared_ptr<ProblemExpert> problem_expert_;
+  /// A problem hosted by this node. All of them share the domain and the symbol table.
+  struct ProblemContext
+  {
+    std::string id;
+    // Epoch of the revisions of problem_expert
+    uint64_t epoch {0};
+    std::shared_ptr<ProblemExpert> problem_expert;
+    std::shared_ptr<ConditionWatcher> watcher;
+    std::shared_ptr<GoalTracker> goal_tracker;
+    // Created by the first request of the applicable actions, as it grounds all of them
+    std::shared_ptr<ApplicableActionTracker> action_tracker;
+  };
+
+  /// Create a problem context that tracks the changes of a problem expert.
+  /**
+   * \param[in] id The id of the context.
+   * \param[in] problem_expert The problem, already loaded.
+   * \return The context, not yet added to contexts_.
+   */
+  std::shared_ptr<ProblemContext> create_context(
+    const std::string & id, std::shared_ptr<ProblemExpert> problem_expert);
+
+  /// Get a problem context. problem_mutex_ must be held.
+  /**
+   * \param[in] id The id of the context.
+   * \param[out] error_info Why there is no context, if there is none.
+   * \return The context, or nullptr if the node is not configured or it does not exist.
+   */
+  std::shared_ptr<ProblemContext> get_context(const std::string & id, std::string & error_info);
+
+  /// Notify a change: update notification, delta, flipped watches, goal status if it changed
+  /// and, if enabled, the whole knowledge. The applicable actions are updated too.
+  void publish_knowledge_update(ProblemContext & context);
+
+  /// Publish the satisfaction of the current goal of a context.
+  void publish_goal_status(ProblemContext & context);
+
+  /// Keep the values of a message of problem_expert/function_updates, or apply them.
+  void function_updates_callback(const plansys2_msgs::msg::FunctionUpdates::SharedPtr msg);
+
+  /// Apply the function values kept since the previous call, as a single update.
+  void apply_function_updates();
+
+  /// Remove the watches of the nodes that have left the ROS graph, as crashed ones.
+  void expire_watches();
+
+  /// Create the storage from the persistence_* parameters, if persistence_dir is set.
+  bool configure_storage();
+
+  std::shared_ptr<DomainExpert> domain_expert_;
+  // Sorted by id, so the default context "" is the first one
+  std::map<std::string, std::shared_ptr<ProblemContext>> contexts_;
+  bool publish_knowledge_ {true};
+
+  // Queries take it shared, updates (and changes to contexts_) exclusive
+  std::shared_mutex problem_mutex_;
+  rclcpp::CallbackGroup::SharedPtr read_callback_group_;
+  rclcpp::CallbackGroup::SharedPtr write_callback_group_;
 
   rclcpp::Service<plansys2_msgs::srv::AddProblem>::SharedPtr
     add_problem_service_;
@@ -195,6 +335,8 @@ private:
     get_problem_predicate_details_service_;
   rclcpp::Service<plansys2_msgs::srv::GetStates>::SharedPtr
     get_problem_predicates_service_;
+  rclcpp::Service<plansys2_msgs::srv::QueryPredicates>::SharedPtr
+    query_predicates_service_;
   rclcpp::Service<plansys2_msgs::srv::GetNodeDetails>::SharedPtr
     get_problem_function_details_service_;
   rclcpp::Service<plansys2_msgs::srv::GetStates>::SharedPtr
@@ -217,11 +359,48 @@ private:
     exist_problem_predicate_service_;
   rclcpp::Service<plansys2_msgs::srv::ExistNode>::SharedPtr
     exist_problem_function_service_;
+  rclcpp::Service<plansys2_msgs::srv::EvaluateTree>::SharedPtr evaluate_service_;
+  rclcpp::Service<plansys2_msgs::srv::EvaluateTree>::SharedPtr apply_service_;
   rclcpp::Service<plansys2_msgs::srv::AffectNode>::SharedPtr
     update_problem_function_service_;
+  rclcpp::Service<plansys2_msgs::srv::UpdateKnowledge>::SharedPtr
+    update_knowledge_service_;
+  rclcpp::Service<plansys2_msgs::srv::GetKnowledgeSnapshot>::SharedPtr
+    get_knowledge_snapshot_service_;
+  rclcpp::Service<plansys2_msgs::srv::AddWatch>::SharedPtr add_watch_service_;
+  rclcpp::Service<plansys2_msgs::srv::RemoveWatch>::SharedPtr remove_watch_service_;
+  rclcpp::Service<plansys2_msgs::srv::GetApplicableActions>::SharedPtr
+    get_applicable_actions_service_;
+  rclcpp::Service<plansys2_msgs::srv::AffectContext>::SharedPtr add_problem_context_service_;
+  rclcpp::Service<plansys2_msgs::srv::AffectContext>::SharedPtr
+    remove_problem_context_service_;
+  rclcpp::Service<plansys2_msgs::srv::GetProblemContexts>::SharedPtr
+    get_problem_contexts_service_;
 
   rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Empty>::SharedPtr update_pub_;
   rclcpp_lifecycle::LifecyclePublisher<plansys2_msgs::msg::Knowledge>::SharedPtr knowledge_pub_;
+  rclcpp_lifecycle::LifecyclePublisher<plansys2_msgs::msg::KnowledgeDelta>::SharedPtr
+    knowledge_delta_pub_;
+  rclcpp_lifecycle::LifecyclePublisher<plansys2_msgs::msg::WatchEvent>::SharedPtr watch_pub_;
+  rclcpp_lifecycle::LifecyclePublisher<plansys2_msgs::msg::GoalStatus>::SharedPtr
+    goal_status_pub_;
+  rclcpp::TimerBase::SharedPtr snapshot_timer_;
+  rclcpp::TimerBase::SharedPtr watch_expiration_timer_;
+
+  // Function values received and not applied yet. Only the last value of each one is kept
+  rclcpp::Subscription<plansys2_msgs::msg::FunctionUpdates>::SharedPtr function_updates_sub_;
+  rclcpp::TimerBase::SharedPtr function_updates_timer_;
+  // The subscription callback may run while the node is deactivating, so it checks these
+  // flags instead of the timer
+  std::atomic<bool> accepting_function_updates_ {false};
+  std::atomic<bool> batch_function_updates_ {false};
+  std::mutex pending_functions_mutex_;
+  std::map<std::string, std::unordered_map<GroundedFact, double, GroundedFactHash>>
+  pending_functions_;
+
+  std::shared_ptr<KnowledgeStorage> storage_;
+  rclcpp::TimerBase::SharedPtr storage_sync_timer_;
+  rclcpp::TimerBase::SharedPtr storage_snapshot_timer_;
 };
 
 }  // namespace plansys2
@@ -0,0 +1,59 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__PROBLEMSTATEFILE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__PROBLEMSTATEFILE_HPP_
+
+#include <string>
+
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+
+namespace plansys2
+{
+
+/// ProblemStateFile reads and writes problems in a binary format that loads without parsing.
+/**
+ * The file has a fixed size header followed by flat arrays: the symbols (names of instances,
+ * types, predicates and functions) as offsets into a block of characters, the values of the
+ * functions, the instances and the facts as symbol indices, and the goal as PDDL text.
+ * Loading maps the file in memory, interns each symbol once and adds everything to the
+ * problem in a single ProblemExpert::addFacts call, so it takes a fraction of the time
+ * of parsing the same problem in PDDL.
+ *
+ * Numbers are in host byte order. A file with another version of the format is rejected.
+ */
+class ProblemStateFile
+{
+public:
+  /// Write the knowledge of a problem expert.
+  /**
+   * \param[in] path The file to write.
+   * \param[in] problem_expert The problem expert whose instances, facts and goal are written.
+   * \return false if the file could not be written.
+   */
+  static bool write(const std::string & path, ProblemExpert & problem_expert);
+
+  /// Add the knowledge of a file to a problem expert.
+  /**
+   * \param[in] path The file to load.
+   * \param[in] problem_expert The problem expert where the knowledge is added.
+   * \return false if the file is not a valid problem state, or its content is not valid in
+   *   the domain of the problem expert. Nothing is added then, unless only the goal is invalid.
+   */
+  static bool load(const std::string & path, ProblemExpert & problem_expert);
+};
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__PROBLEMSTATEFILE_HPP_
@@ -0,0 +1,272 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLANSYS2_PROBLEM_EXPERT__STATE_HPP_
+#define PLANSYS2_PROBLEM_EXPERT__STATE_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/EvaluationStats.hpp"
+#include "plansys2_problem_expert/FactStore.hpp"
+
+namespace plansys2
+{
+
+/// State is a set of predicates and function values to evaluate expressions on.
+/**
+ * Predicates are kept in a FactStore of their compact form, so checking, adding or removing
+ * one is O(1), and they are iterated in insertion order, as the vectors of predicates used
+ * to be. Functions are a hash map from their compact form to their value, so getting or
+ * setting one is O(1) too. Evaluating an expression on a state is then O(size of the
+ * expression), whatever the size of the state, where the vectors take O(size of the
+ * expression * size of the state).
+ *
+ * Copying a state copies all its facts. HypotheticalState is the one to use to simulate
+ * many actions from a common state.
+ */
+class State
+{
+public:
+  State() = default;
+
+  /// Create a state with some predicates and functions, as those of a problem. O(size).
+  State(
+    const std::vector<plansys2::Predicate> & predicates,
+    const std::vector<plansys2::Function> & functions);
+
+  bool existPredicate(const GroundedFact & predicate) const;
+  bool existPredicate(const plansys2_msgs::msg::Node & predicate) const;
+  void addPredicate(const GroundedFact & predicate);
+  void addPredicate(const plansys2_msgs::msg::Node & predicate);
+  void removePredicate(const GroundedFact & predicate);
+  void removePredicate(const plansys2_msgs::msg::Node & predicate);
+
+  /// Get the value of a function, if the state has it.
+  std::optional<double> getFunctionValue(const GroundedFact & function) const;
+  std::optional<double> getFunctionValue(const plansys2_msgs::msg::Node & function) const;
+
+  /// Set the value of a function, adding it if the state does not have it.
+  void setFunctionValue(const GroundedFact & function, double value);
+  void setFunctionValue(const plansys2_msgs::msg::Node & function, double value);
+
+  /// Get the predicates, in insertion order. Parameters only have their names set.
+  std::vector<plansys2::Predicate> getPredicates() const;
+
+  /// Get the functions. Parameters only have their names set.
+  std::vector<plansys2::Function> getFunctions() const;
+
+  std::size_t getNumPredicates() const {return predicates_.size();}
+  std::size_t getNumFunctions() const {return functions_.size();}
+
+private:
+  FactStore<GroundedFact, GroundedFactHash, std::equal_to<GroundedFact>> predicates_;
+  std::unordered_map<GroundedFact, double, GroundedFactHash> functions_;
+};
+
+/// Check that an expression can be evaluated.
+/**
+ * The nodes reached from node_id must exist, must not be their own descendants, and each
+ * NOT must have one child and each EXPRESSION and FUNCTION_MODIFIER two. An empty tree is
+ * valid, as it is no expression. O(size of the expression).
+ *
+ * \param[in] tree The expression, as received from a client.
+ * \param[in] node_id The root node of the expression.
+ * \param[out] error If not null, why the expression is not valid.
+ * \return true if the expression can be evaluated
+ */
+bool isValidTree(
+  const plansys2_msgs::msg::Tree & tree, uint32_t node_id = 0, std::string * error = nullptr);
+
+namespace detail
+{
+
+// The recursion of evaluateInState, on an expression already validated
+template<class StateT>
+std::tuple<bool, bool, double> evaluateNode(
+  const plansys2_msgs::msg::Tree & tree, StateT & state, bool apply, uint32_t node_id,
+  bool negate, EvaluationStats * stats)
+{
+  const auto & node = tree.nodes[node_id];
+  switch (node.node_type) {
+    case plansys2_msgs::msg::Node::AND:
+    case plansys2_msgs::msg::Node::OR:
+      return evaluateAndOr(
+        tree, node_id, apply, negate, stats, [&](uint32_t child_id) {
+          return evaluateNode(tree, state, apply, child_id, negate, stats);
+        });
+
+    case plansys2_msgs::msg::Node::NOT:
+      return evaluateNode(tree, state, apply, node.children[0], !negate, stats);
+
+    case plansys2_msgs::msg::Node::PREDICATE: {
+        if (apply) {
+          if (negate) {
+            state.removePredicate(node);
+            return std::make_tuple(true, false, 0);
+          } else {
+            state.addPredicate(node);
+            return std::make_tuple(true, true, 0);
+          }
+        }
+        return std::make_tuple(true, negate ^ state.existPredicate(node), 0);
+      }
+
+    case plansys2_msgs::msg::Node::FUNCTION: {
+        auto value = state.getFunctionValue(node);
+        return std::make_tuple(value.has_value(), false, value.value_or(0));
+      }
+
+    case plansys2_msgs::msg::Node::EXPRESSION: {
+        auto left = evaluateNode(tree, state, apply, node.children[0], negate, stats);
+        auto right = evaluateNode(tree, state, apply, node.children[1], negate, stats);
+
+        if (!std::get<0>(left) || !std::get<0>(right)) {
+          return std::make_tuple(false, false, 0);
+        }
+
+        double l = std::get<2>(left);
+        double r = std::get<2>(right);
+        switch (node.expression_type) {
+          case plansys2_msgs::msg::Node::COMP_GE:
+            return std::make_tuple(true, l >= r, 0);
+          case plansys2_msgs::msg::Node::COMP_GT:
+            return std::make_tuple(true, l > r, 0);
+          case plansys2_msgs::msg::Node::COMP_LE:
+            return std::make_tuple(true, l <= r, 0);
+          case plansys2_msgs::msg::Node::COMP_LT:
+            return std::make_tuple(true, l < r, 0);
+          case plansys2_msgs::msg::Node::ARITH_MULT:
+            return std::make_tuple(true, false, l * r);
+          case plansys2_msgs::msg::Node::ARITH_DIV:
+            // Division by zero not allowed.
+            if (std::abs(r) > 1e-5) {
+              return std::make_tuple(true, false, l / r);
+            }
+            return std::make_tuple(false, false, 0);
+          case plansys2_msgs::msg::Node::ARITH_ADD:
+            return std::make_tuple(true, false, l + r);
+          case plansys2_msgs::msg::Node::ARITH_SUB:
+            return std::make_tuple(true, false, l - r);
+          default:
+            break;
+        }
+
+        return std::make_tuple(false, false, 0);
+      }
+
+    case plansys2_msgs::msg::Node::FUNCTION_MODIFIER: {
+        auto left = evaluateNode(tree, state, apply, node.children[0], negate, stats);
+        auto right = evaluateNode(tree, state, apply, node.children[1], negate, stats);
+
+        if (!std::get<0>(left) || !std::get<0>(right)) {
+          return std::make_tuple(false, false, 0);
+        }
+
+        double l = std::get<2>(left);
+        double r = std::get<2>(right);
+        double value = 0;
+        switch (node.modifier_type) {
+          case plansys2_msgs::msg::Node::ASSIGN:
+            value = r;
+            break;
+          case plansys2_msgs::msg::Node::INCREASE:
+            value = l + r;
+            break;
+          case plansys2_msgs::msg::Node::DECREASE:
+            value = l - r;
+            break;
+          case plansys2_msgs::msg::Node::SCALE_UP:
+            value = l * r;
+            break;
+          case plansys2_msgs::msg::Node::SCALE_DOWN:
+            // Division by zero not allowed.
+            if (std::abs(r) <= 1e-5) {
+              return std::make_tuple(false, false, 0);
+            }
+            value = l / r;
+            break;
+          default:
+            return std::make_tuple(false, false, 0);
+        }
+
+        if (apply) {
+          const auto & modified = tree.nodes[node.children[0]];
+          if (modified.node_type != plansys2_msgs::msg::Node::FUNCTION) {
+            return std::make_tuple(false, false, value);
+          }
+          // The function has been evaluated, so it exists
+          state.setFunctionValue(modified, value);
+        }
+        return std::make_tuple(true, false, value);
+      }
+
+    case plansys2_msgs::msg::Node::NUMBER:
+      return std::make_tuple(true, true, node.value);
+
+    default:
+      std::cerr << "evaluate: Error parsing expresion [" <<
+        parser::pddl::toString(tree, node_id) << "]" << std::endl;
+  }
+
+  return std::make_tuple(false, false, 0);
+}
+
+}  // namespace detail
+
+/// Evaluate an expression on a state, as plansys2::evaluate does.
+/**
+ * \param[in] tree The expression, without variables.
+ * \param[in,out] state A State, a HypotheticalState or any class with their existPredicate,
+ *   addPredicate, removePredicate, getFunctionValue and setFunctionValue methods for nodes.
+ * \param[in] apply Apply the expression, as an effect, to the state.
+ * \param[in] node_id The root node of the expression.
+ * \param[in] negate Invert the truth value.
+ * \param[in,out] stats If not null, the statistics of the children of AND and OR nodes.
+ * \return (success, truth value of a boolean expression, value of a numeric expression)
+ */
+template<class StateT>
+std::tuple<bool, bool, double> evaluateInState(
+  const plansys2_msgs::msg::Tree & tree, StateT & state, bool apply = false,
+  uint32_t node_id = 0, bool negate = false, EvaluationStats * stats = nullptr)
+{
+  if (tree.nodes.empty()) {  // No expression
+    return std::make_tuple(true, true, 0);
+  }
+
+  std::string error;
+  if (!isValidTree(tree, node_id, &error)) {
+    std::cerr << "evaluate: Invalid expression: " << error << std::endl;
+    return std::make_tuple(false, false, 0);
+  }
+
+  return detail::evaluateNode(tree, state, apply, node_id, negate, stats);
+}
+
+}  // namespace plansys2
+
+#endif  // PLANSYS2_PROBLEM_EXPERT__STATE_HPP_
@@ -23,7 +23,9 @@
 #include <set>
 #include <utility>
 
+#include "plansys2_problem_expert/EvaluationStats.hpp"
 #include "plansys2_problem_expert/ProblemExpertClient.hpp"
+#include "plansys2_problem_expert/State.hpp"
 #include "plansys2_domain_expert/DomainExpertClient.hpp"
 #include "plansys2_msgs/msg/tree.hpp"
 
@@ -33,27 +35,40 @@ namespace plansys2
 /// Evaluate a PDDL expression represented as a tree.
 /**
  * \param[in] node The root node of the PDDL expression.
- * \param[in] problem_client The problem expert client.
+ * \param[in] problem_client The problem expert, or a client of it.
  * \param[in] predicates Current predicates state.
  * \param[in] functions Current functions state.
  * \param[in] apply Apply result to problem expert or state.
- * \param[in] use_state Use state representation or problem client.
+ * \param[in] use_state Use state representation or problem client. Each fact of the
+ *   expression is searched in the vectors, in O(size of the state), so a caller that
+ *   evaluates many expressions on the same facts should keep them in a State.
  * \param[in] negate Invert the truth value.
+ * \param[in,out] stats If not null, statistics of the children of AND and OR nodes, which
+ *   are recorded and, if its reordering is enabled, used to choose the order to check them.
  * \return result <- tuple(bool, bool, double)
  *         result(0) true if success
  *         result(1) truth value of boolen expression
  *         result(2) value of numeric expression
+ *
+ * When the expression is not applied, an AND or an OR does not evaluate the children that
+ * follow the first one that decides its result. A failure of those children is not reported.
  */
 std::tuple<bool, bool, double> evaluate(
   const plansys2_msgs::msg::Tree & tree,
-  std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
+  std::shared_ptr<plansys2::ProblemExpertInterface> problem_client,
   std::vector<plansys2::Predicate> & predicates,
   std::vector<plansys2::Function> & functions,
   bool apply = false,
   bool use_state = false,
-  uint8_t node_id = 0,
-  bool negate = false);
+  uint32_t node_id = 0,
+  bool negate = false,
+  EvaluationStats * stats = nullptr);
 
+/// Evaluate a PDDL expression in the problem expert, in a single request.
+/**
+ * The whole expression is sent to the problem expert, that evaluates or applies it at
+ * once. See ProblemExpertClient::evaluate.
+ */
 std::tuple<bool, bool, double> evaluate(
   const plansys2_msgs::msg::Tree & tree,
   std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
@@ -67,6 +82,22 @@ std::tuple<bool, bool, double> evaluate(
   bool apply = false,
   uint32_t node_id = 0);
 
+/// Evaluate a PDDL expression on a state, in O(size of the expression).
+/**
+ * \param[in] tree The PDDL expression.
+ * \param[in,out] state The state, that is changed if the expression is applied.
+ * \param[in] apply Apply the expression to the state.
+ * \param[in] node_id The root node of the expression.
+ * \param[in,out] stats If not null, statistics of the children of AND and OR nodes.
+ * \return (success, truth value of a boolean expression, value of a numeric expression)
+ */
+std::tuple<bool, bool, double> evaluate(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  bool apply = false,
+  uint32_t node_id = 0,
+  EvaluationStats * stats = nullptr);
+
 /// Check a PDDL expression represented as a tree.
 /**
 * \param[in] node The root node of the PDDL expression.
@@ -86,6 +117,11 @@ bool check(
   std::vector<plansys2::Function> & functions,
   uint32_t node_id = 0);
 
+bool check(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  uint32_t node_id = 0);
+
 /// Apply a PDDL expression represented as a tree.
 /**
  * \param[in] node The root node of the PDDL expression.
@@ -105,6 +141,11 @@ bool apply(
   std::vector<plansys2::Function> & functions,
   uint32_t node_id = 0);
 
+bool apply(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  uint32_t node_id = 0);
+
 /// Parse the action expression and time (optional) from an input string.
 /**
 * \param[in] input The input string.
@@ -0,0 +1,433 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/ApplicableActionTracker.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/Utils.hpp"
+
+namespace plansys2
+{
+
+ApplicableActionTracker::ApplicableActionTracker(
+  std::shared_ptr<DomainExpert> domain_expert,
+  std::shared_ptr<ProblemExpertInterface> problem_expert)
+: domain_expert_(domain_expert),
+  problem_expert_(problem_expert)
+{
+  for (const auto & name : domain_expert_->getDurativeActions()) {
+    auto lifted = domain_expert_->getDurativeAction(name);
+
+    std::vector<std::string> placeholders;
+    for (std::size_t i = 0; i < lifted->parameters.size(); i++) {
+      placeholders.push_back("?" + std::to_string(i));
+    }
+    auto action = domain_expert_->getDurativeAction(name, placeholders);
+
+    Schema schema;
+    schema.name = name;
+    for (const auto & param : action->parameters) {
+      schema.parameter_types.push_back(domain_expert_->getTypeId(param.type));
+    }
+
+    std::vector<plansys2_msgs::msg::Tree> requirements;
+    for (const auto & tree : {action->at_start_requirements, action->over_all_requirements}) {
+      if (!tree.nodes.empty()) {
+        requirements.push_back(tree);
+      }
+    }
+
+    if (!requirements.empty()) {
+      schema.condition = *parser::pddl::fromSubtrees(
+        requirements, plansys2_msgs::msg::Node::AND);
+      for (auto root : schema.condition.nodes[0].children) {
+        const auto & node = schema.condition.nodes[root];
+        if (node.node_type == plansys2_msgs::msg::Node::AND) {
+          schema.conjuncts.insert(
+            schema.conjuncts.end(), node.children.begin(), node.children.end());
+        } else {
+          schema.conjuncts.push_back(root);
+        }
+      }
+    }
+
+    schemas_.push_back(schema);
+  }
+
+  groundAll();
+}
+
+void
+ApplicableActionTracker::update(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  if (delta.reset) {
+    groundAll();
+    return;
+  }
+
+  for (const auto & instance : delta.removed_instances) {
+    removeInstance(instance.name);
+  }
+  for (const auto & instance : delta.added_instances) {
+    addInstance(instance);
+  }
+
+  std::set<std::pair<Id, uint32_t>> dirty;
+  if (!actions_by_fact_.empty()) {
+    collectDirty(delta.added_predicates, dirty);
+    collectDirty(delta.removed_predicates, dirty);
+    collectDirty(delta.added_functions, dirty);
+    collectDirty(delta.removed_functions, dirty);
+  }
+
+  for (const auto & conjunct : dirty) {
+    auto id = conjunct.first;
+    auto index = conjunct.second;
+    GroundedAction & action = actions_.at(id);
+
+    bool value = evaluate(action.condition, schemas_[action.schema].conjuncts[index]);
+    if (value == action.satisfied[index]) {
+      continue;
+    }
+
+    action.satisfied[index] = value;
+    if (value) {
+      if (--action.unsatisfied == 0) {
+        setApplicable(id, true);
+      }
+    } else {
+      if (action.unsatisfied++ == 0) {
+        setApplicable(id, false);
+      }
+    }
+  }
+}
+
+std::vector<std::string>
+ApplicableActionTracker::getApplicableActions() const
+{
+  std::vector<std::string> ret;
+  ret.reserve(applicable_.size());
+  for (auto id : applicable_) {
+    ret.push_back(actions_.at(id).action);
+  }
+  return ret;
+}
+
+std::optional<uint32_t>
+ApplicableActionTracker::getUnsatisfied(const std::string & action) const
+{
+  auto it = actions_by_string_.find(action);
+  if (it == actions_by_string_.end()) {
+    return {};
+  }
+  return actions_.at(it->second).unsatisfied;
+}
+
+void
+ApplicableActionTracker::groundAll()
+{
+  instances_.clear();
+  actions_.clear();
+  actions_by_string_.clear();
+  actions_by_instance_.clear();
+  actions_by_fact_.clear();
+  applicable_.clear();
+
+  for (const auto & instance : problem_expert_->getInstances()) {
+    instances_[instance.name] = domain_expert_->getTypeId(instance.type);
+  }
+
+  for (std::size_t schema = 0; schema < schemas_.size(); schema++) {
+    std::vector<std::vector<std::string>> candidates;
+    for (auto type : schemas_[schema].parameter_types) {
+      candidates.push_back(getCandidates(type));
+    }
+    ground(schema, candidates);
+  }
+}
+
+void
+ApplicableActionTracker::addInstance(const plansys2::Instance & instance)
+{
+  if (instances_.find(instance.name) != instances_.end()) {
+    removeInstance(instance.name);
+  }
+
+  auto type = domain_expert_->getTypeId(instance.type);
+  instances_[instance.name] = type;
+  if (!type.has_value()) {
+    return;
+  }
+
+  // Each new combination is grounded once, with the instance in the first position it has
+  for (std::size_t schema = 0; schema < schemas_.size(); schema++) {
+    const auto & parameter_types = schemas_[schema].parameter_types;
+    for (std::size_t position = 0; position < parameter_types.size(); position++) {
+      auto parameter_type = parameter_types[position];
+      if (!parameter_type.has_value() ||
+        !domain_expert_->isSubtype(type.value(), parameter_type.value()))
+      {
+        continue;
+      }
+
+      std::vector<std::vector<std::string>> candidates;
+      for (std::size_t i = 0; i < parameter_types.size(); i++) {
+        if (i == position) {
+          candidates.push_back({instance.name});
+        } else {
+          candidates.push_back(getCandidates(parameter_types[i]));
+          if (i < position) {
+            auto & previous = candidates.back();
+            previous.erase(
+              std::remove(previous.begin(), previous.end(), instance.name), previous.end());
+          }
+        }
+      }
+      ground(schema, candidates);
+    }
+  }
+}
+
+void
+ApplicableActionTracker::removeInstance(const std::string & name)
+{
+  instances_.erase(name);
+
+  auto it = actions_by_instance_.find(name);
+  if (it == actions_by_instance_.end()) {
+    return;
+  }
+
+  auto ids = it->second;
+  for (auto id : ids) {
+    removeAction(id);
+  }
+}
+
+void
+ApplicableActionTracker::ground(
+  std::size_t schema, const std::vector<std::vector<std::string>> & candidates)
+{
+  for (const auto & parameter_candidates : candidates) {
+    if (parameter_candidates.empty()) {
+      return;
+    }
+  }
+
+  std::vector<std::size_t> indexes(candidates.size(), 0);
+  std::vector<std::string> arguments(candidates.size());
+  while (true) {
+    for (std::size_t i = 0; i < candidates.size(); i++) {
+      arguments[i] = candidates[i][indexes[i]];
+    }
+    addAction(schema, arguments);
+
+    // Next combination, changing the last parameter first
+    std::size_t i = candidates.size();
+    while (i > 0 && ++indexes[i - 1] == candidates[i - 1].size()) {
+      indexes[i - 1] = 0;
+      i--;
+    }
+    if (i == 0) {
+      return;
+    }
+  }
+}
+
+void
+ApplicableActionTracker::addAction(
+  std::size_t schema, const std::vector<std::string> & arguments)
+{
+  std::string action_str = "(" + schemas_[schema].name;
+  for (const auto & argument : arguments) {
+    action_str += " " + argument;
+  }
+  action_str += ")";
+
+  if (actions_by_string_.find(action_str) != actions_by_string_.end()) {
+    return;
+  }
+
+  Id id = next_id_++;
+  GroundedAction & action = actions_[id];
+  action.action = action_str;
+  action.arguments = arguments;
+  action.schema = schema;
+  action.condition = schemas_[schema].condition;
+  actions_by_string_[action_str] = id;
+  for (const auto & argument : arguments) {
+    actions_by_instance_[argument].insert(id);
+  }
+
+  for (auto & node : action.condition.nodes) {
+    if (node.node_type != plansys2_msgs::msg::Node::PREDICATE &&
+      node.node_type != plansys2_msgs::msg::Node::FUNCTION)
+    {
+      continue;
+    }
+    for (auto & param : node.parameters) {
+      if (!param.name.empty() && param.name[0] == '?') {
+        param.name = arguments.at(std::stoul(param.name.substr(1)));
+      }
+    }
+  }
+
+  const auto & conjuncts = schemas_[schema].conjuncts;
+  action.satisfied.resize(conjuncts.size());
+  for (uint32_t i = 0; i < conjuncts.size(); i++) {
+    // The facts of a conjunct are the leaves of its subtree
+    std::vector<uint32_t> pending {conjuncts[i]};
+    while (!pending.empty()) {
+      const auto & node = action.condition.nodes[pending.back()];
+      pending.pop_back();
+      pending.insert(pending.end(), node.children.begin(), node.children.end());
+
+      if (node.node_type != plansys2_msgs::msg::Node::PREDICATE &&
+        node.node_type != plansys2_msgs::msg::Node::FUNCTION)
+      {
+        continue;
+      }
+      auto fact = std::make_pair(toGroundedFact(node), i);
+      if (std::find(action.facts.begin(), action.facts.end(), fact) == action.facts.end()) {
+        action.facts.push_back(fact);
+        actions_by_fact_[fact.first].insert(id);
+      }
+    }
+
+    action.satisfied[i] = evaluate(action.condition, conjuncts[i]);
+    if (!action.satisfied[i]) {
+      action.unsatisfied++;
+    }
+  }
+
+  if (action.unsatisfied == 0) {
+    setApplicable(id, true);
+  }
+}
+
+void
+ApplicableActionTracker::removeAction(Id id)
+{
+  auto it = actions_.find(id);
+  const GroundedAction & action = it->second;
+
+  if (action.unsatisfied == 0) {
+    setApplicable(id, false);
+  }
+
+  for (const auto & fact : action.facts) {
+    auto fact_it = actions_by_fact_.find(fact.first);
+    if (fact_it != actions_by_fact_.end()) {
+      fact_it->second.erase(id);
+      if (fact_it->second.empty()) {
+        actions_by_fact_.erase(fact_it);
+      }
+    }
+  }
+
+  for (const auto & argument : action.arguments) {
+    auto instance_it = actions_by_instance_.find(argument);
+    if (instance_it != actions_by_instance_.end()) {
+      instance_it->second.erase(id);
+      if (instance_it->second.empty()) {
+        actions_by_instance_.erase(instance_it);
+      }
+    }
+  }
+
+  actions_by_string_.erase(action.action);
+  actions_.erase(it);
+}
+
+std::vector<std::string>
+ApplicableActionTracker::getCandidates(std::optional<uint32_t> type) const
+{
+  std::vector<std::string> ret;
+  if (!type.has_value()) {
+    return ret;
+  }
+
+  for (const auto & instance : instances_) {
+    if (instance.second.has_value() &&
+      domain_expert_->isSubtype(instance.second.value(), type.value()))
+    {
+      ret.push_back(instance.first);
+    }
+  }
+  return ret;
+}
+
+bool
+ApplicableActionTracker::evaluate(const plansys2_msgs::msg::Tree & condition, uint32_t node_id)
+{
+  evaluations_++;
+
+  std::vector<plansys2::Predicate> predicates;
+  std::vector<plansys2::Function> functions;
+  auto result = plansys2::evaluate(
+    condition, problem_expert_, predicates, functions, false, false, node_id);
+  return std::get<0>(result) && std::get<1>(result);
+}
+
+void
+ApplicableActionTracker::setApplicable(Id id, bool applicable)
+{
+  GroundedAction & action = actions_.at(id);
+  if (applicable) {
+    action.position = applicable_.size();
+    applicable_.push_back(id);
+  } else {
+    // The last one takes its place, so removing is O(1)
+    Id last = applicable_.back();
+    applicable_[action.position] = last;
+    actions_.at(last).position = action.position;
+    applicable_.pop_back();
+  }
+}
+
+void
+ApplicableActionTracker::collectDirty(
+  const std::vector<plansys2_msgs::msg::Node> & changes,
+  std::set<std::pair<Id, uint32_t>> & dirty) const
+{
+  for (const auto & node : changes) {
+    auto fact = findGroundedFact(node);
+    if (!fact.has_value()) {
+      continue;
+    }
+    auto it = actions_by_fact_.find(fact.value());
+    if (it == actions_by_fact_.end()) {
+      continue;
+    }
+    for (auto id : it->second) {
+      for (const auto & action_fact : actions_.at(id).facts) {
+        if (action_fact.first == fact.value()) {
+          dirty.emplace(id, action_fact.second);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace plansys2
@@ -0,0 +1,208 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "plansys2_problem_expert/CompiledTree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+CompiledTree::CompiledTree(const plansys2_msgs::msg::Tree & tree, uint32_t node_id)
+{
+  if (!tree.nodes.empty()) {
+    stack_size_ = compile(tree, node_id, false);
+  }
+}
+
+std::size_t
+CompiledTree::compile(const plansys2_msgs::msg::Tree & tree, uint32_t node_id, bool negate)
+{
+  Instruction instruction {OpCode::INVALID, 0, negate, 0, 0};
+  std::size_t stack_size = 1;
+
+  if (node_id >= tree.nodes.size()) {
+    instructions_.push_back(instruction);
+    return stack_size;
+  }
+
+  const auto & node = tree.nodes[node_id];
+  switch (node.node_type) {
+    case plansys2_msgs::msg::Node::AND:
+    case plansys2_msgs::msg::Node::OR: {
+        bool is_and = node.node_type == plansys2_msgs::msg::Node::AND;
+        std::vector<std::size_t> short_circuits;
+
+        // The values of the previous children are on the stack while a child is evaluated.
+        // Each child but the last is followed by a jump past the AND or OR, taken when the
+        // child decides its result
+        for (std::size_t i = 0; i < node.children.size(); i++) {
+          stack_size = std::max(stack_size, i + compile(tree, node.children[i], negate));
+          if (i + 1 < node.children.size()) {
+            short_circuits.push_back(instructions_.size());
+            instructions_.push_back(
+              {OpCode::SHORT_CIRCUIT, is_and, false, static_cast<uint32_t>(i + 1), 0});
+          }
+        }
+        instruction.op = is_and ? OpCode::AND : OpCode::OR;
+        instruction.argument = node.children.size();
+        instructions_.push_back(instruction);
+
+        for (auto index : short_circuits) {
+          instructions_[index].target = instructions_.size();
+        }
+        return stack_size;
+      }
+
+    case plansys2_msgs::msg::Node::NOT:
+      if (!node.children.empty()) {
+        return compile(tree, node.children[0], !negate);
+      }
+      break;
+
+    case plansys2_msgs::msg::Node::PREDICATE:
+      instruction.op = OpCode::PREDICATE;
+      instruction.argument = addFact(node);
+      break;
+
+    case plansys2_msgs::msg::Node::FUNCTION:
+      instruction.op = OpCode::FUNCTION;
+      instruction.argument = addFact(node);
+      break;
+
+    case plansys2_msgs::msg::Node::NUMBER:
+      instruction.op = OpCode::NUMBER;
+      instruction.number = node.value;
+      break;
+
+    case plansys2_msgs::msg::Node::EXPRESSION:
+    case plansys2_msgs::msg::Node::FUNCTION_MODIFIER: {
+        if (node.children.size() < 2) {
+          break;
+        }
+        auto left = compile(tree, node.children[0], negate);
+        auto right = compile(tree, node.children[1], negate);
+        stack_size = std::max(left, right + 1);
+
+        if (node.node_type == plansys2_msgs::msg::Node::EXPRESSION) {
+          instruction.op = OpCode::EXPRESSION;
+          instruction.type = node.expression_type;
+        } else {
+          const auto & modified = tree.nodes[node.children[0]];
+          instruction.op = OpCode::FUNCTION_MODIFIER;
+          instruction.type = node.modifier_type;
+          instruction.argument = modified.node_type == plansys2_msgs::msg::Node::FUNCTION ?
+            addFact(modified) : kNoFact;
+        }
+        break;
+      }
+
+    default:
+      std::cerr << "evaluate: Error parsing expresion [" <<
+        parser::pddl::toString(tree, node_id) << "]" << std::endl;
+      break;
+  }
+
+  instructions_.push_back(instruction);
+  return stack_size;
+}
+
+uint32_t
+CompiledTree::addFact(const plansys2_msgs::msg::Node & node)
+{
+  facts_.push_back(toGroundedFact(node));
+  return facts_.size() - 1;
+}
+
+CompiledTree::Value
+CompiledTree::computeExpression(uint8_t expression_type, const Value & l, const Value & r)
+{
+  if (!l.success || !r.success) {
+    return {false, false, 0};
+  }
+
+  switch (expression_type) {
+    case plansys2_msgs::msg::Node::COMP_GE:
+      return {true, l.value >= r.value, 0};
+    case plansys2_msgs::msg::Node::COMP_GT:
+      return {true, l.value > r.value, 0};
+    case plansys2_msgs::msg::Node::COMP_LE:
+      return {true, l.value <= r.value, 0};
+    case plansys2_msgs::msg::Node::COMP_LT:
+      return {true, l.value < r.value, 0};
+    case plansys2_msgs::msg::Node::ARITH_MULT:
+      return {true, false, l.value * r.value};
+    case plansys2_msgs::msg::Node::ARITH_DIV:
+      // Division by zero not allowed.
+      if (std::abs(r.value) > 1e-5) {
+        return {true, false, l.value / r.value};
+      }
+      break;
+    case plansys2_msgs::msg::Node::ARITH_ADD:
+      return {true, false, l.value + r.value};
+    case plansys2_msgs::msg::Node::ARITH_SUB:
+      return {true, false, l.value - r.value};
+    default:
+      break;
+  }
+
+  return {false, false, 0};
+}
+
+CompiledTree::Value
+CompiledTree::computeModifier(uint8_t modifier_type, const Value & l, const Value & r)
+{
+  if (!l.success || !r.success) {
+    return {false, false, 0};
+  }
+
+  switch (modifier_type) {
+    case plansys2_msgs::msg::Node::ASSIGN:
+      return {true, false, r.value};
+    case plansys2_msgs::msg::Node::INCREASE:
+      return {true, false, l.value + r.value};
+    case plansys2_msgs::msg::Node::DECREASE:
+      return {true, false, l.value - r.value};
+    case plansys2_msgs::msg::Node::SCALE_UP:
+      return {true, false, l.value * r.value};
+    case plansys2_msgs::msg::Node::SCALE_DOWN:
+      // Division by zero not allowed.
+      if (std::abs(r.value) > 1e-5) {
+        return {true, false, l.value / r.value};
+      }
+      break;
+    default:
+      break;
+  }
+
+  return {false, false, 0};
+}
+
+CompiledDurativeAction::CompiledDurativeAction(
+  const plansys2_msgs::msg::DurativeAction & action)
+: at_start_requirements(action.at_start_requirements),
+  over_all_requirements(action.over_all_requirements),
+  at_end_requirements(action.at_end_requirements),
+  at_start_effects(action.at_start_effects),
+  at_end_effects(action.at_end_effects)
+{
+}
+
+}  // namespace plansys2
@@ -0,0 +1,168 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/ConditionWatcher.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "plansys2_problem_expert/Utils.hpp"
+
+namespace plansys2
+{
+
+ConditionWatcher::ConditionWatcher(std::shared_ptr<ProblemExpertInterface> problem_expert)
+: problem_expert_(problem_expert)
+{
+}
+
+ConditionWatcher::Id
+ConditionWatcher::addWatch(const plansys2_msgs::msg::Tree & condition, const std::string & owner)
+{
+  Id id = next_id_++;
+  Watch & watch = watches_[id];
+  watch.condition = condition;
+  watch.owner = owner;
+
+  for (const auto & node : condition.nodes) {
+    if (node.node_type != plansys2_msgs::msg::Node::PREDICATE &&
+      node.node_type != plansys2_msgs::msg::Node::FUNCTION)
+    {
+      continue;
+    }
+    GroundedFact fact = toGroundedFact(node);
+    if (std::find(watch.facts.begin(), watch.facts.end(), fact) == watch.facts.end()) {
+      watch.facts.push_back(fact);
+      watches_by_fact_[fact].insert(id);
+    }
+  }
+
+  watch.value = evaluate(condition);
+  return id;
+}
+
+bool
+ConditionWatcher::removeWatch(Id id)
+{
+  auto it = watches_.find(id);
+  if (it == watches_.end()) {
+    return false;
+  }
+
+  for (const auto & fact : it->second.facts) {
+    auto fact_it = watches_by_fact_.find(fact);
+    fact_it->second.erase(id);
+    if (fact_it->second.empty()) {
+      watches_by_fact_.erase(fact_it);
+    }
+  }
+  watches_.erase(it);
+  return true;
+}
+
+std::vector<ConditionWatcher::Id>
+ConditionWatcher::expireWatches(const std::unordered_set<std::string> & live_owners)
+{
+  std::vector<Id> expired;
+  for (auto & watch : watches_) {
+    if (watch.second.owner.empty() || live_owners.count(watch.second.owner) > 0) {
+      watch.second.owner_missing = false;
+    } else if (watch.second.owner_missing) {
+      expired.push_back(watch.first);
+    } else {
+      watch.second.owner_missing = true;
+    }
+  }
+
+  for (auto id : expired) {
+    removeWatch(id);
+  }
+
+  std::sort(expired.begin(), expired.end());
+  return expired;
+}
+
+std::optional<bool>
+ConditionWatcher::getValue(Id id) const
+{
+  auto it = watches_.find(id);
+  if (it == watches_.end()) {
+    return {};
+  }
+  return it->second.value;
+}
+
+std::vector<std::pair<ConditionWatcher::Id, bool>>
+ConditionWatcher::update(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  std::unordered_set<Id> dirty;
+  if (delta.reset) {
+    for (const auto & watch : watches_) {
+      dirty.insert(watch.first);
+    }
+  } else if (!watches_by_fact_.empty()) {
+    collectDirty(delta.added_predicates, dirty);
+    collectDirty(delta.removed_predicates, dirty);
+    collectDirty(delta.added_functions, dirty);
+    collectDirty(delta.removed_functions, dirty);
+  }
+
+  std::vector<std::pair<Id, bool>> changes;
+  for (auto id : dirty) {
+    Watch & watch = watches_[id];
+    bool value = evaluate(watch.condition);
+    if (value != watch.value) {
+      watch.value = value;
+      changes.emplace_back(id, value);
+    }
+  }
+  evaluations_ += dirty.size();
+
+  std::sort(changes.begin(), changes.end());
+  return changes;
+}
+
+bool
+ConditionWatcher::evaluate(const plansys2_msgs::msg::Tree & condition)
+{
+  std::vector<plansys2::Predicate> predicates;
+  std::vector<plansys2::Function> functions;
+  auto result = plansys2::evaluate(condition, problem_expert_, predicates, functions);
+  return std::get<0>(result) && std::get<1>(result);
+}
+
+void
+ConditionWatcher::collectDirty(
+  const std::vector<plansys2_msgs::msg::Node> & changes,
+  std::unordered_set<Id> & dirty) const
+{
+  for (const auto & node : changes) {
+    auto fact = findGroundedFact(node);
+    if (!fact.has_value()) {
+      continue;
+    }
+    auto it = watches_by_fact_.find(fact.value());
+    if (it != watches_by_fact_.end()) {
+      dirty.insert(it->second.begin(), it->second.end());
+    }
+  }
+}
+
+}  // namespace plansys2
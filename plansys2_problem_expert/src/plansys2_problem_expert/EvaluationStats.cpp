@@ -0,0 +1,98 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/EvaluationStats.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace plansys2
+{
+
+EvaluationStats::EvaluationStats(bool reorder)
+: reorder_(reorder)
+{
+}
+
+void
+EvaluationStats::record(const std::string & key, bool value, std::chrono::nanoseconds time)
+{
+  auto & entry = entries_[key];
+  entry.evaluations++;
+  entry.true_count += value ? 1 : 0;
+  entry.time += time;
+  evaluations_++;
+}
+
+std::vector<std::size_t>
+EvaluationStats::getOrder(const std::vector<std::string> & keys, bool decisive_value) const
+{
+  std::vector<std::size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  if (!reorder_) {
+    return order;
+  }
+
+  std::vector<double> scores;
+  scores.reserve(keys.size());
+  for (const auto & key : keys) {
+    scores.push_back(getScore(key, decisive_value));
+  }
+
+  std::stable_sort(
+    order.begin(), order.end(),
+    [&scores](std::size_t a, std::size_t b) {return scores[a] < scores[b];});
+  return order;
+}
+
+std::optional<EvaluationStats::Entry>
+EvaluationStats::getEntry(const std::string & key) const
+{
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+void
+EvaluationStats::reset()
+{
+  entries_.clear();
+  evaluations_ = 0;
+  skipped_ = 0;
+}
+
+double
+EvaluationStats::getScore(const std::string & key, bool decisive_value) const
+{
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return 0.0;
+  }
+
+  const auto & entry = it->second;
+  uint64_t decisive = decisive_value ? entry.true_count : entry.evaluations - entry.true_count;
+
+  // The probability is smoothed, so a child that has never decided is still tried
+  double mean_time = static_cast<double>(entry.time.count()) / entry.evaluations;
+  double probability = (decisive + 1.0) / (entry.evaluations + 2.0);
+  return mean_time / probability;
+}
+
+}  // namespace plansys2
@@ -0,0 +1,95 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/GoalTracker.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+GoalTracker::GoalTracker(std::shared_ptr<ProblemExpertInterface> problem_expert)
+: problem_expert_(problem_expert),
+  watcher_(std::make_unique<ConditionWatcher>(problem_expert))
+{
+}
+
+void
+GoalTracker::setGoal(const plansys2::Goal & goal)
+{
+  watcher_ = std::make_unique<ConditionWatcher>(problem_expert_);
+  subgoals_.clear();
+  watches_.clear();
+
+  if (goal.nodes.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> roots {0};
+  if (goal.nodes[0].node_type == plansys2_msgs::msg::Node::AND) {
+    roots = goal.nodes[0].children;
+  }
+
+  for (auto root : roots) {
+    plansys2_msgs::msg::Tree subgoal;
+    parser::pddl::fromString(subgoal, "(and " + parser::pddl::toString(goal, root) + ")");
+    watches_.push_back(watcher_->addWatch(subgoal));
+    subgoals_.push_back(subgoal);
+  }
+}
+
+bool
+GoalTracker::update(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  if (delta.goal_changed) {
+    setGoal(delta.goal);
+    return true;
+  }
+  return !watcher_->update(delta).empty();
+}
+
+bool
+GoalTracker::isSatisfied() const
+{
+  if (subgoals_.empty()) {
+    return false;
+  }
+
+  for (auto id : watches_) {
+    if (!watcher_->getValue(id).value()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+plansys2_msgs::msg::GoalStatus
+GoalTracker::getStatus() const
+{
+  plansys2_msgs::msg::GoalStatus status;
+  for (std::size_t i = 0; i < subgoals_.size(); i++) {
+    if (watcher_->getValue(watches_[i]).value()) {
+      status.satisfied_subgoals.push_back(subgoals_[i]);
+    } else {
+      status.unsatisfied_subgoals.push_back(subgoals_[i]);
+    }
+  }
+  status.satisfied = !subgoals_.empty() && status.unsatisfied_subgoals.empty();
+  return status;
+}
+
+}  // namespace plansys2
@@ -0,0 +1,254 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/HypotheticalState.hpp"
+
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "plansys2_problem_expert/State.hpp"
+
+namespace plansys2
+{
+
+HypotheticalState::HypotheticalState(
+  const std::vector<plansys2::Predicate> & predicates,
+  const std::vector<plansys2::Function> & functions)
+{
+  overlay_.predicates.reserve(predicates.size());
+  for (const auto & predicate : predicates) {
+    overlay_.predicates[toGroundedFact(predicate)] = true;
+  }
+  overlay_.functions.reserve(functions.size());
+  for (const auto & function : functions) {
+    overlay_.functions[toGroundedFact(function)] = function.value;
+  }
+}
+
+HypotheticalState
+HypotheticalState::fork()
+{
+  if (!overlay_.predicates.empty() || !overlay_.functions.empty()) {
+    freeze();
+  }
+
+  HypotheticalState ret;
+  ret.base_ = base_;
+  return ret;
+}
+
+void
+HypotheticalState::freeze()
+{
+  auto layer = std::make_shared<Layer>();
+  layer->parent = base_;
+  layer->depth = getDepth();
+  layer->predicates.swap(overlay_.predicates);
+  layer->functions.swap(overlay_.functions);
+
+  // The layers above the bottom one, which usually holds the whole initial state, are
+  // merged into one on top of it, so the bottom layer is still shared and never copied.
+  // They are merged from the top, so the newest value of each fact is the one kept
+  if (layer->depth >= kMaxDepth) {
+    std::shared_ptr<const Layer> bottom = layer;
+    while (bottom->parent != nullptr) {
+      bottom = bottom->parent;
+    }
+
+    auto merged = std::make_shared<Layer>();
+    merged->parent = bottom;
+    merged->depth = bottom->depth + 1;
+    for (const Layer * it = layer.get(); it != bottom.get(); it = it->parent.get()) {
+      merged->predicates.insert(it->predicates.begin(), it->predicates.end());
+      merged->functions.insert(it->functions.begin(), it->functions.end());
+    }
+
+    // A removal is only kept if it hides a predicate of the bottom layer
+    for (auto it = merged->predicates.begin(); it != merged->predicates.end(); ) {
+      auto in_bottom = bottom->predicates.find(it->first);
+      bool hides = in_bottom != bottom->predicates.end() && in_bottom->second;
+      it = (it->second || hides) ? std::next(it) : merged->predicates.erase(it);
+    }
+    layer = merged;
+  }
+
+  base_ = layer;
+}
+
+std::vector<const HypotheticalState::Layer *>
+HypotheticalState::getLayers() const
+{
+  std::vector<const Layer *> ret {&overlay_};
+  for (const Layer * it = base_.get(); it != nullptr; it = it->parent.get()) {
+    ret.push_back(it);
+  }
+  return ret;
+}
+
+bool
+HypotheticalState::existPredicate(const GroundedFact & predicate) const
+{
+  auto it = overlay_.predicates.find(predicate);
+  if (it != overlay_.predicates.end()) {
+    return it->second;
+  }
+
+  for (const Layer * layer = base_.get(); layer != nullptr; layer = layer->parent.get()) {
+    it = layer->predicates.find(predicate);
+    if (it != layer->predicates.end()) {
+      return it->second;
+    }
+  }
+  return false;
+}
+
+bool
+HypotheticalState::existPredicate(const plansys2_msgs::msg::Node & predicate) const
+{
+  // A predicate with symbols never interned cannot be in any state
+  auto fact = findGroundedFact(predicate);
+  return fact.has_value() && existPredicate(fact.value());
+}
+
+void
+HypotheticalState::addPredicate(const GroundedFact & predicate)
+{
+  overlay_.predicates[predicate] = true;
+}
+
+void
+HypotheticalState::addPredicate(const plansys2_msgs::msg::Node & predicate)
+{
+  auto fact = toGroundedFact(predicate);
+  if (!existPredicate(fact)) {
+    addPredicate(fact);
+  }
+}
+
+void
+HypotheticalState::removePredicate(const GroundedFact & predicate)
+{
+  if (base_ == nullptr) {
+    overlay_.predicates.erase(predicate);
+  } else {
+    overlay_.predicates[predicate] = false;
+  }
+}
+
+void
+HypotheticalState::removePredicate(const plansys2_msgs::msg::Node & predicate)
+{
+  auto fact = findGroundedFact(predicate);
+  if (fact.has_value() && existPredicate(fact.value())) {
+    removePredicate(fact.value());
+  }
+}
+
+std::optional<double>
+HypotheticalState::getFunctionValue(const GroundedFact & function) const
+{
+  auto it = overlay_.functions.find(function);
+  if (it != overlay_.functions.end()) {
+    return it->second;
+  }
+
+  for (const Layer * layer = base_.get(); layer != nullptr; layer = layer->parent.get()) {
+    it = layer->functions.find(function);
+    if (it != layer->functions.end()) {
+      return it->second;
+    }
+  }
+  return {};
+}
+
+std::optional<double>
+HypotheticalState::getFunctionValue(const plansys2_msgs::msg::Node & function) const
+{
+  auto fact = findGroundedFact(function);
+  if (!fact.has_value()) {
+    return {};
+  }
+  return getFunctionValue(fact.value());
+}
+
+void
+HypotheticalState::setFunctionValue(const GroundedFact & function, double value)
+{
+  overlay_.functions[function] = value;
+}
+
+void
+HypotheticalState::setFunctionValue(const plansys2_msgs::msg::Node & function, double value)
+{
+  setFunctionValue(toGroundedFact(function), value);
+}
+
+std::tuple<bool, bool, double>
+HypotheticalState::evaluate(
+  const plansys2_msgs::msg::Tree & tree, bool apply, uint32_t node_id, bool negate)
+{
+  return evaluateInState(tree, *this, apply, node_id, negate);
+}
+
+bool
+HypotheticalState::check(const plansys2_msgs::msg::Tree & tree, uint32_t node_id)
+{
+  auto result = evaluate(tree, false, node_id);
+  return std::get<1>(result);
+}
+
+bool
+HypotheticalState::apply(const plansys2_msgs::msg::Tree & tree, uint32_t node_id)
+{
+  auto result = evaluate(tree, true, node_id);
+  return std::get<0>(result);
+}
+
+std::vector<plansys2::Predicate>
+HypotheticalState::getPredicates() const
+{
+  std::unordered_map<GroundedFact, bool, GroundedFactHash> predicates;
+  for (const auto * layer : getLayers()) {
+    predicates.insert(layer->predicates.begin(), layer->predicates.end());
+  }
+
+  std::vector<plansys2::Predicate> ret;
+  for (const auto & predicate : predicates) {
+    if (predicate.second) {
+      ret.push_back(toNode(predicate.first));
+    }
+  }
+  return ret;
+}
+
+std::vector<plansys2::Function>
+HypotheticalState::getFunctions() const
+{
+  std::unordered_map<GroundedFact, double, GroundedFactHash> functions;
+  for (const auto * layer : getLayers()) {
+    functions.insert(layer->functions.begin(), layer->functions.end());
+  }
+
+  std::vector<plansys2::Function> ret;
+  ret.reserve(functions.size());
+  for (const auto & function : functions) {
+    ret.push_back(toNode(function.first));
+    ret.back().value = function.second;
+  }
+  return ret;
+}
+
+}  // namespace plansys2
@@ -0,0 +1,176 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/KnowledgeReplica.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+bool
+KnowledgeReplica::apply(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  bool is_snapshot = delta.reset && delta.base_revision == delta.revision;
+
+  if (is_snapshot) {
+    if (!synced_ || delta.epoch != epoch_ || delta.revision >= revision_) {
+      applyChanges(delta);
+      epoch_ = delta.epoch;
+      synced_ = true;
+    }
+    return true;
+  }
+
+  // Revisions of another epoch say nothing about the ones of the replica
+  if (!synced_) {
+    return false;
+  } else if (delta.epoch != epoch_) {
+    synced_ = false;
+    return false;
+  } else if (delta.revision <= revision_) {
+    return true;
+  } else if (delta.base_revision != revision_) {
+    synced_ = false;
+    return false;
+  }
+
+  applyChanges(delta);
+  return true;
+}
+
+void
+KnowledgeReplica::applyChanges(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  if (delta.reset) {
+    instances_.clear();
+    predicates_.clear();
+    functions_.clear();
+  }
+
+  // Removed instances come with the facts that referred to them
+  for (const auto & function : delta.removed_functions) {
+    functions_.erase(function);
+  }
+  for (const auto & predicate : delta.removed_predicates) {
+    predicates_.erase(predicate);
+  }
+  for (const auto & instance : delta.removed_instances) {
+    instances_.erase(instance);
+  }
+
+  for (const auto & instance : delta.added_instances) {
+    instances_.insert(instance);
+  }
+  for (const auto & predicate : delta.added_predicates) {
+    predicates_.insert(predicate);
+  }
+  for (const auto & function : delta.added_functions) {
+    auto inserted = functions_.insert(function);
+    if (!inserted.second) {
+      // Updated functions are moved to the end, as the ProblemExpert does
+      functions_[inserted.first] = function;
+      functions_.moveToBack(inserted.first);
+    }
+  }
+
+  if (delta.goal_changed) {
+    goal_ = delta.goal;
+  }
+
+  revision_ = delta.revision;
+}
+
+std::vector<plansys2::Instance>
+KnowledgeReplica::getInstances() const
+{
+  return instances_.values();
+}
+
+std::optional<plansys2::Instance>
+KnowledgeReplica::getInstance(const std::string & name) const
+{
+  plansys2::Instance instance;
+  instance.name = name;
+
+  auto id = instances_.find(instance);
+  if (id != instances_.npos) {
+    return instances_[id];
+  } else {
+    return {};
+  }
+}
+
+std::vector<plansys2::Predicate>
+KnowledgeReplica::getPredicates() const
+{
+  return predicates_.values();
+}
+
+bool
+KnowledgeReplica::existPredicate(const plansys2::Predicate & predicate) const
+{
+  return predicates_.contains(predicate);
+}
+
+std::optional<plansys2::Predicate>
+KnowledgeReplica::getPredicate(const std::string & expr) const
+{
+  auto id = predicates_.find(parser::pddl::fromStringPredicate(expr));
+  if (id != predicates_.npos) {
+    return predicates_[id];
+  } else {
+    return {};
+  }
+}
+
+std::vector<plansys2::Function>
+KnowledgeReplica::getFunctions() const
+{
+  return functions_.values();
+}
+
+bool
+KnowledgeReplica::existFunction(const plansys2::Function & function) const
+{
+  return functions_.contains(function);
+}
+
+std::optional<plansys2::Function>
+KnowledgeReplica::getFunction(const std::string & expr) const
+{
+  auto id = functions_.find(parser::pddl::fromStringFunction(expr));
+  if (id != functions_.npos) {
+    return functions_[id];
+  } else {
+    return {};
+  }
+}
+
+std::optional<double>
+KnowledgeReplica::getFunctionValue(const plansys2::Function & function) const
+{
+  auto id = functions_.find(function);
+  if (id != functions_.npos) {
+    return functions_[id].value;
+  } else {
+    return {};
+  }
+}
+
+}  // namespace plansys2
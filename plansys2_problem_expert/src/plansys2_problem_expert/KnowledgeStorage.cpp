@@ -0,0 +1,523 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/KnowledgeStorage.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+#include "plansys2_msgs/msg/tree.hpp"
+
+namespace plansys2
+{
+
+namespace
+{
+
+// Files start with a magic string and the version of the format. The log also has the
+// revision of the snapshot it follows. Then come the records: payload size, checksum
+// of the payload and payload. Numbers are in host byte order.
+const char SNAPSHOT_MAGIC[8] = {'P', 'S', '2', 'S', 'N', 'A', 'P', '\0'};
+const char LOG_MAGIC[8] = {'P', 'S', '2', 'K', 'W', 'A', 'L', '\0'};
+const uint32_t FORMAT_VERSION = 1;
+
+const char SNAPSHOT_FILE[] = "knowledge.snapshot";
+const char LOG_FILE[] = "knowledge.wal";
+
+// FNV-1a
+uint32_t checksum(const char * data, std::size_t size)
+{
+  uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+class Writer
+{
+public:
+  explicit Writer(std::string & out)
+  : out_(out) {}
+
+  template<class T>
+  void write(T value)
+  {
+    out_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void write(const std::string & value)
+  {
+    write<uint32_t>(value.size());
+    out_.append(value);
+  }
+
+  void write(const plansys2_msgs::msg::Param & param)
+  {
+    write(param.name);
+    write(param.type);
+    write<uint32_t>(param.sub_types.size());
+    for (const auto & sub_type : param.sub_types) {
+      write(sub_type);
+    }
+  }
+
+  void write(const plansys2_msgs::msg::Node & node)
+  {
+    write<uint8_t>(node.node_type);
+    write<uint8_t>(node.expression_type);
+    write<uint8_t>(node.modifier_type);
+    write<uint32_t>(node.node_id);
+    write<uint32_t>(node.children.size());
+    for (auto child : node.children) {
+      write<uint32_t>(child);
+    }
+    write(node.name);
+    write<uint32_t>(node.parameters.size());
+    for (const auto & param : node.parameters) {
+      write(param);
+    }
+    write<double>(node.value);
+    write<uint8_t>(node.negate);
+  }
+
+  template<class T>
+  void write(const std::vector<T> & items)
+  {
+    write<uint32_t>(items.size());
+    for (const auto & item : items) {
+      write(item);
+    }
+  }
+
+private:
+  std::string & out_;
+};
+
+class Reader
+{
+public:
+  Reader(const char * data, std::size_t size)
+  : data_(data), size_(size) {}
+
+  bool ok() const {return ok_;}
+  bool done() const {return pos_ == size_;}
+
+  template<class T>
+  T read()
+  {
+    T value {};
+    if (pos_ + sizeof(T) > size_) {
+      ok_ = false;
+    } else {
+      std::memcpy(&value, data_ + pos_, sizeof(T));
+      pos_ += sizeof(T);
+    }
+    return value;
+  }
+
+  void read(std::string & value)
+  {
+    auto size = read<uint32_t>();
+    if (!ok_ || pos_ + size > size_) {
+      ok_ = false;
+    } else {
+      value.assign(data_ + pos_, size);
+      pos_ += size;
+    }
+  }
+
+  void read(plansys2_msgs::msg::Param & param)
+  {
+    read(param.name);
+    read(param.type);
+    readVector(param.sub_types);
+  }
+
+  void read(plansys2_msgs::msg::Node & node)
+  {
+    node.node_type = read<uint8_t>();
+    node.expression_type = read<uint8_t>();
+    node.modifier_type = read<uint8_t>();
+    node.node_id = read<uint32_t>();
+    auto n_children = read<uint32_t>();
+    for (uint32_t i = 0; ok_ && i < n_children; i++) {
+      node.children.push_back(read<uint32_t>());
+    }
+    read(node.name);
+    readVector(node.parameters);
+    node.value = read<double>();
+    node.negate = read<uint8_t>();
+  }
+
+  template<class T>
+  void readVector(std::vector<T> & items)
+  {
+    auto size = read<uint32_t>();
+    // Each item takes at least 4 bytes, so a bad size is detected before allocating
+    if (!ok_ || size > (size_ - pos_) / 4) {
+      ok_ = false;
+      return;
+    }
+    items.resize(size);
+    for (uint32_t i = 0; ok_ && i < size; i++) {
+      read(items[i]);
+    }
+  }
+
+  /// Skip some bytes, if they are the expected ones.
+  bool skip(const char * expected, std::size_t size)
+  {
+    if (pos_ + size > size_ || std::memcmp(data_ + pos_, expected, size) != 0) {
+      ok_ = false;
+    } else {
+      pos_ += size;
+    }
+    return ok_;
+  }
+
+  /// Read a record: size, checksum and payload.
+  bool readRecord(std::string & payload)
+  {
+    auto size = read<uint32_t>();
+    auto sum = read<uint32_t>();
+    if (!ok_ || pos_ + size > size_ || checksum(data_ + pos_, size) != sum) {
+      ok_ = false;
+      return false;
+    }
+    payload.assign(data_ + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+private:
+  const char * data_;
+  std::size_t size_;
+  std::size_t pos_ {0};
+  bool ok_ {true};
+};
+
+std::string makeRecord(const std::string & payload)
+{
+  std::string ret;
+  Writer writer(ret);
+  writer.write<uint32_t>(payload.size());
+  writer.write<uint32_t>(checksum(payload.data(), payload.size()));
+  ret.append(payload);
+  return ret;
+}
+
+bool writeAll(int fd, const std::string & data)
+{
+  std::size_t written = 0;
+  while (written < data.size()) {
+    auto ret = ::write(fd, data.data() + written, data.size() - written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+// Write a file so that it is either the new one or the previous one after a crash
+bool writeFileAtomically(const std::filesystem::path & path, const std::string & data)
+{
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+
+  int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = writeAll(fd, data) && ::fsync(fd) == 0;
+  ::close(fd);
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(tmp_path, path, ec);
+  }
+  if (!ok || ec) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+
+  // Make the rename durable
+  int dir_fd = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd >= 0) {
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+  }
+  return true;
+}
+
+std::optional<std::string> readFile(const std::filesystem::path & path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    return {};
+  }
+  return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+std::string makeHeader(const char (& magic)[8])
+{
+  std::string ret(magic, sizeof(magic));
+  Writer writer(ret);
+  writer.write<uint32_t>(FORMAT_VERSION);
+  return ret;
+}
+
+bool readHeader(Reader & reader, const char (& magic)[8])
+{
+  return reader.skip(magic, sizeof(magic)) && reader.read<uint32_t>() == FORMAT_VERSION &&
+         reader.ok();
+}
+
+}  // namespace
+
+KnowledgeStorage::KnowledgeStorage(
+  const std::string & directory,
+  Durability durability,
+  std::chrono::nanoseconds sync_period)
+: directory_(directory),
+  durability_(durability),
+  sync_period_(sync_period),
+  last_sync_(std::chrono::steady_clock::now())
+{
+  std::error_code ec;
+  std::filesystem::create_directories(directory_, ec);
+}
+
+KnowledgeStorage::~KnowledgeStorage()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (log_fd_ >= 0) {
+    syncLocked();
+    ::close(log_fd_);
+  }
+}
+
+std::optional<KnowledgeStorage::Durability>
+KnowledgeStorage::getDurability(const std::string & durability_str)
+{
+  if (durability_str == "none") {
+    return Durability::NONE;
+  } else if (durability_str == "batch") {
+    return Durability::BATCH;
+  } else if (durability_str == "always") {
+    return Durability::ALWAYS;
+  } else {
+    return {};
+  }
+}
+
+bool
+KnowledgeStorage::exists() const
+{
+  return std::filesystem::exists(std::filesystem::path(directory_) / SNAPSHOT_FILE);
+}
+
+bool
+KnowledgeStorage::load(ProblemExpert & problem_expert)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto snapshot_data = readFile(std::filesystem::path(directory_) / SNAPSHOT_FILE);
+  if (!snapshot_data) {
+    return false;
+  }
+
+  Reader snapshot_reader(snapshot_data->data(), snapshot_data->size());
+  std::string payload;
+  if (!readHeader(snapshot_reader, SNAPSHOT_MAGIC) || !snapshot_reader.readRecord(payload)) {
+    return false;
+  }
+
+  auto snapshot = decode(payload);
+  if (!snapshot || !snapshot->reset || !problem_expert.applyDelta(snapshot.value())) {
+    return false;
+  }
+
+  // The log is valid only if it follows this snapshot. If not, the process stopped while
+  // compacting, and the snapshot already has everything
+  log_size_ = 0;
+  auto log_data = readFile(std::filesystem::path(directory_) / LOG_FILE);
+  if (!log_data) {
+    return true;
+  }
+
+  Reader log_reader(log_data->data(), log_data->size());
+  if (!readHeader(log_reader, LOG_MAGIC) || log_reader.read<uint64_t>() != snapshot->revision) {
+    return true;
+  }
+
+  uint64_t revision = snapshot->revision;
+  while (!log_reader.done() && log_reader.readRecord(payload)) {
+    auto delta = decode(payload);
+    if (!delta || delta->base_revision != revision || !problem_expert.applyDelta(delta.value())) {
+      break;
+    }
+    revision = delta->revision;
+    log_size_++;
+  }
+
+  return true;
+}
+
+bool
+KnowledgeStorage::openLog(uint64_t base_revision)
+{
+  if (log_fd_ >= 0) {
+    ::close(log_fd_);
+    log_fd_ = -1;
+  }
+
+  auto path = std::filesystem::path(directory_) / LOG_FILE;
+
+  auto header = makeHeader(LOG_MAGIC);
+  Writer writer(header);
+  writer.write<uint64_t>(base_revision);
+  if (!writeFileAtomically(path, header)) {
+    return false;
+  }
+
+  log_fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND);
+  log_size_ = 0;
+  pending_sync_ = false;
+  return log_fd_ >= 0;
+}
+
+bool
+KnowledgeStorage::append(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (log_fd_ < 0 || !writeAll(log_fd_, makeRecord(encode(delta)))) {
+    return false;
+  }
+  log_size_++;
+  pending_sync_ = true;
+
+  if (durability_ == Durability::ALWAYS ||
+    (durability_ == Durability::BATCH &&
+    std::chrono::steady_clock::now() - last_sync_ >= sync_period_))
+  {
+    syncLocked();
+  }
+  return true;
+}
+
+bool
+KnowledgeStorage::writeSnapshot(const plansys2_msgs::msg::KnowledgeDelta & snapshot)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto path = std::filesystem::path(directory_) / SNAPSHOT_FILE;
+  if (!writeFileAtomically(path, makeHeader(SNAPSHOT_MAGIC) + makeRecord(encode(snapshot)))) {
+    return false;
+  }
+
+  return openLog(snapshot.revision);
+}
+
+void
+KnowledgeStorage::sync()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  syncLocked();
+}
+
+void
+KnowledgeStorage::syncLocked()
+{
+  if (log_fd_ >= 0 && pending_sync_) {
+    ::fdatasync(log_fd_);
+    pending_sync_ = false;
+  }
+  last_sync_ = std::chrono::steady_clock::now();
+}
+
+std::size_t
+KnowledgeStorage::getLogSize() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return log_size_;
+}
+
+std::string
+KnowledgeStorage::encode(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  std::string ret;
+  Writer writer(ret);
+
+  writer.write<uint64_t>(delta.base_revision);
+  writer.write<uint64_t>(delta.revision);
+  writer.write<uint8_t>(delta.reset);
+  writer.write(delta.removed_instances);
+  writer.write(delta.added_instances);
+  writer.write(delta.removed_predicates);
+  writer.write(delta.added_predicates);
+  writer.write(delta.removed_functions);
+  writer.write(delta.added_functions);
+  writer.write<uint8_t>(delta.goal_changed);
+  if (delta.goal_changed) {
+    writer.write(delta.goal.nodes);
+  }
+
+  return ret;
+}
+
+std::optional<plansys2_msgs::msg::KnowledgeDelta>
+KnowledgeStorage::decode(const std::string & data)
+{
+  plansys2_msgs::msg::KnowledgeDelta ret;
+  Reader reader(data.data(), data.size());
+
+  ret.base_revision = reader.read<uint64_t>();
+  ret.revision = reader.read<uint64_t>();
+  ret.reset = reader.read<uint8_t>();
+  reader.readVector(ret.removed_instances);
+  reader.readVector(ret.added_instances);
+  reader.readVector(ret.removed_predicates);
+  reader.readVector(ret.added_predicates);
+  reader.readVector(ret.removed_functions);
+  reader.readVector(ret.added_functions);
+  ret.goal_changed = reader.read<uint8_t>();
+  if (ret.goal_changed) {
+    reader.readVector(ret.goal.nodes);
+  }
+
+  if (!reader.ok() || !reader.done()) {
+    return {};
+  }
+  return ret;
+}
+
+}  // namespace plansys2
@@ -16,16 +16,23 @@
 
 #include <optional>
 #include <algorithm>
+#include <functional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "plansys2_core/Utils.hpp"
 #include "plansys2_pddl_parser/Domain.h"
+#include "plansys2_pddl_parser/GroundFunc.h"
 #include "plansys2_pddl_parser/Instance.h"
+#include "plansys2_problem_expert/State.hpp"
 #include "plansys2_problem_expert/Utils.hpp"
 
 #include "plansys2_core/Types.hpp"
@@ -33,6 +40,291 @@
 namespace plansys2
 {
 
+namespace
+{
+
+template<class InstanceReferences>
+void addReferences(
+  InstanceReferences & references, const GroundedFact & fact, uint32_t id)
+{
+  for (std::size_t i = 0; i < fact.getArity(); i++) {
+    references[fact.getArg(i)].insert(id);
+  }
+}
+
+template<class InstanceReferences>
+void removeReferences(
+  InstanceReferences & references, const GroundedFact & fact, uint32_t id)
+{
+  for (std::size_t i = 0; i < fact.getArity(); i++) {
+    auto it = references.find(fact.getArg(i));
+    if (it != references.end()) {
+      it->second.erase(id);
+      if (it->second.empty()) {
+        references.erase(it);
+      }
+    }
+  }
+}
+
+// Validates grounded facts against the domain. The types of the arguments of each predicate
+// and function are looked up once per name, and the type of each instance once. Both are
+// kept as type ids, so checking an argument is a single subtype bit test
+class FactValidator
+{
+public:
+  using GetInstanceType = std::function<std::optional<std::string>(SymbolTable::Id)>;
+
+  FactValidator(std::shared_ptr<DomainExpert> domain_expert, GetInstanceType get_instance_type)
+  : domain_expert_(domain_expert),
+    get_instance_type_(get_instance_type)
+  {
+  }
+
+  // Add an instance that does not exist yet. False if its type or its name are not valid
+  bool addInstance(SymbolTable::Id name, const std::string & type)
+  {
+    return domain_expert_->existType(type) && !get_instance_type_(name) &&
+           instance_types_.emplace(name, domain_expert_->getTypeId(type).value()).second;
+  }
+
+  bool isValid(const GroundedFact & fact)
+  {
+    bool is_predicate = fact.getNodeType() == plansys2_msgs::msg::Node::PREDICATE;
+    if (!is_predicate && fact.getNodeType() != plansys2_msgs::msg::Node::FUNCTION) {
+      return false;
+    }
+
+    auto & signatures = is_predicate ? predicate_signatures_ : function_signatures_;
+    auto it = signatures.find(fact.getName());
+    if (it == signatures.end()) {
+      auto name = SymbolTable::getInstance().getName(fact.getName());
+      auto signature = is_predicate ?
+        getSignature(domain_expert_->getPredicate(name)) :
+        getSignature(domain_expert_->getFunction(name));
+      it = signatures.emplace(fact.getName(), std::move(signature)).first;
+    }
+
+    const auto & signature = it->second;
+    if (!signature || signature.value().size() != fact.getArity()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < fact.getArity(); i++) {
+      auto type = getInstanceType(fact.getArg(i));
+      if (!type || !domain_expert_->isSubtype(type.value(), signature.value()[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  // Type ids of the parameters. Nothing if there is no predicate or function with that name,
+  // or if the type of some parameter is unknown
+  using Signature = std::optional<std::vector<uint32_t>>;
+
+  template<class Model>
+  Signature getSignature(const std::optional<Model> & model) const
+  {
+    if (!model) {
+      return {};
+    }
+
+    std::vector<uint32_t> signature;
+    for (const auto & param : model.value().parameters) {
+      auto type = domain_expert_->getTypeId(param.type);
+      if (!type) {
+        return {};
+      }
+      signature.push_back(type.value());
+    }
+    return signature;
+  }
+
+  std::optional<uint32_t> getInstanceType(SymbolTable::Id name)
+  {
+    auto it = instance_types_.find(name);
+    if (it == instance_types_.end()) {
+      auto type = get_instance_type_(name);
+      auto type_id = type ? domain_expert_->getTypeId(type.value()) : std::nullopt;
+      if (!type_id) {
+        return {};
+      }
+      it = instance_types_.emplace(name, type_id.value()).first;
+    }
+    return it->second;
+  }
+
+  std::shared_ptr<DomainExpert> domain_expert_;
+  GetInstanceType get_instance_type_;
+  std::unordered_map<SymbolTable::Id, uint32_t> instance_types_;
+  std::unordered_map<SymbolTable::Id, Signature> predicate_signatures_;
+  std::unordered_map<SymbolTable::Id, Signature> function_signatures_;
+};
+
+// Get the compact form of a fact of the init section of a parsed problem, without building
+// its node. Nothing if some argument is not an object of the problem
+std::optional<GroundedFact> toGroundedFact(
+  const parser::pddl::Ground & ground, const parser::pddl::Domain & domain)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  std::vector<SymbolTable::Id> args;
+  args.reserve(ground.params.size());
+  for (std::size_t i = 0; i < ground.params.size(); i++) {
+    // object() also finds the objects of the subtypes, which are indexed after its own
+    auto name = domain.types[ground.lifted->params[i]]->object(ground.params[i]).first;
+    if (name.empty()) {
+      return {};
+    }
+    args.push_back(symbols.intern(name));
+  }
+
+  if (domain.funcs.index(ground.name) < 0) {
+    return GroundedFact(
+      plansys2_msgs::msg::Node::PREDICATE, symbols.intern(ground.name), args);
+  }
+
+  double value = 0.0;
+  if (auto func = dynamic_cast<const parser::pddl::GroundFunc<double> *>(&ground)) {
+    value = func->value;
+  } else if (auto int_func = dynamic_cast<const parser::pddl::GroundFunc<int> *>(&ground)) {
+    value = int_func->value;
+  }
+  return GroundedFact(
+    plansys2_msgs::msg::Node::FUNCTION, symbols.intern(ground.name), args, value);
+}
+
+// Check that the arguments of a predicate or function match the ones of its model
+template<class Model, class GetInstance>
+bool checkArgumentTypes(
+  const plansys2_msgs::msg::Node & node, const std::optional<Model> & model,
+  const DomainExpert & domain_expert, GetInstance get_instance)
+{
+  if (!model || model.value().parameters.size() != node.parameters.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < node.parameters.size(); i++) {
+    auto arg_type = get_instance(node.parameters[i].name);
+
+    if (!arg_type.has_value() ||
+      !domain_expert.isSubtype(arg_type.value().type, model.value().parameters[i].type))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Line of a predicate in the :init section of getProblem()
+void appendPredicateLine(std::string & text, const GroundedFact & predicate)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  std::string name = symbols.getName(predicate.getName());
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+  text += "\t( ";
+  text += name;
+  for (size_t i = 0; i < predicate.getArity(); i++) {
+    text += " ";
+    text += symbols.getName(predicate.getArg(i));
+  }
+  text += " )\n";
+}
+
+// Line of a function in the :init section of getProblem()
+std::string getFunctionLine(const GroundedFact & function)
+{
+  auto & symbols = SymbolTable::getInstance();
+
+  std::string name = symbols.getName(function.getName());
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+  std::ostringstream stream;
+  stream << "\t( = ( " << name;
+  for (size_t i = 0; i < function.getArity(); i++) {
+    stream << " " << symbols.getName(function.getArg(i));
+  }
+  stream << " ) " << function.getValue() << " )\n";
+  return stream.str();
+}
+
+// Adapts a ProblemExpert to evaluateInState without changing it: the changes of an effect
+// are kept apart, on top of the knowledge, until they are committed as a single update
+class StagedChanges
+{
+public:
+  explicit StagedChanges(ProblemExpert & problem_expert)
+  : problem_expert_(problem_expert) {}
+
+  bool existPredicate(const plansys2_msgs::msg::Node & predicate) const
+  {
+    auto it = predicates_.find(parser::pddl::toString(predicate));
+    if (it != predicates_.end()) {
+      return it->second.second;
+    }
+    return problem_expert_.existPredicate(predicate);
+  }
+
+  void addPredicate(const plansys2_msgs::msg::Node & predicate)
+  {
+    predicates_[parser::pddl::toString(predicate)] = {predicate, true};
+  }
+
+  void removePredicate(const plansys2_msgs::msg::Node & predicate)
+  {
+    predicates_[parser::pddl::toString(predicate)] = {predicate, false};
+  }
+
+  std::optional<double> getFunctionValue(const plansys2_msgs::msg::Node & function) const
+  {
+    auto expr = parser::pddl::toString(function);
+    auto it = functions_.find(expr);
+    if (it != functions_.end()) {
+      return it->second.value;
+    }
+    auto current = problem_expert_.getFunction(expr);
+    if (!current) {
+      return {};
+    }
+    return current.value().value;
+  }
+
+  void setFunctionValue(const plansys2_msgs::msg::Node & function, double value)
+  {
+    auto & staged = functions_[parser::pddl::toString(function)];
+    staged = function;
+    staged.value = value;
+  }
+
+  KnowledgeUpdate getUpdate() const
+  {
+    KnowledgeUpdate update;
+    for (const auto & predicate : predicates_) {
+      if (predicate.second.second) {
+        update.add_predicates.push_back(predicate.second.first);
+      } else {
+        update.remove_predicates.push_back(predicate.second.first);
+      }
+    }
+    for (const auto & function : functions_) {
+      update.add_functions.push_back(function.second);
+    }
+    return update;
+  }
+
+private:
+  ProblemExpert & problem_expert_;
+  // Changed fact -> (fact, whether it holds after the change)
+  std::map<std::string, std::pair<plansys2::Predicate, bool>> predicates_;
+  std::map<std::string, plansys2::Function> functions_;
+};
+
+}  // namespace
+
 ProblemExpert::ProblemExpert(std::shared_ptr<DomainExpert> & domain_expert)
 : domain_expert_(domain_expert)
 {
@@ -46,7 +338,8 @@ ProblemExpert::addInstance(const plansys2::Instance & instance)
   } else if (existInstance(instance.name)) {
     return false;
   } else {
-    instances_.push_back(instance);
+    instances_.insert(instance);
+    recordInstance(instance, true);
     return true;
   }
 }
@@ -54,47 +347,44 @@ ProblemExpert::addInstance(const plansys2::Instance & instance)
 std::vector<plansys2::Instance>
 ProblemExpert::getInstances()
 {
-  return instances_;
+  return *getInstancesSnapshot();
 }
 
-bool
-ProblemExpert::removeInstance(const plansys2::Instance & instance)
+ProblemExpert::Snapshot<plansys2::Instance>
+ProblemExpert::getInstancesSnapshot()
 {
-  bool found = false;
-  int i = 0;
-
-  while (!found && i < instances_.size()) {
-    if (instances_[i].name == instance.name) {
-      found = true;
-      instances_.erase(instances_.begin() + i);
-    }
-    i++;
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  if (instances_snapshot_ == nullptr) {
+    instances_snapshot_ = std::make_shared<const std::vector<plansys2::Instance>>(
+      instances_.values());
   }
+  return instances_snapshot_;
+}
 
+bool
+ProblemExpert::removeInstance(const plansys2::Instance & instance)
+{
   // (fmrico)ToDo: We should remove all goals containing the removed instance
   removeFunctionsReferencing(instance);
   removePredicatesReferencing(instance);
 
+  bool found = instances_.erase(instance);
+  if (found) {
+    recordInstance(instance, false);
+  }
+
   return found;
 }
 
 std::optional<plansys2::Instance>
 ProblemExpert::getInstance(const std::string & instance_name)
 {
-  plansys2::Instance ret;
-
-  bool found = false;
-  int i = 0;
-  while (i < instances_.size() && !found) {
-    if (instances_[i].name == instance_name) {
-      found = true;
-      ret = instances_[i];
-    }
-    i++;
-  }
+  plansys2::Instance instance;
+  instance.name = instance_name;
 
-  if (found) {
-    return ret;
+  auto id = instances_.find(instance);
+  if (id != instances_.npos) {
+    return instances_[id];
   } else {
     return {};
   }
@@ -103,7 +393,23 @@ ProblemExpert::getInstance(const std::string & instance_name)
 std::vector<plansys2::Predicate>
 ProblemExpert::getPredicates()
 {
-  return predicates_;
+  return *getPredicatesSnapshot();
+}
+
+ProblemExpert::Snapshot<plansys2::Predicate>
+ProblemExpert::getPredicatesSnapshot()
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  if (predicates_snapshot_ == nullptr) {
+    std::vector<plansys2::Predicate> predicates;
+    predicates.reserve(predicates_.size());
+    for (const auto & fact : predicates_) {
+      predicates.push_back(fromGroundedFact(fact));
+    }
+    predicates_snapshot_ =
+      std::make_shared<const std::vector<plansys2::Predicate>>(std::move(predicates));
+  }
+  return predicates_snapshot_;
 }
 
 bool
@@ -111,7 +417,10 @@ ProblemExpert::addPredicate(const plansys2::Predicate & predicate)
 {
   if (!existPredicate(predicate)) {
     if (isValidPredicate(predicate)) {
-      predicates_.push_back(predicate);
+      auto fact = toGroundedFact(predicate);
+      auto id = predicates_.insert(fact).first;
+      indexPredicate(fact, id);
+      recordPredicate(fact, true);
       return true;
     } else {
       return false;
@@ -124,41 +433,126 @@ ProblemExpert::addPredicate(const plansys2::Predicate & predicate)
 bool
 ProblemExpert::removePredicate(const plansys2::Predicate & predicate)
 {
-  bool found = false;
-  int i = 0;
-
   if (!isValidPredicate(predicate)) {  // if predicate is not valid, error
     return false;
   }
-  while (!found && i < predicates_.size()) {
-    if (parser::pddl::checkNodeEquality(predicates_[i], predicate)) {
-      found = true;
-      predicates_.erase(predicates_.begin() + i);
+
+  auto fact = findGroundedFact(predicate);
+  if (fact) {
+    auto id = predicates_.find(fact.value());
+    if (id != predicates_.npos) {
+      recordPredicate(predicates_[id], false);
+      unindexPredicate(predicates_[id], id);
+      predicates_.erase(id);
     }
-    i++;
   }
 
   return true;
 }
 
-std::optional<plansys2::Predicate>
-ProblemExpert::getPredicate(const std::string & expr)
+std::vector<plansys2::Predicate>
+ProblemExpert::queryPredicates(
+  const plansys2::Predicate & pattern, std::size_t offset, std::size_t max_results,
+  std::size_t * total)
 {
-  plansys2::Predicate ret;
-  plansys2::Predicate pred = parser::pddl::fromStringPredicate(expr);
+  if (total != nullptr) {
+    *total = 0;
+  }
+
+  auto & symbols = SymbolTable::getInstance();
+  auto name = symbols.lookup(pattern.name);
+  if (!name) {
+    return {};
+  }
 
-  bool found = false;
-  size_t i = 0;
-  while (i < predicates_.size() && !found) {
-    if (parser::pddl::checkNodeEquality(predicates_[i], pred)) {
-      found = true;
-      ret = predicates_[i];
+  auto by_name = predicates_by_name_.find(name.value());
+  if (by_name == predicates_by_name_.end()) {
+    return {};
+  }
+
+  // Bound arguments as (position, instance), and unbound arguments repeated in the pattern
+  // as (position, first position of the same argument)
+  std::vector<std::pair<uint32_t, SymbolTable::Id>> bound;
+  std::vector<std::pair<uint32_t, uint32_t>> repeated;
+  std::unordered_map<std::string, uint32_t> unbound;
+  for (uint32_t i = 0; i < pattern.parameters.size(); i++) {
+    const auto & arg = pattern.parameters[i].name;
+    if (!arg.empty() && arg[0] == '?') {
+      auto first = unbound.emplace(arg, i).first;
+      if (first->second != i) {
+        repeated.emplace_back(i, first->second);
+      }
+    } else {
+      auto value = symbols.lookup(arg);
+      if (!value) {
+        return {};
+      }
+      bound.emplace_back(i, value.value());
     }
-    i++;
   }
 
-  if (found) {
-    return ret;
+  // Start from the smallest posting list of the bound arguments
+  const auto * candidates = &by_name->second;
+  for (const auto & arg : bound) {
+    auto it = predicates_by_argument_.find({name.value(), arg.first, arg.second});
+    if (it == predicates_by_argument_.end()) {
+      return {};
+    }
+    if (it->second.size() < candidates->size()) {
+      candidates = &it->second;
+    }
+  }
+
+  std::vector<PredicateStore::Id> matches;
+  for (auto id : *candidates) {
+    const auto & predicate = predicates_[id];
+    if (predicate.getArity() != pattern.parameters.size()) {
+      continue;
+    }
+
+    bool match = std::all_of(
+      bound.begin(), bound.end(), [&predicate](const auto & arg) {
+        return predicate.getArg(arg.first) == arg.second;
+      }) &&
+      std::all_of(
+      repeated.begin(), repeated.end(), [&predicate](const auto & arg) {
+        return predicate.getArg(arg.first) == predicate.getArg(arg.second);
+      });
+    if (match) {
+      matches.push_back(id);
+    }
+  }
+
+  // Posting lists are unordered, but ids are stable while the knowledge does not change
+  std::sort(matches.begin(), matches.end());
+
+  if (total != nullptr) {
+    *total = matches.size();
+  }
+
+  std::size_t end = matches.size();
+  if (max_results > 0 && offset < end) {
+    end = std::min(end, offset + max_results);
+  }
+
+  std::vector<plansys2::Predicate> ret;
+  for (std::size_t i = offset; i < end; i++) {
+    ret.push_back(fromGroundedFact(predicates_[matches[i]]));
+  }
+  return ret;
+}
+
+std::optional<plansys2::Predicate>
+ProblemExpert::getPredicate(const std::string & expr)
+{
+  auto fact = findGroundedFact(parser::pddl::fromStringPredicate(expr));
+  if (!fact) {
+    return {};
+  }
+
+  auto id = predicates_.find(fact.value());
+  if (id != predicates_.npos) {
+    return fromGroundedFact(predicates_[id]);
   } else {
     return {};
   }
@@ -167,7 +561,23 @@ ProblemExpert::getPredicate(const std::string & expr)
 std::vector<plansys2::Function>
 ProblemExpert::getFunctions()
 {
-  return functions_;
+  return *getFunctionsSnapshot();
+}
+
+ProblemExpert::Snapshot<plansys2::Function>
+ProblemExpert::getFunctionsSnapshot()
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  if (functions_snapshot_ == nullptr) {
+    std::vector<plansys2::Function> functions;
+    functions.reserve(functions_.size());
+    for (const auto & fact : functions_) {
+      functions.push_back(fromGroundedFact(fact));
+    }
+    functions_snapshot_ =
+      std::make_shared<const std::vector<plansys2::Function>>(std::move(functions));
+  }
+  return functions_snapshot_;
 }
 
 bool
@@ -175,7 +585,10 @@ ProblemExpert::addFunction(const plansys2::Function & function)
 {
   if (!existFunction(function)) {
     if (isValidFunction(function)) {
-      functions_.push_back(function);
+      auto fact = toGroundedFact(function);
+      auto id = functions_.insert(fact).first;
+      addReferences(function_references_, fact, id);
+      recordFunction(fact, true);
       return true;
     } else {
       return false;
@@ -188,18 +601,18 @@ ProblemExpert::addFunction(const plansys2::Function & function)
 bool
 ProblemExpert::removeFunction(const plansys2::Function & function)
 {
-  bool found = false;
-  int i = 0;
-
   if (!isValidFunction(function)) {  // if function is not valid, error
     return false;
   }
-  while (!found && i < functions_.size()) {
-    if (parser::pddl::checkNodeEquality(functions_[i], function)) {
-      found = true;
-      functions_.erase(functions_.begin() + i);
+
+  auto fact = findGroundedFact(function);
+  if (fact) {
+    auto id = functions_.find(fact.value());
+    if (id != functions_.npos) {
+      recordFunction(functions_[id], false);
+      removeReferences(function_references_, functions_[id], id);
+      functions_.erase(id);
     }
-    i++;
   }
 
   return true;
@@ -208,10 +621,17 @@ ProblemExpert::removeFunction(const plansys2::Function & function)
 bool
 ProblemExpert::updateFunction(const plansys2::Function & function)
 {
-  if (existFunction(function)) {
+  auto fact = findGroundedFact(function);
+  auto id = fact ? functions_.find(fact.value()) : functions_.npos;
+  if (id != functions_.npos) {
     if (isValidFunction(function)) {
-      removeFunction(function);
-      functions_.push_back(function);
+      // Updated functions are moved to the end, as if they were removed and added again. An
+      // update to the same value changes nothing, not even the order, as it is not a revision
+      if (functions_[id].getValue() != function.value) {
+        functions_[id].setValue(function.value);
+        recordFunction(functions_[id], true);
+        functions_.moveToBack(id);
+      }
       return true;
     } else {
       return false;
@@ -221,24 +641,36 @@ ProblemExpert::updateFunction(const plansys2::Function & function)
   }
 }
 
+std::size_t
+ProblemExpert::setFunctionValues(const std::vector<GroundedFact> & functions)
+{
+  std::size_t changed = 0;
+  for (const auto & function : functions) {
+    auto id = functions_.find(function);
+    if (id == functions_.npos || functions_[id].getValue() == function.getValue()) {
+      continue;
+    }
+
+    // As in updateFunction, updated functions are moved to the end
+    functions_[id].setValue(function.getValue());
+    recordFunction(functions_[id], true);
+    functions_.moveToBack(id);
+    changed++;
+  }
+  return changed;
+}
+
 std::optional<plansys2::Function>
 ProblemExpert::getFunction(const std::string & expr)
 {
-  plansys2::Function ret;
-  plansys2::Function func = parser::pddl::fromStringFunction(expr);
-
-  bool found = false;
-  size_t i = 0;
-  while (i < functions_.size() && !found) {
-    if (parser::pddl::checkNodeEquality(functions_[i], func)) {
-      found = true;
-      ret = functions_[i];
-    }
-    i++;
+  auto fact = findGroundedFact(parser::pddl::fromStringFunction(expr));
+  if (!fact) {
+    return {};
   }
 
-  if (found) {
-    return ret;
+  auto id = functions_.find(fact.value());
+  if (id != functions_.npos) {
+    return fromGroundedFact(functions_[id]);
   } else {
     return {};
   }
@@ -247,43 +679,291 @@ ProblemExpert::getFunction(const std::string & expr)
 bool
 ProblemExpert::removeFunctionsReferencing(const plansys2_msgs::msg::Param & param)
 {
-  int i = 0;
+  auto symbol = SymbolTable::getInstance().lookup(param.name);
+  if (!symbol) {
+    return false;
+  }
 
-  while (i < functions_.size()) {
-    bool found = false;
-    for (plansys2::Instance parameter : functions_[i].parameters) {
-      if (parameter.name == param.name) {
-        functions_.erase(functions_.begin() + i);
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      i++;
-    }
+  auto it = function_references_.find(symbol.value());
+  if (it == function_references_.end()) {
+    return false;
   }
-  return false;
+
+  // Copied, as removeReferences modifies the posting list we would be iterating
+  std::vector<FunctionStore::Id> referencing(it->second.begin(), it->second.end());
+  for (auto id : referencing) {
+    recordFunction(functions_[id], false);
+    removeReferences(function_references_, functions_[id], id);
+    functions_.erase(id);
+  }
+  return true;
 }
 
 bool
 ProblemExpert::removePredicatesReferencing(const plansys2_msgs::msg::Param & param)
 {
-  int i = 0;
+  auto symbol = SymbolTable::getInstance().lookup(param.name);
+  if (!symbol) {
+    return false;
+  }
+
+  auto it = predicate_references_.find(symbol.value());
+  if (it == predicate_references_.end()) {
+    return false;
+  }
+
+  // Copied, as removeReferences modifies the posting list we would be iterating
+  std::vector<PredicateStore::Id> referencing(it->second.begin(), it->second.end());
+  for (auto id : referencing) {
+    recordPredicate(predicates_[id], false);
+    unindexPredicate(predicates_[id], id);
+    predicates_.erase(id);
+  }
+  return true;
+}
+
+void
+ProblemExpert::indexPredicate(const GroundedFact & predicate, PredicateStore::Id id)
+{
+  addReferences(predicate_references_, predicate, id);
+  predicates_by_name_[predicate.getName()].insert(id);
+  for (uint32_t i = 0; i < predicate.getArity(); i++) {
+    predicates_by_argument_[{predicate.getName(), i, predicate.getArg(i)}].insert(id);
+  }
+}
 
-  while (i < predicates_.size()) {
-    bool found = false;
-    for (plansys2::Instance parameter : predicates_[i].parameters) {
-      if (parameter.name == param.name) {
-        predicates_.erase(predicates_.begin() + i);
-        found = true;
-        break;
+void
+ProblemExpert::unindexPredicate(const GroundedFact & predicate, PredicateStore::Id id)
+{
+  removeReferences(predicate_references_, predicate, id);
+
+  auto by_name = predicates_by_name_.find(predicate.getName());
+  if (by_name != predicates_by_name_.end()) {
+    by_name->second.erase(id);
+    if (by_name->second.empty()) {
+      predicates_by_name_.erase(by_name);
+    }
+  }
+
+  for (uint32_t i = 0; i < predicate.getArity(); i++) {
+    auto by_argument = predicates_by_argument_.find(
+      {predicate.getName(), i, predicate.getArg(i)});
+    if (by_argument != predicates_by_argument_.end()) {
+      by_argument->second.erase(id);
+      if (by_argument->second.empty()) {
+        predicates_by_argument_.erase(by_argument);
       }
     }
-    if (!found) {
-      i++;
+  }
+}
+
+plansys2_msgs::msg::Node
+ProblemExpert::fromGroundedFact(const GroundedFact & fact)
+{
+  auto node = toNode(fact);
+  for (auto & param : node.parameters) {
+    auto instance = getInstance(param.name);
+    if (instance) {
+      param.type = instance.value().type;
     }
   }
-  return false;
+  return node;
+}
+
+void
+ProblemExpert::setDeltaTracking(bool enabled)
+{
+  delta_tracking_ = enabled;
+  takeDelta();
+}
+
+plansys2_msgs::msg::KnowledgeDelta
+ProblemExpert::takeDelta()
+{
+  plansys2_msgs::msg::KnowledgeDelta ret;
+  ret.base_revision = delta_base_revision_;
+  ret.revision = revision_;
+  ret.reset = delta_reset_;
+
+  for (const auto & change : instance_changes_) {
+    if (change.second.removed) {
+      ret.removed_instances.push_back(plansys2::Instance(change.first));
+    }
+    if (change.second.added) {
+      ret.added_instances.push_back(change.second.added.value());
+    }
+  }
+
+  for (const auto & change : predicate_changes_) {
+    if (change.second) {
+      ret.added_predicates.push_back(fromGroundedFact(change.first));
+    } else {
+      ret.removed_predicates.push_back(toNode(change.first));
+    }
+  }
+
+  for (const auto & change : function_changes_) {
+    if (change.second) {
+      // The key keeps the value the function had when it first changed
+      auto id = functions_.find(change.first);
+      ret.added_functions.push_back(fromGroundedFact(functions_[id]));
+    } else {
+      ret.removed_functions.push_back(toNode(change.first));
+    }
+  }
+
+  ret.goal_changed = delta_goal_changed_;
+  if (delta_goal_changed_) {
+    ret.goal = goal_;
+  }
+
+  delta_base_revision_ = revision_;
+  delta_reset_ = false;
+  delta_goal_changed_ = false;
+  instance_changes_.clear();
+  predicate_changes_.clear();
+  function_changes_.clear();
+
+  return ret;
+}
+
+plansys2_msgs::msg::KnowledgeDelta
+ProblemExpert::getSnapshot()
+{
+  plansys2_msgs::msg::KnowledgeDelta ret;
+  ret.base_revision = revision_;
+  ret.revision = revision_;
+  ret.reset = true;
+  auto instances = getInstancesSnapshot();
+  auto predicates = getPredicatesSnapshot();
+  auto functions = getFunctionsSnapshot();
+  ret.added_instances.assign(instances->begin(), instances->end());
+  ret.added_predicates.assign(predicates->begin(), predicates->end());
+  ret.added_functions.assign(functions->begin(), functions->end());
+  ret.goal_changed = true;
+  ret.goal = goal_;
+  return ret;
+}
+
+bool
+ProblemExpert::applyDelta(const plansys2_msgs::msg::KnowledgeDelta & delta)
+{
+  if (delta.reset) {
+    clearKnowledge();
+  }
+
+  for (const auto & function : delta.removed_functions) {
+    removeFunction(function);
+  }
+  for (const auto & predicate : delta.removed_predicates) {
+    removePredicate(predicate);
+  }
+  for (const auto & instance : delta.removed_instances) {
+    removeInstance(instance);
+  }
+
+  bool success = true;
+  for (const auto & instance : delta.added_instances) {
+    success = addInstance(instance) && success;
+  }
+  for (const auto & predicate : delta.added_predicates) {
+    success = addPredicate(predicate) && success;
+  }
+  for (const auto & function : delta.added_functions) {
+    success = addFunction(function) && success;
+  }
+
+  if (delta.goal_changed) {
+    if (delta.goal.nodes.empty()) {
+      clearGoal();
+    } else {
+      success = setGoal(delta.goal) && success;
+    }
+  }
+
+  return success;
+}
+
+void
+ProblemExpert::recordInstance(const plansys2::Instance & instance, bool added)
+{
+  revision_++;
+  // Facts are built with the types of their instances, but an added instance is in no fact
+  // yet, and the facts of a removed one are removed, and recorded, before it. So the fact
+  // snapshots stay valid
+  instances_snapshot_.reset();
+  objects_text_.reset();
+  if (!delta_tracking_) {
+    return;
+  }
+
+  // An instance removed and added again is sent as both changes, as the removal also
+  // removes the facts that referred to it
+  auto & change = instance_changes_[instance.name];
+  if (added) {
+    change.added = instance;
+  } else {
+    change.removed = true;
+    change.added.reset();
+  }
+}
+
+void
+ProblemExpert::recordPredicate(const GroundedFact & predicate, bool added)
+{
+  revision_++;
+  predicates_snapshot_.reset();
+  // New predicates go to the end, so only removals change the previous text
+  if (added && predicates_text_) {
+    appendPredicateLine(predicates_text_.value(), predicate);
+  } else {
+    predicates_text_.reset();
+  }
+  if (delta_tracking_) {
+    predicate_changes_[predicate] = added;
+  }
+}
+
+void
+ProblemExpert::recordFunction(const GroundedFact & function, bool added)
+{
+  revision_++;
+  functions_snapshot_.reset();
+  functions_text_.reset();
+  function_lines_.erase(function);
+  if (delta_tracking_) {
+    function_changes_[function] = added;
+  }
+}
+
+void
+ProblemExpert::recordGoal()
+{
+  revision_++;
+  goal_text_.reset();
+  if (delta_tracking_) {
+    delta_goal_changed_ = true;
+  }
+}
+
+void
+ProblemExpert::recordReset()
+{
+  revision_++;
+  instances_snapshot_.reset();
+  predicates_snapshot_.reset();
+  functions_snapshot_.reset();
+  objects_text_.reset();
+  predicates_text_.reset();
+  functions_text_.reset();
+  function_lines_.clear();
+  if (delta_tracking_) {
+    // Nothing recorded before the reset matters anymore, except the goal
+    delta_reset_ = true;
+    instance_changes_.clear();
+    predicate_changes_.clear();
+    function_changes_.clear();
+  }
 }
 
 plansys2::Goal
@@ -297,6 +977,7 @@ ProblemExpert::setGoal(const plansys2::Goal & goal)
 {
   if (isValidGoal(goal)) {
     goal_ = goal;
+    recordGoal();
     return true;
   } else {
     return false;
@@ -305,13 +986,16 @@ ProblemExpert::setGoal(const plansys2::Goal & goal)
 
 bool ProblemExpert::isGoalSatisfied(const plansys2::Goal & goal)
 {
-  return check(goal, predicates_, functions_);
+  auto predicates = getPredicates();
+  auto functions = getFunctions();
+  return check(goal, predicates, functions);
 }
 
 bool
 ProblemExpert::clearGoal()
 {
   goal_.nodes.clear();
+  recordGoal();
   return true;
 }
 
@@ -321,138 +1005,238 @@ ProblemExpert::clearKnowledge()
   instances_.clear();
   predicates_.clear();
   functions_.clear();
+  predicate_references_.clear();
+  predicates_by_name_.clear();
+  predicates_by_argument_.clear();
+  function_references_.clear();
+  recordReset();
   return true;
 }
 
 bool
-ProblemExpert::isValidType(const std::string & type)
+ProblemExpert::updateKnowledge(const KnowledgeUpdate & update)
 {
-  auto valid_types = domain_expert_->getTypes();
-  auto it = std::find(valid_types.begin(), valid_types.end(), type);
+  for (const auto & function : update.remove_functions) {
+    if (!isValidFunction(function)) {
+      return false;
+    }
+  }
+
+  for (const auto & predicate : update.remove_predicates) {
+    if (!isValidPredicate(predicate)) {
+      return false;
+    }
+  }
+
+  std::unordered_set<std::string> removed_instances;
+  for (const auto & instance : update.remove_instances) {
+    if (!existInstance(instance.name) || !removed_instances.insert(instance.name).second) {
+      return false;
+    }
+  }
+
+  std::unordered_map<std::string, plansys2::Instance> added_instances;
+  for (const auto & instance : update.add_instances) {
+    if (!isValidType(instance.type)) {
+      return false;
+    } else if (existInstance(instance.name) && removed_instances.count(instance.name) == 0) {
+      return false;
+    } else if (!added_instances.emplace(instance.name, instance).second) {
+      return false;
+    }
+  }
+
+  // New facts are checked against the instances that will exist after the update
+  auto get_instance = [&](const std::string & name) -> std::optional<plansys2::Instance> {
+      auto added = added_instances.find(name);
+      if (added != added_instances.end()) {
+        return added->second;
+      } else if (removed_instances.count(name) > 0) {
+        return {};
+      } else {
+        return getInstance(name);
+      }
+    };
 
-  return it != valid_types.end();
+  for (const auto & predicate : update.add_predicates) {
+    if (!checkArgumentTypes(
+        predicate, domain_expert_->getPredicate(predicate.name), *domain_expert_,
+        get_instance))
+    {
+      return false;
+    }
+  }
+
+  for (const auto & function : update.add_functions) {
+    if (!checkArgumentTypes(
+        function, domain_expert_->getFunction(function.name), *domain_expert_,
+        get_instance))
+    {
+      return false;
+    }
+  }
+
+  // Everything is valid at this point, so none of these can fail
+  for (const auto & function : update.remove_functions) {
+    removeFunction(function);
+  }
+  for (const auto & predicate : update.remove_predicates) {
+    removePredicate(predicate);
+  }
+  for (const auto & instance : update.remove_instances) {
+    removeInstance(instance);
+  }
+  for (const auto & instance : update.add_instances) {
+    addInstance(instance);
+  }
+  for (const auto & predicate : update.add_predicates) {
+    addPredicate(predicate);
+  }
+  for (const auto & function : update.add_functions) {
+    addFunction(function);
+  }
+
+  return true;
+}
+
+std::tuple<bool, bool, double>
+ProblemExpert::applyEffect(const plansys2_msgs::msg::Tree & tree, uint32_t node_id)
+{
+  StagedChanges staged(*this);
+  auto result = evaluateInState(tree, staged, true, node_id);
+  if (!std::get<0>(result) || !updateKnowledge(staged.getUpdate())) {
+    std::get<0>(result) = false;
+  }
+  return result;
 }
 
 bool
-ProblemExpert::existInstance(const std::string & name)
+ProblemExpert::addFacts(
+  const std::vector<plansys2::Instance> & instances,
+  const std::vector<GroundedFact> & predicates,
+  const std::vector<GroundedFact> & functions)
 {
-  bool found = false;
-  int i = 0;
+  auto & symbols = SymbolTable::getInstance();
 
-  while (!found && i < instances_.size()) {
-    if (instances_[i].name == name) {
-      found = true;
+  FactValidator validator(domain_expert_, [this](SymbolTable::Id name) {
+      return getInstanceType(name);
+    });
+  for (const auto & instance : instances) {
+    if (!validator.addInstance(symbols.intern(instance.name), instance.type)) {
+      return false;
     }
-    i++;
   }
 
-  return found;
+  for (const auto & predicate : predicates) {
+    if (predicate.getNodeType() != plansys2_msgs::msg::Node::PREDICATE ||
+      !validator.isValid(predicate))
+    {
+      return false;
+    }
+  }
+  for (const auto & function : functions) {
+    if (function.getNodeType() != plansys2_msgs::msg::Node::FUNCTION ||
+      !validator.isValid(function))
+    {
+      return false;
+    }
+  }
+
+  insertFacts(instances, predicates, functions);
+  return true;
 }
 
-bool
-ProblemExpert::existPredicate(const plansys2::Predicate & predicate)
+void
+ProblemExpert::insertFacts(
+  const std::vector<plansys2::Instance> & instances,
+  const std::vector<GroundedFact> & predicates,
+  const std::vector<GroundedFact> & functions)
 {
-  bool found = false;
-  int i = 0;
+  // Everything is valid at this point
+  instances_.reserve(instances_.size() + instances.size());
+  for (const auto & instance : instances) {
+    instances_.insert(instance);
+    recordInstance(instance, true);
+  }
 
-  while (!found && i < predicates_.size()) {
-    if (parser::pddl::checkNodeEquality(predicates_[i], predicate)) {
-      found = true;
+  predicates_.reserve(predicates_.size() + predicates.size());
+  for (const auto & predicate : predicates) {
+    auto inserted = predicates_.insert(predicate);
+    if (inserted.second) {
+      indexPredicate(predicate, inserted.first);
+      recordPredicate(predicate, true);
     }
-    i++;
   }
 
-  return found;
+  functions_.reserve(functions_.size() + functions.size());
+  for (const auto & function : functions) {
+    auto inserted = functions_.insert(function);
+    if (inserted.second) {
+      addReferences(function_references_, function, inserted.first);
+      recordFunction(function, true);
+    } else if (functions_[inserted.first].getValue() != function.getValue()) {
+      functions_[inserted.first].setValue(function.getValue());
+      recordFunction(functions_[inserted.first], true);
+    }
+  }
 }
 
-bool
-ProblemExpert::existFunction(const plansys2::Function & function)
+std::optional<std::string>
+ProblemExpert::getInstanceType(SymbolTable::Id name)
 {
-  bool found = false;
-  int i = 0;
+  plansys2::Instance instance;
+  instance.name = SymbolTable::getInstance().getName(name);
 
-  while (!found && i < functions_.size()) {
-    if (parser::pddl::checkNodeEquality(functions_[i], function)) {
-      found = true;
-    }
-    i++;
+  auto id = instances_.find(instance);
+  if (id == instances_.npos) {
+    return {};
   }
+  return instances_[id].type;
+}
 
-  return found;
+bool
+ProblemExpert::isValidType(const std::string & type)
+{
+  return domain_expert_->existType(type);
 }
 
 bool
-ProblemExpert::isValidPredicate(const plansys2::Predicate & predicate)
+ProblemExpert::existInstance(const std::string & name)
 {
-  bool valid = false;
-
-  const std::optional<plansys2::Predicate> & model_predicate =
-    domain_expert_->getPredicate(predicate.name);
-  if (model_predicate) {
-    if (model_predicate.value().parameters.size() == predicate.parameters.size()) {
-      bool same_types = true;
-      int i = 0;
-      while (same_types && i < predicate.parameters.size()) {
-        auto arg_type = getInstance(predicate.parameters[i].name);
-
-        if (!arg_type.has_value()) {
-          same_types = false;
-        } else if (arg_type.value().type != model_predicate.value().parameters[i].type) {
-          bool isSubtype = false;
-          for (std::string subType : model_predicate.value().parameters[i].sub_types) {
-            if (arg_type.value().type == subType) {
-              isSubtype = true;
-              break;
-            }
-          }
-          if (!isSubtype) {
-            same_types = false;
-          }
-        }
-        i++;
-      }
-      valid = same_types;
-    }
-  }
+  plansys2::Instance instance;
+  instance.name = name;
 
-  return valid;
+  return instances_.contains(instance);
 }
 
 bool
-ProblemExpert::isValidFunction(const plansys2::Function & function)
+ProblemExpert::existPredicate(const plansys2::Predicate & predicate)
 {
-  bool valid = false;
-
-  const std::optional<plansys2::Function> & model_function =
-    domain_expert_->getFunction(function.name);
-  if (model_function) {
-    if (model_function.value().parameters.size() == function.parameters.size()) {
-      bool same_types = true;
-      int i = 0;
-      while (same_types && i < function.parameters.size()) {
-        auto arg_type = getInstance(function.parameters[i].name);
-
-        if (!arg_type.has_value()) {
-          same_types = false;
-        } else if (arg_type.value().type != model_function.value().parameters[i].type) {
-          bool isSubtype = false;
-          for (std::string subType : model_function.value().parameters[i].sub_types) {
-            if (arg_type.value().type == subType) {
-              isSubtype = true;
-              break;
-            }
-          }
-          if (!isSubtype) {
-            same_types = false;
-          }
-        }
-        i++;
-      }
-      valid = same_types;
-    }
-  }
+  auto fact = findGroundedFact(predicate);
+  return fact && predicates_.contains(fact.value());
+}
 
-  return valid;
+bool
+ProblemExpert::existFunction(const plansys2::Function & function)
+{
+  auto fact = findGroundedFact(function);
+  return fact && functions_.contains(fact.value());
+}
+
+bool
+ProblemExpert::isValidPredicate(const plansys2::Predicate & predicate)
+{
+  return checkArgumentTypes(
+    predicate, domain_expert_->getPredicate(predicate.name), *domain_expert_,
+    [this](const std::string & name) {return getInstance(name);});
+}
+
+bool
+ProblemExpert::isValidFunction(const plansys2::Function & function)
+{
+  return checkArgumentTypes(
+    function, domain_expert_->getFunction(function.name), *domain_expert_,
+    [this](const std::string & name) {return getInstance(name);});
 }
 
 bool
@@ -534,62 +1318,98 @@ ProblemExpert::checkPredicateTreeTypes(
   return false;
 }
 
+std::shared_ptr<parser::pddl::Domain>
+ProblemExpert::getParsedDomain()
+{
+  auto domain_str = domain_expert_->getDomain();
+  if (parsed_domain_ == nullptr || domain_str != parsed_domain_str_) {
+    parsed_domain_ = std::make_shared<parser::pddl::Domain>(domain_str);
+    parsed_domain_str_ = std::move(domain_str);
+    // The objects are listed by the types of the domain
+    objects_text_.reset();
+  }
+  return parsed_domain_;
+}
+
 std::string
 ProblemExpert::getProblem()
 {
-  parser::pddl::Domain domain(domain_expert_->getDomain());
-  parser::pddl::Instance problem(domain);
-
-  problem.name = "problem_1";
-
-  for (const auto & instance : instances_) {
-    problem.addObject(instance.name, instance.type);
-  }
+  std::lock_guard<std::mutex> lock(problem_text_mutex_);
 
-  for (plansys2_msgs::msg::Node predicate : predicates_) {
-    StringVec v;
+  auto domain = getParsedDomain();
 
-    for (size_t i = 0; i < predicate.parameters.size(); i++) {
-      v.push_back(predicate.parameters[i].name);
+  if (!objects_text_) {
+    std::unordered_map<std::string, std::string> objects_by_type;
+    for (const auto & instance : instances_) {
+      objects_by_type[instance.type] += instance.name + " ";
     }
 
-    std::transform(predicate.name.begin(), predicate.name.end(), predicate.name.begin(), ::tolower);
-
-    problem.addInit(predicate.name, v);
+    std::string text;
+    for (unsigned i = 0; i < domain->types.size(); i++) {
+      auto it = objects_by_type.find(domain->types[i]->name);
+      if (it != objects_by_type.end()) {
+        text += "\t" + it->second;
+        if (domain->typed) {
+          text += "- " + domain->types[i]->name;
+        }
+        text += "\n";
+      }
+    }
+    objects_text_ = std::move(text);
   }
 
-  for (plansys2_msgs::msg::Node function : functions_) {
-    StringVec v;
-
-    for (size_t i = 0; i < function.parameters.size(); i++) {
-      v.push_back(function.parameters[i].name);
+  if (!predicates_text_) {
+    std::string text;
+    for (const auto & predicate : predicates_) {
+      appendPredicateLine(text, predicate);
     }
+    predicates_text_ = std::move(text);
+  }
 
-    std::transform(
-      function.name.begin(), function.name.end(),
-      function.name.begin(), ::tolower);
-
-    problem.addInit(function.name, function.value, v);
+  if (!functions_text_) {
+    std::string text;
+    for (const auto & function : functions_) {
+      auto it = function_lines_.find(function);
+      if (it == function_lines_.end()) {
+        it = function_lines_.emplace(function, getFunctionLine(function)).first;
+      }
+      text += it->second;
+    }
+    functions_text_ = std::move(text);
   }
 
-  std::vector<plansys2_msgs::msg::Node> predicates;
-  parser::pddl::getPredicates(predicates, goal_);
+  if (!goal_text_) {
+    std::vector<plansys2_msgs::msg::Node> predicates;
+    parser::pddl::getPredicates(predicates, goal_);
 
-  for (auto predicate : predicates) {
-    StringVec v;
+    std::string text;
+    for (auto predicate : predicates) {
+      std::transform(
+        predicate.name.begin(), predicate.name.end(), predicate.name.begin(), ::tolower);
 
-    for (size_t i = 0; i < predicate.parameters.size(); i++) {
-      v.push_back(predicate.parameters[i].name);
+      text += "\t\t( " + predicate.name;
+      for (const auto & param : predicate.parameters) {
+        text += " " + param.name;
+      }
+      text += " )\n";
     }
-
-    std::transform(predicate.name.begin(), predicate.name.end(), predicate.name.begin(), ::tolower);
-
-    problem.addGoal(predicate.name, v);
+    goal_text_ = std::move(text);
   }
 
-  std::ostringstream stream;
-  stream << problem;
-  return stream.str();
+  std::string problem = "( define ( problem problem_1 )\n( :domain " + domain->name + " )\n";
+  problem.reserve(
+    problem.size() + objects_text_.value().size() + predicates_text_.value().size() +
+    functions_text_.value().size() + goal_text_.value().size() + 64);
+
+  problem += "( :objects\n";
+  problem += objects_text_.value();
+  problem += ")\n( :init\n";
+  problem += predicates_text_.value();
+  problem += functions_text_.value();
+  problem += ")\n( :goal\n\t( and\n";
+  problem += goal_text_.value();
+  problem += "\t)\n)\n)\n";
+  return problem;
 }
 
 bool
@@ -608,9 +1428,6 @@ ProblemExpert::addProblem(const std::string & problem_str)
 
   lc_problem = remove_comments(lc_problem);
 
-  std::cout << "Domain:\n" << domain << std::endl;
-  std::cout << "Problem:\n" << lc_problem << std::endl;
-
   parser::pddl::Instance problem(domain);
 
   std::string domain_name = problem.getDomainName(lc_problem);
@@ -631,53 +1448,50 @@ ProblemExpert::addProblem(const std::string & problem_str)
     return false;
   }
 
-  std::cout << "Parsed problem: " << problem << std::endl;
+  // The objects and the init facts are validated and added in bulk: the signature of each
+  // predicate and function is looked up once, and the facts are not built as nodes
+  auto & symbols = SymbolTable::getInstance();
+  FactValidator validator(domain_expert_, [this](SymbolTable::Id name) {
+      return getInstanceType(name);
+    });
 
+  std::vector<plansys2::Instance> instances;
   for (unsigned i = 0; i < domain.types.size(); ++i) {
-    if (domain.types[i]->objects.size() ) {
-      for (unsigned j = 0; j < domain.types[i]->objects.size(); ++j) {
-        plansys2::Instance instance;
-        instance.name = domain.types[i]->objects[j];
-        instance.type = domain.types[i]->name;
-        std::cout << "Adding instance: " << instance.name << " " << instance.type << std::endl;
-        addInstance(instance);
+    for (unsigned j = 0; j < domain.types[i]->objects.size(); ++j) {
+      plansys2::Instance instance;
+      instance.name = domain.types[i]->objects[j];
+      instance.type = domain.types[i]->name;
+      if (validator.addInstance(symbols.intern(instance.name), instance.type)) {
+        instances.push_back(instance);
+      } else {
+        std::cerr << "Failed to add instance: " << instance.name << " " << instance.type <<
+          std::endl;
       }
     }
   }
 
-  plansys2_msgs::msg::Tree tree;
+  std::vector<GroundedFact> predicates;
+  std::vector<GroundedFact> functions;
+  predicates.reserve(problem.init.size());
   for (auto ground : problem.init) {
-    auto tree_node = ground->getTree(tree, domain);
-    switch (tree_node->node_type) {
-      case plansys2_msgs::msg::Node::PREDICATE: {
-          plansys2::Predicate pred_node(*tree_node);
-          std::cout << "Adding predicate: " <<
-            parser::pddl::toString(tree, tree_node->node_id) << std::endl;
-          if (!addPredicate(pred_node)) {
-            std::cerr << "Failed to add predicate: " << parser::pddl::toString(
-              tree,
-              tree_node->node_id) <<
-              std::endl;
-          }
-        }
-        break;
-      case plansys2_msgs::msg::Node::FUNCTION: {
-          plansys2::Function func_node(*tree_node);
-          std::cout << "Adding function: " <<
-            parser::pddl::toString(tree, tree_node->node_id) << std::endl;
-          if (!addFunction(func_node)) {
-            std::cerr << "Failed to add function: " << parser::pddl::toString(
-              tree,
-              tree_node->node_id) <<
-              std::endl;
-          }
-        }
-        break;
-      default:
-        break;
+    auto fact = toGroundedFact(*ground, domain);
+    if (fact && validator.isValid(fact.value())) {
+      if (fact.value().getNodeType() == plansys2_msgs::msg::Node::PREDICATE) {
+        predicates.push_back(fact.value());
+      } else {
+        functions.push_back(fact.value());
+      }
+    } else {
+      plansys2_msgs::msg::Tree tree;
+      auto tree_node = ground->getTree(tree, domain);
+      std::cerr << "Failed to add " <<
+        (tree_node->node_type == plansys2_msgs::msg::Node::FUNCTION ? "function" : "predicate") <<
+        ": " << parser::pddl::toString(tree, tree_node->node_id) << std::endl;
     }
   }
 
+  insertFacts(instances, predicates, functions);
+
   plansys2_msgs::msg::Node node;
   node.node_type = plansys2_msgs::msg::Node::AND;
   node.node_id = 0;
@@ -687,11 +1501,8 @@ ProblemExpert::addProblem(const std::string & problem_str)
   goal.nodes.push_back(node);
   for (auto ground : problem.goal) {
     auto goal_node = ground->getTree(goal, domain);
-    std::cout << "Adding goal node: " <<
-      parser::pddl::toString(goal, goal_node->node_id) << std::endl;
     goal.nodes[0].children.push_back(goal_node->node_id);
   }
-  std::cout << "Adding Goal: " << parser::pddl::toString(goal) << std::endl;
   setGoal(goal);
 
   return true;
@@ -16,18 +16,71 @@
 
 #include <optional>
 #include <algorithm>
+#include <iomanip>
+#include <random>
+#include <sstream>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <memory>
 
 #include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/State.hpp"
 
 namespace plansys2
 {
 
-ProblemExpertClient::ProblemExpertClient()
+namespace
 {
-  node_ = rclcpp::Node::make_shared("problem_expert_client");
+
+// The watches of a client are removed when its node leaves the graph, so the name of the
+// node tells each client apart from the rest, in this and in other processes
+std::string
+unique_node_name(const std::string & prefix)
+{
+  std::random_device device;
+  std::mt19937_64 generator((static_cast<uint64_t>(device()) << 32) | device());
+  std::ostringstream name;
+  name << prefix << "_" << std::hex << std::setw(16) << std::setfill('0') << generator();
+  return name.str();
+}
+
+// Adapts the replica to evaluateInState. Only expressions that are not applied are
+// evaluated on it: effects are sent to the problem expert, and the replica gets them
+// with the deltas, as any other change
+class ReplicaState
+{
+public:
+  explicit ReplicaState(const KnowledgeReplica & replica)
+  : replica_(replica) {}
+
+  bool existPredicate(const plansys2_msgs::msg::Node & predicate) const
+  {
+    return replica_.existPredicate(predicate);
+  }
+
+  std::optional<double> getFunctionValue(const plansys2_msgs::msg::Node & function) const
+  {
+    return replica_.getFunctionValue(function);
+  }
+
+  void addPredicate(const plansys2_msgs::msg::Node &) {}
+  void removePredicate(const plansys2_msgs::msg::Node &) {}
+  void setFunctionValue(const plansys2_msgs::msg::Node &, double) {}
+
+private:
+  const KnowledgeReplica & replica_;
+};
+
+}  // namespace
+
+ProblemExpertClient::ProblemExpertClient(
+  bool use_cache, std::chrono::nanoseconds cache_timeout, const std::string & context)
+: context_(context),
+  use_cache_(use_cache),
+  cache_timeout_(cache_timeout)
+{
+  node_ = rclcpp::Node::make_shared(unique_node_name("problem_expert_client"));
 
   add_problem_client_ = node_->create_client<plansys2_msgs::srv::AddProblem>(
     "problem_expert/add_problem");
@@ -51,6 +104,8 @@ ProblemExpertClient::ProblemExpertClient()
     "problem_expert/get_problem_predicate");
   get_problem_predicates_client_ = node_->create_client<plansys2_msgs::srv::GetStates>(
     "problem_expert/get_problem_predicates");
+  query_predicates_client_ = node_->create_client<plansys2_msgs::srv::QueryPredicates>(
+    "problem_expert/query_predicates");
   get_problem_function_details_client_ =
     node_->create_client<plansys2_msgs::srv::GetNodeDetails>(
     "problem_expert/get_problem_function");
@@ -80,14 +135,161 @@ ProblemExpertClient::ProblemExpertClient()
   update_problem_function_client_ =
     node_->create_client<plansys2_msgs::srv::AffectNode>(
     "problem_expert/update_problem_function");
+  evaluate_client_ = node_->create_client<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/evaluate");
+  apply_client_ = node_->create_client<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/apply");
   is_problem_goal_satisfied_client_ =
     node_->create_client<plansys2_msgs::srv::IsProblemGoalSatisfied>(
     "problem_expert/is_problem_goal_satisfied");
+  update_knowledge_client_ =
+    node_->create_client<plansys2_msgs::srv::UpdateKnowledge>(
+    "problem_expert/update_knowledge");
+  add_watch_client_ = node_->create_client<plansys2_msgs::srv::AddWatch>(
+    "problem_expert/add_watch");
+  remove_watch_client_ = node_->create_client<plansys2_msgs::srv::RemoveWatch>(
+    "problem_expert/remove_watch");
+  get_applicable_actions_client_ =
+    node_->create_client<plansys2_msgs::srv::GetApplicableActions>(
+    "problem_expert/get_applicable_actions");
+  function_updates_pub_ = node_->create_publisher<plansys2_msgs::msg::FunctionUpdates>(
+    "problem_expert/function_updates", rclcpp::QoS(100));
+
+  if (use_cache_) {
+    cache_node_ = rclcpp::Node::make_shared("problem_expert_client_cache");
+
+    knowledge_delta_sub_ = cache_node_->create_subscription<plansys2_msgs::msg::KnowledgeDelta>(
+      "problem_expert/knowledge_delta", rclcpp::QoS(100),
+      std::bind(&ProblemExpertClient::knowledgeDeltaCallback, this, std::placeholders::_1));
+    get_knowledge_snapshot_client_ =
+      cache_node_->create_client<plansys2_msgs::srv::GetKnowledgeSnapshot>(
+      "problem_expert/get_knowledge_snapshot");
+
+    // Retries the synchronization until the problem expert is available
+    snapshot_timer_ = cache_node_->create_wall_timer(
+      std::chrono::milliseconds(100), [this]() {
+        bool synced;
+        {
+          std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+          synced = replica_.isSynced();
+        }
+        if (!synced) {
+          requestSnapshot();
+        }
+      });
+
+    cache_executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+    cache_executor_->add_node(cache_node_);
+    cache_thread_ = std::thread([this]() {cache_executor_->spin();});
+  }
+}
+
+ProblemExpertClient::~ProblemExpertClient()
+{
+  if (cache_executor_ != nullptr) {
+    cache_executor_->cancel();
+    cache_thread_.join();
+  }
+}
+
+std::shared_lock<std::shared_mutex>
+ProblemExpertClient::acquireCache()
+{
+  if (!use_cache_) {
+    return {};
+  }
+
+  auto ready = [this]() {
+      return replica_.isSynced() && (min_cache_epoch_ == 0 ||
+             (replica_.getEpoch() == min_cache_epoch_ &&
+             replica_.getRevision() >= min_cache_revision_));
+    };
+
+  std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+  if (ready() || cache_cond_.wait_for(lock, cache_timeout_, ready)) {
+    return lock;
+  } else {
+    return {};
+  }
+}
+
+void
+ProblemExpertClient::updateMinCacheRevision(uint64_t epoch, uint64_t revision)
+{
+  // A new epoch means that the problem expert has restarted, and the replica has to wait
+  // for its knowledge
+  std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+  if (epoch != min_cache_epoch_) {
+    min_cache_epoch_ = epoch;
+    min_cache_revision_ = revision;
+  } else if (revision > min_cache_revision_) {
+    min_cache_revision_ = revision;
+  }
+}
+
+void
+ProblemExpertClient::knowledgeDeltaCallback(
+  const plansys2_msgs::msg::KnowledgeDelta::SharedPtr msg)
+{
+  if (msg->context != context_) {
+    return;
+  }
+
+  bool applied;
+  {
+    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+    applied = replica_.apply(*msg);
+  }
+  cache_cond_.notify_all();
+
+  if (!applied) {
+    requestSnapshot();
+  }
+}
+
+void
+ProblemExpertClient::requestSnapshot()
+{
+  // Only called from cache_thread_, as the response callback
+  auto now = std::chrono::steady_clock::now();
+  if (snapshot_pending_ && now - snapshot_request_time_ < std::chrono::seconds(1)) {
+    return;
+  }
+  if (!get_knowledge_snapshot_client_->service_is_ready()) {
+    return;
+  }
+
+  snapshot_pending_ = true;
+  snapshot_request_time_ = now;
+  auto request_id = ++snapshot_request_id_;
+  auto request = std::make_shared<plansys2_msgs::srv::GetKnowledgeSnapshot::Request>();
+  request->context = context_;
+  get_knowledge_snapshot_client_->async_send_request(
+    request,
+    [this, request_id](
+      rclcpp::Client<plansys2_msgs::srv::GetKnowledgeSnapshot>::SharedFuture future) {
+      // The response of a request given up is still valid, but another one is pending
+      if (request_id == snapshot_request_id_) {
+        snapshot_pending_ = false;
+      }
+      auto response = future.get();
+      if (response->success) {
+        {
+          std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+          replica_.apply(response->snapshot);
+        }
+        cache_cond_.notify_all();
+      }
+    });
 }
 
 std::vector<plansys2::Instance>
 ProblemExpertClient::getInstances()
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getInstances();
+  }
+
   while (!get_problem_instances_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -100,6 +302,8 @@ ProblemExpertClient::getInstances()
 
   auto request = std::make_shared<plansys2_msgs::srv::GetProblemInstances::Request>();
 
+  request->context = context_;
+
   auto future_result = get_problem_instances_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -135,6 +339,8 @@ ProblemExpertClient::addInstance(const plansys2::Instance & instance)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectParam::Request>();
+
+  request->context = context_;
   request->param = instance;
 
   auto future_result = add_problem_instance_client_->async_send_request(request);
@@ -146,6 +352,7 @@ ProblemExpertClient::addInstance(const plansys2::Instance & instance)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -170,6 +377,8 @@ ProblemExpertClient::removeInstance(const plansys2::Instance & instance)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectParam::Request>();
+
+  request->context = context_;
   request->param = instance;
 
   auto future_result = remove_problem_instance_client_->async_send_request(request);
@@ -181,6 +390,7 @@ ProblemExpertClient::removeInstance(const plansys2::Instance & instance)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -195,6 +405,10 @@ ProblemExpertClient::removeInstance(const plansys2::Instance & instance)
 std::optional<plansys2::Instance>
 ProblemExpertClient::getInstance(const std::string & name)
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getInstance(name);
+  }
+
   while (!get_problem_instance_details_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -207,6 +421,8 @@ ProblemExpertClient::getInstance(const std::string & name)
 
   auto request = std::make_shared<plansys2_msgs::srv::GetProblemInstanceDetails::Request>();
 
+  request->context = context_;
+
   request->instance = name;
 
   auto future_result = get_problem_instance_details_client_->async_send_request(request);
@@ -231,6 +447,10 @@ ProblemExpertClient::getInstance(const std::string & name)
 std::vector<plansys2::Predicate>
 ProblemExpertClient::getPredicates()
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getPredicates();
+  }
+
   while (!get_problem_predicates_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -243,6 +463,10 @@ ProblemExpertClient::getPredicates()
 
   auto request = std::make_shared<plansys2_msgs::srv::GetStates::Request>();
 
+  request->context = context_;
+  request->if_newer_than = last_predicates_revision_;
+  request->epoch = last_predicates_epoch_;
+
   auto future_result = get_problem_predicates_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -252,8 +476,13 @@ ProblemExpertClient::getPredicates()
   }
 
   if (future_result.get()->success) {
-    return plansys2::convertVector<plansys2::Predicate, plansys2_msgs::msg::Node>(
-      future_result.get()->states);
+    if (!future_result.get()->unchanged) {
+      last_predicates_ = plansys2::convertVector<plansys2::Predicate, plansys2_msgs::msg::Node>(
+        future_result.get()->states);
+      last_predicates_revision_ = future_result.get()->revision;
+      last_predicates_epoch_ = future_result.get()->epoch;
+    }
+    return last_predicates_;
   } else {
     RCLCPP_ERROR_STREAM(
       node_->get_logger(),
@@ -263,6 +492,55 @@ ProblemExpertClient::getPredicates()
   }
 }
 
+std::vector<plansys2::Predicate>
+ProblemExpertClient::queryPredicates(
+  const plansys2::Predicate & pattern, std::size_t offset, std::size_t max_results,
+  std::size_t * total)
+{
+  if (total != nullptr) {
+    *total = 0;
+  }
+
+  while (!query_predicates_client_->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return {};
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      query_predicates_client_->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::QueryPredicates::Request>();
+
+  request->context = context_;
+  request->pattern = pattern;
+  request->offset = offset;
+  request->max_results = max_results;
+
+  auto future_result = query_predicates_client_->async_send_request(request);
+
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return {};
+  }
+
+  if (future_result.get()->success) {
+    if (total != nullptr) {
+      *total = future_result.get()->total;
+    }
+    return plansys2::convertVector<plansys2::Predicate, plansys2_msgs::msg::Node>(
+      future_result.get()->matches);
+  } else {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      query_predicates_client_->get_service_name() << ": " <<
+        future_result.get()->error_info);
+    return {};
+  }
+}
+
 bool
 ProblemExpertClient::addPredicate(const plansys2::Predicate & predicate)
 {
@@ -277,6 +555,8 @@ ProblemExpertClient::addPredicate(const plansys2::Predicate & predicate)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectNode::Request>();
+
+  request->context = context_;
   request->node = predicate;
 
   auto future_result = add_problem_predicate_client_->async_send_request(request);
@@ -288,6 +568,7 @@ ProblemExpertClient::addPredicate(const plansys2::Predicate & predicate)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -312,6 +593,8 @@ ProblemExpertClient::removePredicate(const plansys2::Predicate & predicate)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectNode::Request>();
+
+  request->context = context_;
   request->node = predicate;
 
   auto future_result = remove_problem_predicate_client_->async_send_request(request);
@@ -323,6 +606,7 @@ ProblemExpertClient::removePredicate(const plansys2::Predicate & predicate)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -336,6 +620,10 @@ ProblemExpertClient::removePredicate(const plansys2::Predicate & predicate)
 bool
 ProblemExpertClient::existPredicate(const plansys2::Predicate & predicate)
 {
+  if (auto cache = acquireCache()) {
+    return replica_.existPredicate(predicate);
+  }
+
   while (!exist_problem_predicate_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return false;
@@ -347,6 +635,8 @@ ProblemExpertClient::existPredicate(const plansys2::Predicate & predicate)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::ExistNode::Request>();
+
+  request->context = context_;
   request->node = predicate;
 
   auto future_result = exist_problem_predicate_client_->async_send_request(request);
@@ -363,6 +653,10 @@ ProblemExpertClient::existPredicate(const plansys2::Predicate & predicate)
 std::optional<plansys2::Predicate>
 ProblemExpertClient::getPredicate(const std::string & predicate)
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getPredicate(predicate);
+  }
+
   while (!get_problem_predicate_details_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -375,6 +669,8 @@ ProblemExpertClient::getPredicate(const std::string & predicate)
 
   auto request = std::make_shared<plansys2_msgs::srv::GetNodeDetails::Request>();
 
+  request->context = context_;
+
   request->expression = predicate;
 
   auto future_result = get_problem_predicate_details_client_->async_send_request(request);
@@ -399,6 +695,10 @@ ProblemExpertClient::getPredicate(const std::string & predicate)
 std::vector<plansys2::Function>
 ProblemExpertClient::getFunctions()
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getFunctions();
+  }
+
   while (!get_problem_functions_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -411,6 +711,10 @@ ProblemExpertClient::getFunctions()
 
   auto request = std::make_shared<plansys2_msgs::srv::GetStates::Request>();
 
+  request->context = context_;
+  request->if_newer_than = last_functions_revision_;
+  request->epoch = last_functions_epoch_;
+
   auto future_result = get_problem_functions_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -420,8 +724,13 @@ ProblemExpertClient::getFunctions()
   }
 
   if (future_result.get()->success) {
-    return plansys2::convertVector<plansys2::Function, plansys2_msgs::msg::Node>(
-      future_result.get()->states);
+    if (!future_result.get()->unchanged) {
+      last_functions_ = plansys2::convertVector<plansys2::Function, plansys2_msgs::msg::Node>(
+        future_result.get()->states);
+      last_functions_revision_ = future_result.get()->revision;
+      last_functions_epoch_ = future_result.get()->epoch;
+    }
+    return last_functions_;
   } else {
     RCLCPP_ERROR_STREAM(
       node_->get_logger(),
@@ -445,6 +754,8 @@ ProblemExpertClient::addFunction(const plansys2::Function & function)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectNode::Request>();
+
+  request->context = context_;
   request->node = function;
 
   auto future_result = add_problem_function_client_->async_send_request(request);
@@ -459,6 +770,7 @@ ProblemExpertClient::addFunction(const plansys2::Function & function)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -483,6 +795,8 @@ ProblemExpertClient::removeFunction(const plansys2::Function & function)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectNode::Request>();
+
+  request->context = context_;
   request->node = function;
 
   auto future_result = remove_problem_function_client_->async_send_request(request);
@@ -494,6 +808,7 @@ ProblemExpertClient::removeFunction(const plansys2::Function & function)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -507,6 +822,10 @@ ProblemExpertClient::removeFunction(const plansys2::Function & function)
 bool
 ProblemExpertClient::existFunction(const plansys2::Function & function)
 {
+  if (auto cache = acquireCache()) {
+    return replica_.existFunction(function);
+  }
+
   while (!exist_problem_function_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return false;
@@ -518,6 +837,8 @@ ProblemExpertClient::existFunction(const plansys2::Function & function)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::ExistNode::Request>();
+
+  request->context = context_;
   request->node = function;
 
   auto future_result = exist_problem_function_client_->async_send_request(request);
@@ -544,6 +865,8 @@ bool ProblemExpertClient::updateFunction(const plansys2::Function & function)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AffectNode::Request>();
+
+  request->context = context_;
   request->node = function;
 
   auto future_result = update_problem_function_client_->async_send_request(request);
@@ -555,6 +878,7 @@ bool ProblemExpertClient::updateFunction(const plansys2::Function & function)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -565,9 +889,22 @@ bool ProblemExpertClient::updateFunction(const plansys2::Function & function)
   }
 }
 
+void
+ProblemExpertClient::publishFunctions(const std::vector<plansys2::Function> & functions)
+{
+  plansys2_msgs::msg::FunctionUpdates msg;
+  msg.context = context_;
+  msg.functions.assign(functions.begin(), functions.end());
+  function_updates_pub_->publish(msg);
+}
+
 std::optional<plansys2::Function>
 ProblemExpertClient::getFunction(const std::string & function)
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getFunction(function);
+  }
+
   while (!get_problem_function_details_client_->wait_for_service(std::chrono::seconds(5))) {
     if (!rclcpp::ok()) {
       return {};
@@ -580,6 +917,8 @@ ProblemExpertClient::getFunction(const std::string & function)
 
   auto request = std::make_shared<plansys2_msgs::srv::GetNodeDetails::Request>();
 
+  request->context = context_;
+
   request->expression = function;
 
   auto future_result = get_problem_function_details_client_->async_send_request(request);
@@ -605,6 +944,10 @@ ProblemExpertClient::getFunction(const std::string & function)
 plansys2::Goal
 ProblemExpertClient::getGoal()
 {
+  if (auto cache = acquireCache()) {
+    return replica_.getGoal();
+  }
+
   plansys2_msgs::msg::Tree ret;
 
   while (!get_problem_goal_client_->wait_for_service(std::chrono::seconds(5))) {
@@ -619,6 +962,8 @@ ProblemExpertClient::getGoal()
 
   auto request = std::make_shared<plansys2_msgs::srv::GetProblemGoal::Request>();
 
+  request->context = context_;
+
   auto future_result = get_problem_goal_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -653,6 +998,8 @@ ProblemExpertClient::setGoal(const plansys2::Goal & goal)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AddProblemGoal::Request>();
+
+  request->context = context_;
   request->tree = goal;
 
   auto future_result = add_problem_goal_client_->async_send_request(request);
@@ -664,6 +1011,7 @@ ProblemExpertClient::setGoal(const plansys2::Goal & goal)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -688,6 +1036,8 @@ ProblemExpertClient::isGoalSatisfied(const plansys2::Goal & goal)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::IsProblemGoalSatisfied::Request>();
+
+  request->context = context_;
   request->tree = goal;
 
   auto future_result = is_problem_goal_satisfied_client_->async_send_request(request);
@@ -724,6 +1074,8 @@ ProblemExpertClient::clearGoal()
 
   auto request = std::make_shared<plansys2_msgs::srv::RemoveProblemGoal::Request>();
 
+  request->context = context_;
+
   auto future_result = remove_problem_goal_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -733,6 +1085,7 @@ ProblemExpertClient::clearGoal()
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -758,6 +1111,8 @@ ProblemExpertClient::clearKnowledge()
 
   auto request = std::make_shared<plansys2_msgs::srv::ClearProblemKnowledge::Request>();
 
+  request->context = context_;
+
   auto future_result = clear_problem_knowledge_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -767,6 +1122,7 @@ ProblemExpertClient::clearKnowledge()
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -778,6 +1134,107 @@ ProblemExpertClient::clearKnowledge()
 }
 
 
+bool
+ProblemExpertClient::updateKnowledge(const KnowledgeUpdate & update)
+{
+  while (!update_knowledge_client_->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return false;
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      update_knowledge_client_->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::UpdateKnowledge::Request>();
+
+  request->context = context_;
+  request->add_instances = plansys2::convertVector<plansys2_msgs::msg::Param, plansys2::Instance>(
+    update.add_instances);
+  request->add_predicates = plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Predicate>(
+    update.add_predicates);
+  request->add_functions = plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Function>(
+    update.add_functions);
+  request->remove_instances =
+    plansys2::convertVector<plansys2_msgs::msg::Param, plansys2::Instance>(
+    update.remove_instances);
+  request->remove_predicates =
+    plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Predicate>(
+    update.remove_predicates);
+  request->remove_functions =
+    plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Function>(
+    update.remove_functions);
+
+  auto future_result = update_knowledge_client_->async_send_request(request);
+
+  // Large batches take longer than a single change to be validated and applied
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(5)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return false;
+  }
+
+  if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
+    return true;
+  } else {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      update_knowledge_client_->get_service_name() << ": " <<
+        future_result.get()->error_info);
+    return false;
+  }
+}
+
+bool
+ProblemExpertClient::addInstances(const std::vector<plansys2::Instance> & instances)
+{
+  KnowledgeUpdate update;
+  update.add_instances = instances;
+  return updateKnowledge(update);
+}
+
+bool
+ProblemExpertClient::removeInstances(const std::vector<plansys2::Instance> & instances)
+{
+  KnowledgeUpdate update;
+  update.remove_instances = instances;
+  return updateKnowledge(update);
+}
+
+bool
+ProblemExpertClient::addPredicates(const std::vector<plansys2::Predicate> & predicates)
+{
+  KnowledgeUpdate update;
+  update.add_predicates = predicates;
+  return updateKnowledge(update);
+}
+
+bool
+ProblemExpertClient::removePredicates(const std::vector<plansys2::Predicate> & predicates)
+{
+  KnowledgeUpdate update;
+  update.remove_predicates = predicates;
+  return updateKnowledge(update);
+}
+
+bool
+ProblemExpertClient::addFunctions(const std::vector<plansys2::Function> & functions)
+{
+  KnowledgeUpdate update;
+  update.add_functions = functions;
+  return updateKnowledge(update);
+}
+
+bool
+ProblemExpertClient::removeFunctions(const std::vector<plansys2::Function> & functions)
+{
+  KnowledgeUpdate update;
+  update.remove_functions = functions;
+  return updateKnowledge(update);
+}
+
 std::string
 ProblemExpertClient::getProblem()
 {
@@ -793,6 +1250,10 @@ ProblemExpertClient::getProblem()
 
   auto request = std::make_shared<plansys2_msgs::srv::GetProblem::Request>();
 
+  request->context = context_;
+  request->if_newer_than = last_problem_revision_;
+  request->epoch = last_problem_epoch_;
+
   auto future_result = get_problem_client_->async_send_request(request);
 
   if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
@@ -802,7 +1263,12 @@ ProblemExpertClient::getProblem()
   }
 
   if (future_result.get()->success) {
-    return future_result.get()->problem;
+    if (!future_result.get()->unchanged) {
+      last_problem_ = future_result.get()->problem;
+      last_problem_revision_ = future_result.get()->revision;
+      last_problem_epoch_ = future_result.get()->epoch;
+    }
+    return last_problem_;
   } else {
     RCLCPP_ERROR_STREAM(
       node_->get_logger(),
@@ -826,6 +1292,8 @@ ProblemExpertClient::addProblem(const std::string & problem_str)
   }
 
   auto request = std::make_shared<plansys2_msgs::srv::AddProblem::Request>();
+
+  request->context = context_;
   request->problem = problem_str;
 
   auto future_result = add_problem_client_->async_send_request(request);
@@ -837,6 +1305,7 @@ ProblemExpertClient::addProblem(const std::string & problem_str)
   }
 
   if (future_result.get()->success) {
+    updateMinCacheRevision(future_result.get()->epoch, future_result.get()->revision);
     return true;
   } else {
     RCLCPP_ERROR_STREAM(
@@ -847,4 +1316,166 @@ ProblemExpertClient::addProblem(const std::string & problem_str)
   }
 }
 
+std::tuple<bool, bool, double>
+ProblemExpertClient::evaluate(const plansys2_msgs::msg::Tree & tree, bool apply, uint32_t node_id)
+{
+  if (!apply) {
+    if (auto cache = acquireCache()) {
+      ReplicaState state(replica_);
+      return evaluateInState(tree, state, false, node_id);
+    }
+  }
+
+  auto client = apply ? apply_client_ : evaluate_client_;
+
+  while (!client->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return std::make_tuple(false, false, 0);
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      client->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::EvaluateTree::Request>();
+
+  request->context = context_;
+  request->tree = tree;
+  request->node_id = node_id;
+
+  auto future_result = client->async_send_request(request);
+
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return std::make_tuple(false, false, 0);
+  }
+
+  auto result = future_result.get();
+  if (apply) {
+    updateMinCacheRevision(result->epoch, result->revision);
+  }
+  if (!result->success && !result->error_info.empty()) {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      client->get_service_name() << ": " << result->error_info);
+  }
+  return std::make_tuple(result->success, result->truth_value, result->value);
+}
+
+std::optional<uint64_t>
+ProblemExpertClient::addWatch(const plansys2_msgs::msg::Tree & condition, bool * value)
+{
+  while (!add_watch_client_->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return {};
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      add_watch_client_->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::AddWatch::Request>();
+
+  request->context = context_;
+  request->condition = condition;
+  request->owner = node_->get_fully_qualified_name();
+
+  auto future_result = add_watch_client_->async_send_request(request);
+
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return {};
+  }
+
+  if (future_result.get()->success) {
+    if (value != nullptr) {
+      *value = future_result.get()->value;
+    }
+    return future_result.get()->id;
+  } else {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      add_watch_client_->get_service_name() << ": " <<
+        future_result.get()->error_info);
+    return {};
+  }
+}
+
+bool
+ProblemExpertClient::removeWatch(uint64_t id)
+{
+  while (!remove_watch_client_->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return false;
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      remove_watch_client_->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::RemoveWatch::Request>();
+
+  request->context = context_;
+  request->id = id;
+
+  auto future_result = remove_watch_client_->async_send_request(request);
+
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return false;
+  }
+
+  if (future_result.get()->success) {
+    return true;
+  } else {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      remove_watch_client_->get_service_name() << ": " <<
+        future_result.get()->error_info);
+    return false;
+  }
+}
+
+std::vector<std::string>
+ProblemExpertClient::getApplicableActions()
+{
+  while (!get_applicable_actions_client_->wait_for_service(std::chrono::seconds(5))) {
+    if (!rclcpp::ok()) {
+      return {};
+    }
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      get_applicable_actions_client_->get_service_name() <<
+        " service  client: waiting for service to appear...");
+  }
+
+  auto request = std::make_shared<plansys2_msgs::srv::GetApplicableActions::Request>();
+
+  request->context = context_;
+
+  auto future_result = get_applicable_actions_client_->async_send_request(request);
+
+  if (rclcpp::spin_until_future_complete(node_, future_result, std::chrono::seconds(1)) !=
+    rclcpp::FutureReturnCode::SUCCESS)
+  {
+    return {};
+  }
+
+  if (future_result.get()->success) {
+    return future_result.get()->actions;
+  } else {
+    RCLCPP_ERROR_STREAM(
+      node_->get_logger(),
+      get_applicable_actions_client_->get_service_name() << ": " <<
+        future_result.get()->error_info);
+    return {};
+  }
+}
+
 }  // namespace plansys2
@@ -16,9 +16,14 @@
 
 #include <string>
 #include <memory>
+#include <random>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
 
 #include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/ProblemStateFile.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
 
 std::vector<std::string> tokenize(const std::string & string, const std::string & delim)
 {
@@ -39,6 +44,19 @@ std::vector<std::string> tokenize(const std::string & string, const std::string
   return tokens;
 }
 
+namespace
+{
+
+// Identifies a numbering of the revisions. It is never 0, so 0 means an unknown epoch
+uint64_t new_epoch()
+{
+  std::random_device device;
+  std::mt19937_64 generator((static_cast<uint64_t>(device()) << 32) | device());
+  return std::uniform_int_distribution<uint64_t>(1)(generator);
+}
+
+}  // namespace
+
 namespace plansys2
 {
 
@@ -47,48 +65,68 @@ ProblemExpertNode::ProblemExpertNode()
 {
   declare_parameter("model_file", "");
   declare_parameter("problem_file", "");
+  declare_parameter("problem_state_file", "");
+  declare_parameter("contexts", std::vector<std::string>{});
+  declare_parameter("publish_knowledge", true);
+  declare_parameter("knowledge_snapshot_period", 0.0);
+  declare_parameter("function_updates_period", 0.1);
+  declare_parameter("watch_expiration_period", 5.0);
+  declare_parameter("persistence_dir", "");
+  declare_parameter("persistence_durability", "batch");
+  declare_parameter("persistence_sync_period", 0.1);
+  declare_parameter("persistence_snapshot_period", 60.0);
+
+  // Queries run concurrently, updates one at a time. problem_mutex_ keeps them apart
+  read_callback_group_ = create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+  write_callback_group_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
 
   add_problem_service_ = create_service<plansys2_msgs::srv::AddProblem>(
     "problem_expert/add_problem",
     std::bind(
       &ProblemExpertNode::add_problem_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   add_problem_goal_service_ = create_service<plansys2_msgs::srv::AddProblemGoal>(
     "problem_expert/add_problem_goal",
     std::bind(
       &ProblemExpertNode::add_problem_goal_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   add_problem_instance_service_ = create_service<plansys2_msgs::srv::AffectParam>(
     "problem_expert/add_problem_instance",
     std::bind(
       &ProblemExpertNode::add_problem_instance_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   add_problem_predicate_service_ = create_service<plansys2_msgs::srv::AffectNode>(
     "problem_expert/add_problem_predicate",
     std::bind(
       &ProblemExpertNode::add_problem_predicate_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   add_problem_function_service_ = create_service<plansys2_msgs::srv::AffectNode>(
     "problem_expert/add_problem_function",
     std::bind(
       &ProblemExpertNode::add_problem_function_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   get_problem_goal_service_ = create_service<plansys2_msgs::srv::GetProblemGoal>(
     "problem_expert/get_problem_goal",
     std::bind(
       &ProblemExpertNode::get_problem_goal_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_instance_details_service_ =
     create_service<plansys2_msgs::srv::GetProblemInstanceDetails>(
@@ -96,110 +134,214 @@ ProblemExpertNode::ProblemExpertNode()
     std::bind(
       &ProblemExpertNode::get_problem_instance_details_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_instances_service_ = create_service<plansys2_msgs::srv::GetProblemInstances>(
     "problem_expert/get_problem_instances",
     std::bind(
       &ProblemExpertNode::get_problem_instances_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_predicate_details_service_ =
     create_service<plansys2_msgs::srv::GetNodeDetails>(
     "problem_expert/get_problem_predicate", std::bind(
       &ProblemExpertNode::get_problem_predicate_details_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_predicates_service_ = create_service<plansys2_msgs::srv::GetStates>(
     "problem_expert/get_problem_predicates",
     std::bind(
       &ProblemExpertNode::get_problem_predicates_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
+
+  query_predicates_service_ = create_service<plansys2_msgs::srv::QueryPredicates>(
+    "problem_expert/query_predicates",
+    std::bind(
+      &ProblemExpertNode::query_predicates_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_function_details_service_ =
     create_service<plansys2_msgs::srv::GetNodeDetails>(
     "problem_expert/get_problem_function", std::bind(
       &ProblemExpertNode::get_problem_function_details_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_functions_service_ = create_service<plansys2_msgs::srv::GetStates>(
     "problem_expert/get_problem_functions",
     std::bind(
       &ProblemExpertNode::get_problem_functions_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   get_problem_service_ = create_service<plansys2_msgs::srv::GetProblem>(
     "problem_expert/get_problem", std::bind(
       &ProblemExpertNode::get_problem_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   is_problem_goal_satisfied_service_ = create_service<plansys2_msgs::srv::IsProblemGoalSatisfied>(
     "problem_expert/is_problem_goal_satisfied", std::bind(
       &ProblemExpertNode::is_problem_goal_satisfied_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   remove_problem_goal_service_ = create_service<plansys2_msgs::srv::RemoveProblemGoal>(
     "problem_expert/remove_problem_goal",
     std::bind(
       &ProblemExpertNode::remove_problem_goal_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   clear_problem_knowledge_service_ = create_service<plansys2_msgs::srv::ClearProblemKnowledge>(
     "problem_expert/clear_problem_knowledge",
     std::bind(
       &ProblemExpertNode::clear_problem_knowledge_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   remove_problem_instance_service_ = create_service<plansys2_msgs::srv::AffectParam>(
     "problem_expert/remove_problem_instance",
     std::bind(
       &ProblemExpertNode::remove_problem_instance_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   remove_problem_predicate_service_ = create_service<plansys2_msgs::srv::AffectNode>(
     "problem_expert/remove_problem_predicate",
     std::bind(
       &ProblemExpertNode::remove_problem_predicate_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   remove_problem_function_service_ = create_service<plansys2_msgs::srv::AffectNode>(
     "problem_expert/remove_problem_function",
     std::bind(
       &ProblemExpertNode::remove_problem_function_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   exist_problem_predicate_service_ = create_service<plansys2_msgs::srv::ExistNode>(
     "problem_expert/exist_problem_predicate",
     std::bind(
       &ProblemExpertNode::exist_problem_predicate_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   exist_problem_function_service_ = create_service<plansys2_msgs::srv::ExistNode>(
     "problem_expert/exist_problem_function",
     std::bind(
       &ProblemExpertNode::exist_problem_function_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
+
+  evaluate_service_ = create_service<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/evaluate",
+    std::bind(
+      &ProblemExpertNode::evaluate_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
+
+  apply_service_ = create_service<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/apply",
+    std::bind(
+      &ProblemExpertNode::apply_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
 
   update_problem_function_service_ = create_service<plansys2_msgs::srv::AffectNode>(
     "problem_expert/update_problem_function",
     std::bind(
       &ProblemExpertNode::update_problem_function_service_callback,
       this, std::placeholders::_1, std::placeholders::_2,
-      std::placeholders::_3));
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  update_knowledge_service_ = create_service<plansys2_msgs::srv::UpdateKnowledge>(
+    "problem_expert/update_knowledge",
+    std::bind(
+      &ProblemExpertNode::update_knowledge_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  get_knowledge_snapshot_service_ = create_service<plansys2_msgs::srv::GetKnowledgeSnapshot>(
+    "problem_expert/get_knowledge_snapshot",
+    std::bind(
+      &ProblemExpertNode::get_knowledge_snapshot_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
+
+  add_watch_service_ = create_service<plansys2_msgs::srv::AddWatch>(
+    "problem_expert/add_watch",
+    std::bind(
+      &ProblemExpertNode::add_watch_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  remove_watch_service_ = create_service<plansys2_msgs::srv::RemoveWatch>(
+    "problem_expert/remove_watch",
+    std::bind(
+      &ProblemExpertNode::remove_watch_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  get_applicable_actions_service_ = create_service<plansys2_msgs::srv::GetApplicableActions>(
+    "problem_expert/get_applicable_actions",
+    std::bind(
+      &ProblemExpertNode::get_applicable_actions_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  add_problem_context_service_ = create_service<plansys2_msgs::srv::AffectContext>(
+    "problem_expert/add_problem_context",
+    std::bind(
+      &ProblemExpertNode::add_problem_context_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  remove_problem_context_service_ = create_service<plansys2_msgs::srv::AffectContext>(
+    "problem_expert/remove_problem_context",
+    std::bind(
+      &ProblemExpertNode::remove_problem_context_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, write_callback_group_);
+
+  get_problem_contexts_service_ = create_service<plansys2_msgs::srv::GetProblemContexts>(
+    "problem_expert/get_problem_contexts",
+    std::bind(
+      &ProblemExpertNode::get_problem_contexts_service_callback,
+      this, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3),
+    rmw_qos_profile_services_default, read_callback_group_);
 
   update_pub_ = create_publisher<std_msgs::msg::Empty>(
     "problem_expert/update_notify",
@@ -208,6 +350,18 @@ ProblemExpertNode::ProblemExpertNode()
   knowledge_pub_ = create_publisher<plansys2_msgs::msg::Knowledge>(
     "problem_expert/knowledge",
     rclcpp::QoS(100).transient_local());
+
+  knowledge_delta_pub_ = create_publisher<plansys2_msgs::msg::KnowledgeDelta>(
+    "problem_expert/knowledge_delta",
+    rclcpp::QoS(100));
+
+  watch_pub_ = create_publisher<plansys2_msgs::msg::WatchEvent>(
+    "problem_expert/watch_events",
+    rclcpp::QoS(100));
+
+  goal_status_pub_ = create_publisher<plansys2_msgs::msg::GoalStatus>(
+    "problem_expert/goal_status",
+    rclcpp::QoS(100).transient_local());
 }
 
 
@@ -240,17 +394,60 @@ ProblemExpertNode::on_configure(const rclcpp_lifecycle::State & state)
     domain_expert->extendDomain(domain_str);
   }
 
-  problem_expert_ = std::make_shared<ProblemExpert>(domain_expert);
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+  domain_expert_ = domain_expert;
+  contexts_.clear();
+  auto problem_expert = std::make_shared<ProblemExpert>(domain_expert_);
+
+  if (!configure_storage()) {
+    return CallbackReturnT::FAILURE;
+  }
 
   auto problem_file = get_parameter("problem_file").get_value<std::string>();
-  if (!problem_file.empty()) {
+  auto problem_state_file = get_parameter("problem_state_file").get_value<std::string>();
+  if (storage_ != nullptr && storage_->exists()) {
+    if (storage_->load(*problem_expert)) {
+      RCLCPP_INFO(
+        get_logger(), "[%s] Stored knowledge loaded (%zu deltas replayed)", get_name(),
+        storage_->getLogSize());
+    } else {
+      RCLCPP_ERROR(get_logger(), "[%s] Error loading the stored knowledge", get_name());
+      return CallbackReturnT::FAILURE;
+    }
+  } else if (!problem_state_file.empty()) {
+    if (!ProblemStateFile::load(problem_state_file, *problem_expert)) {
+      RCLCPP_ERROR(
+        get_logger(), "[%s] Error loading the problem state file %s", get_name(),
+        problem_state_file.c_str());
+      return CallbackReturnT::FAILURE;
+    }
+  } else if (!problem_file.empty()) {
     std::ifstream problem_ifs(problem_file);
     std::string problem_str((
         std::istreambuf_iterator<char>(problem_ifs)),
       std::istreambuf_iterator<char>());
-    problem_expert_->addProblem(problem_str);
+    problem_expert->addProblem(problem_str);
   }
 
+  // The initial problem, and the storage, are those of the default context. The other
+  // contexts start empty
+  contexts_[""] = create_context("", problem_expert);
+
+  for (const auto & id : get_parameter("contexts").get_value<std::vector<std::string>>()) {
+    if (!id.empty()) {
+      contexts_[id] = create_context(id, std::make_shared<ProblemExpert>(domain_expert_));
+    }
+  }
+
+  // The storage starts again from the loaded knowledge, as this problem expert numbers
+  // its revisions from scratch
+  if (storage_ != nullptr && !storage_->writeSnapshot(problem_expert->getSnapshot())) {
+    RCLCPP_ERROR(get_logger(), "[%s] Error writing the knowledge snapshot", get_name());
+    return CallbackReturnT::FAILURE;
+  }
+
+  publish_knowledge_ = get_parameter("publish_knowledge").get_value<bool>();
+
   RCLCPP_INFO(get_logger(), "[%s] Configured", get_name());
   return CallbackReturnT::SUCCESS;
 }
@@ -261,6 +458,58 @@ ProblemExpertNode::on_activate(const rclcpp_lifecycle::State & state)
   RCLCPP_INFO(get_logger(), "[%s] Activating...", get_name());
   update_pub_->on_activate();
   knowledge_pub_->on_activate();
+  knowledge_delta_pub_->on_activate();
+  watch_pub_->on_activate();
+  goal_status_pub_->on_activate();
+  {
+    std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+    for (auto & context : contexts_) {
+      publish_goal_status(*context.second);
+    }
+  }
+
+  // Late joiners can resync with these snapshots, or requesting one with the
+  // get_knowledge_snapshot service
+  auto snapshot_period = get_parameter("knowledge_snapshot_period").get_value<double>();
+  if (snapshot_period > 0.0) {
+    snapshot_timer_ = create_wall_timer(
+      std::chrono::duration<double>(snapshot_period),
+      [this]() {
+        std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+        for (const auto & context : contexts_) {
+          auto snapshot = context.second->problem_expert->getSnapshot();
+          snapshot.epoch = context.second->epoch;
+          snapshot.context = context.first;
+          knowledge_delta_pub_->publish(snapshot);
+        }
+      }, read_callback_group_);
+  }
+
+  auto watch_expiration_period = get_parameter("watch_expiration_period").get_value<double>();
+  if (watch_expiration_period > 0.0) {
+    watch_expiration_timer_ = create_wall_timer(
+      std::chrono::duration<double>(watch_expiration_period),
+      std::bind(&ProblemExpertNode::expire_watches, this), write_callback_group_);
+  }
+
+  // Values arriving in a period are applied at once, so a fluent published at a high rate
+  // produces at most one update per period
+  auto function_updates_period = get_parameter("function_updates_period").get_value<double>();
+  batch_function_updates_ = function_updates_period > 0.0;
+  if (batch_function_updates_) {
+    function_updates_timer_ = create_wall_timer(
+      std::chrono::duration<double>(function_updates_period),
+      std::bind(&ProblemExpertNode::apply_function_updates, this), write_callback_group_);
+  }
+  accepting_function_updates_ = true;
+
+  rclcpp::SubscriptionOptions function_updates_options;
+  function_updates_options.callback_group = read_callback_group_;
+  function_updates_sub_ = create_subscription<plansys2_msgs::msg::FunctionUpdates>(
+    "problem_expert/function_updates", rclcpp::QoS(100),
+    std::bind(&ProblemExpertNode::function_updates_callback, this, std::placeholders::_1),
+    function_updates_options);
+
   RCLCPP_INFO(get_logger(), "[%s] Activated", get_name());
   return CallbackReturnT::SUCCESS;
 }
@@ -269,8 +518,22 @@ CallbackReturnT
 ProblemExpertNode::on_deactivate(const rclcpp_lifecycle::State & state)
 {
   RCLCPP_INFO(get_logger(), "[%s] Deactivating...", get_name());
+  // The values still pending are applied while their update can be published. The timer
+  // may still be running, but it finds nothing to apply after this
+  accepting_function_updates_ = false;
+  function_updates_sub_ = nullptr;
+  if (function_updates_timer_ != nullptr) {
+    function_updates_timer_->cancel();
+  }
+  apply_function_updates();
+
   update_pub_->on_deactivate();
   knowledge_pub_->on_deactivate();
+  knowledge_delta_pub_->on_deactivate();
+  watch_pub_->on_deactivate();
+  goal_status_pub_->on_deactivate();
+  snapshot_timer_ = nullptr;
+  watch_expiration_timer_ = nullptr;
   RCLCPP_INFO(get_logger(), "[%s] Deactivated", get_name());
 
   return CallbackReturnT::SUCCESS;
@@ -308,17 +571,20 @@ ProblemExpertNode::add_problem_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AddProblem::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AddProblem::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     RCLCPP_INFO(get_logger(), "Adding problem:\n%s", request->problem.c_str());
-    response->success = problem_expert_->addProblem(request->problem);
+    response->success = context->problem_expert->addProblem(request->problem);
 
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Problem not valid";
     }
@@ -331,16 +597,19 @@ ProblemExpertNode::add_problem_goal_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AddProblemGoal::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AddProblemGoal::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     if (!parser::pddl::empty(request->tree)) {
-      response->success = problem_expert_->setGoal(request->tree);
+      response->success = context->problem_expert->setGoal(request->tree);
       if (response->success) {
-        update_pub_->publish(std_msgs::msg::Empty());
-        knowledge_pub_->publish(*get_knowledge_as_msg());
+        publish_knowledge_update(*context);
+        response->revision = context->problem_expert->getRevision();
+        response->epoch = context->epoch;
       } else {
         response->error_info = "Goal not valid";
       }
@@ -357,15 +626,18 @@ ProblemExpertNode::add_problem_instance_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectParam::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectParam::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->addInstance(request->param);
+    response->success = context->problem_expert->addInstance(request->param);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Instance not valid";
     }
@@ -378,15 +650,18 @@ ProblemExpertNode::add_problem_predicate_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->addPredicate(request->node);
+    response->success = context->problem_expert->addPredicate(request->node);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info =
         "Predicate [" + parser::pddl::toString(request->node) + "] not valid";
@@ -400,15 +675,18 @@ ProblemExpertNode::add_problem_function_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->addFunction(request->node);
+    response->success = context->problem_expert->addFunction(request->node);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info =
         "Function [" + parser::pddl::toString(request->node) + "] not valid";
@@ -422,13 +700,15 @@ ProblemExpertNode::get_problem_goal_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetProblemGoal::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetProblemGoal::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     response->success = true;
-    response->tree = problem_expert_->getGoal();
+    response->tree = context->problem_expert->getGoal();
   }
 }
 
@@ -438,12 +718,14 @@ ProblemExpertNode::get_problem_instance_details_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetProblemInstanceDetails::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetProblemInstanceDetails::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    auto instance = problem_expert_->getInstance(request->instance);
+    auto instance = context->problem_expert->getInstance(request->instance);
     if (instance) {
       response->success = true;
       response->instance = instance.value();
@@ -460,14 +742,16 @@ ProblemExpertNode::get_problem_instances_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetProblemInstances::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetProblemInstances::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     response->success = true;
-    response->instances = plansys2::convertVector<plansys2_msgs::msg::Param, plansys2::Instance>(
-      problem_expert_->getInstances());
+    auto instances = context->problem_expert->getInstancesSnapshot();
+    response->instances.assign(instances->begin(), instances->end());
   }
 }
 
@@ -477,12 +761,14 @@ ProblemExpertNode::get_problem_predicate_details_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetNodeDetails::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetNodeDetails::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    auto predicate = problem_expert_->getPredicate(request->expression);
+    auto predicate = context->problem_expert->getPredicate(request->expression);
     if (predicate) {
       response->node = predicate.value();
       response->success = true;
@@ -499,14 +785,47 @@ ProblemExpertNode::get_problem_predicates_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetStates::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetStates::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    response->success = true;
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+    response->unchanged = request->if_newer_than != 0 && request->epoch == context->epoch &&
+      request->if_newer_than == response->revision;
+    if (!response->unchanged) {
+      auto predicates = context->problem_expert->getPredicatesSnapshot();
+      response->states.assign(predicates->begin(), predicates->end());
+    }
+  }
+}
+
+void
+ProblemExpertNode::query_predicates_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::QueryPredicates::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::QueryPredicates::Response> response)
+{
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
+    std::size_t total;
+    auto matches = context->problem_expert->queryPredicates(
+      request->pattern, request->offset, request->max_results, &total);
+
     response->success = true;
-    response->states = plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Predicate>(
-      problem_expert_->getPredicates());
+    response->matches.assign(matches.begin(), matches.end());
+    response->total = total;
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
   }
 }
 
@@ -516,12 +835,14 @@ ProblemExpertNode::get_problem_function_details_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetNodeDetails::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetNodeDetails::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    auto function = problem_expert_->getFunction(request->expression);
+    auto function = context->problem_expert->getFunction(request->expression);
     if (function) {
       response->node = function.value();
       response->success = true;
@@ -538,14 +859,22 @@ ProblemExpertNode::get_problem_functions_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetStates::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetStates::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     response->success = true;
-    response->states = plansys2::convertVector<plansys2_msgs::msg::Node, plansys2::Function>(
-      problem_expert_->getFunctions());
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+    response->unchanged = request->if_newer_than != 0 && request->epoch == context->epoch &&
+      request->if_newer_than == response->revision;
+    if (!response->unchanged) {
+      auto functions = context->problem_expert->getFunctionsSnapshot();
+      response->states.assign(functions->begin(), functions->end());
+    }
   }
 }
 
@@ -555,13 +884,21 @@ ProblemExpertNode::get_problem_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::GetProblem::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::GetProblem::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     response->success = true;
-    response->problem = problem_expert_->getProblem();
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+    response->unchanged = request->if_newer_than != 0 && request->epoch == context->epoch &&
+      request->if_newer_than == response->revision;
+    if (!response->unchanged) {
+      response->problem = context->problem_expert->getProblem();
+    }
   }
 }
 
@@ -571,13 +908,20 @@ ProblemExpertNode::is_problem_goal_satisfied_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::IsProblemGoalSatisfied::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::IsProblemGoalSatisfied::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
     response->success = true;
-    response->satisfied = problem_expert_->isGoalSatisfied(request->tree);
+    // The current goal is already tracked, so it is not evaluated again
+    if (!request->tree.nodes.empty() && request->tree == context->problem_expert->getGoal()) {
+      response->satisfied = context->goal_tracker->isSatisfied();
+    } else {
+      response->satisfied = context->problem_expert->isGoalSatisfied(request->tree);
+    }
   }
 }
 
@@ -587,16 +931,19 @@ ProblemExpertNode::remove_problem_goal_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::RemoveProblemGoal::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::RemoveProblemGoal::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->clearGoal();
+    response->success = context->problem_expert->clearGoal();
 
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Error clearing goal";
     }
@@ -609,16 +956,19 @@ ProblemExpertNode::clear_problem_knowledge_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::ClearProblemKnowledge::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::ClearProblemKnowledge::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->clearKnowledge();
+    response->success = context->problem_expert->clearKnowledge();
 
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Error clearing knowledge";
     }
@@ -632,15 +982,18 @@ ProblemExpertNode::remove_problem_instance_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectParam::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectParam::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->removeInstance(request->param);
+    response->success = context->problem_expert->removeInstance(request->param);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Error removing instance";
     }
@@ -653,15 +1006,18 @@ ProblemExpertNode::remove_problem_predicate_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->removePredicate(request->node);
+    response->success = context->problem_expert->removePredicate(request->node);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
-      knowledge_pub_->publish(*get_knowledge_as_msg());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Error removing predicate";
     }
@@ -674,14 +1030,18 @@ ProblemExpertNode::remove_problem_function_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->removeFunction(request->node);
+    response->success = context->problem_expert->removeFunction(request->node);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Error removing function";
     }
@@ -694,11 +1054,15 @@ ProblemExpertNode::exist_problem_predicate_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::ExistNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::ExistNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  std::string error_info;
+  auto context = get_context(request->context, error_info);
+  if (context == nullptr) {
     response->exist = false;
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", error_info.c_str());
   } else {
-    response->exist = problem_expert_->existPredicate(request->node);
+    response->exist = context->problem_expert->existPredicate(request->node);
   }
 }
 
@@ -708,11 +1072,80 @@ ProblemExpertNode::exist_problem_function_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::ExistNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::ExistNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  std::string error_info;
+  auto context = get_context(request->context, error_info);
+  if (context == nullptr) {
     response->exist = false;
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", error_info.c_str());
   } else {
-    response->exist = problem_expert_->existFunction(request->node);
+    response->exist = context->problem_expert->existFunction(request->node);
+  }
+}
+
+void
+ProblemExpertNode::evaluate_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Response> response)
+{
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  std::string tree_error;
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else if (!plansys2::isValidTree(request->tree, request->node_id, &tree_error)) {
+    // The tree is checked before any of its nodes is read
+    response->success = false;
+    response->error_info = "Invalid expression: " + tree_error;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    // Every leaf is a lookup in the problem expert, with no request per leaf
+    std::vector<plansys2::Predicate> predicates;
+    std::vector<plansys2::Function> functions;
+    std::tie(response->success, response->truth_value, response->value) = plansys2::evaluate(
+      request->tree, context->problem_expert, predicates, functions, false, false,
+      request->node_id);
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+  }
+}
+
+void
+ProblemExpertNode::apply_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::EvaluateTree::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  std::string tree_error;
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else if (!plansys2::isValidTree(request->tree, request->node_id, &tree_error)) {
+    // The tree is checked before any of its nodes is read
+    response->success = false;
+    response->error_info = "Invalid expression: " + tree_error;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    // The effect is applied as a transaction, and all its changes are published as a
+    // single update. Nothing is published if it fails, or if it changes nothing
+    auto revision = context->problem_expert->getRevision();
+    std::tie(response->success, response->truth_value, response->value) =
+      context->problem_expert->applyEffect(request->tree, request->node_id);
+    if (context->problem_expert->getRevision() != revision) {
+      publish_knowledge_update(*context);
+    }
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+    if (!response->success) {
+      response->error_info = "Effect not valid";
+    }
   }
 }
 
@@ -722,38 +1155,456 @@ ProblemExpertNode::update_problem_function_service_callback(
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Request> request,
   const std::shared_ptr<plansys2_msgs::srv::AffectNode::Response> response)
 {
-  if (problem_expert_ == nullptr) {
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
     response->success = false;
-    response->error_info = "Requesting service in non-active state";
-    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
   } else {
-    response->success = problem_expert_->updateFunction(request->node);
+    response->success = context->problem_expert->updateFunction(request->node);
     if (response->success) {
-      update_pub_->publish(std_msgs::msg::Empty());
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
     } else {
       response->error_info = "Function not valid";
     }
   }
 }
 
+void
+ProblemExpertNode::update_knowledge_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::UpdateKnowledge::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::UpdateKnowledge::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    KnowledgeUpdate update;
+    update.add_instances = plansys2::convertVector<plansys2::Instance, plansys2_msgs::msg::Param>(
+      request->add_instances);
+    update.add_predicates = plansys2::convertVector<plansys2::Predicate, plansys2_msgs::msg::Node>(
+      request->add_predicates);
+    update.add_functions = plansys2::convertVector<plansys2::Function, plansys2_msgs::msg::Node>(
+      request->add_functions);
+    update.remove_instances =
+      plansys2::convertVector<plansys2::Instance, plansys2_msgs::msg::Param>(
+      request->remove_instances);
+    update.remove_predicates =
+      plansys2::convertVector<plansys2::Predicate, plansys2_msgs::msg::Node>(
+      request->remove_predicates);
+    update.remove_functions =
+      plansys2::convertVector<plansys2::Function, plansys2_msgs::msg::Node>(
+      request->remove_functions);
+
+    response->success = context->problem_expert->updateKnowledge(update);
+    if (response->success) {
+      publish_knowledge_update(*context);
+      response->revision = context->problem_expert->getRevision();
+      response->epoch = context->epoch;
+    } else {
+      response->error_info = "Knowledge update not valid";
+    }
+  }
+}
+
+void
+ProblemExpertNode::get_knowledge_snapshot_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::GetKnowledgeSnapshot::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::GetKnowledgeSnapshot::Response> response)
+{
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    response->success = true;
+    response->snapshot = context->problem_expert->getSnapshot();
+    response->snapshot.epoch = context->epoch;
+  }
+}
+
+void
+ProblemExpertNode::add_watch_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::AddWatch::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::AddWatch::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    response->success = true;
+    response->id = context->watcher->addWatch(request->condition, request->owner);
+    response->value = context->watcher->getValue(response->id).value();
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+  }
+}
+
+void
+ProblemExpertNode::remove_watch_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::RemoveWatch::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::RemoveWatch::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    response->success = context->watcher->removeWatch(request->id);
+    if (!response->success) {
+      response->error_info = "No watch with this id";
+    }
+  }
+}
+
+void
+ProblemExpertNode::get_applicable_actions_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::GetApplicableActions::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::GetApplicableActions::Response> response)
+{
+  // Exclusive, as the first request of a context creates its tracker
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else {
+    if (context->action_tracker == nullptr) {
+      context->action_tracker = std::make_shared<ApplicableActionTracker>(
+        domain_expert_, context->problem_expert);
+    }
+    response->success = true;
+    response->actions = context->action_tracker->getApplicableActions();
+    response->revision = context->problem_expert->getRevision();
+    response->epoch = context->epoch;
+  }
+}
+
+void
+ProblemExpertNode::add_problem_context_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::AffectContext::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::AffectContext::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  if (contexts_.empty()) {
+    response->success = false;
+    response->error_info = "Requesting service in non-active state";
+    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+  } else if (contexts_.find(request->context) != contexts_.end()) {
+    response->success = false;
+    response->error_info = "Problem context " + request->context + " already exists";
+  } else {
+    auto context = create_context(
+      request->context, std::make_shared<ProblemExpert>(domain_expert_));
+    contexts_[request->context] = context;
+    publish_goal_status(*context);
+    response->success = true;
+  }
+}
+
+void
+ProblemExpertNode::remove_problem_context_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::AffectContext::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::AffectContext::Response> response)
+{
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+
+  auto context = get_context(request->context, response->error_info);
+  if (context == nullptr) {
+    response->success = false;
+    RCLCPP_WARN(get_logger(), "%s", response->error_info.c_str());
+  } else if (request->context.empty()) {
+    response->success = false;
+    response->error_info = "The default problem context cannot be removed";
+  } else {
+    contexts_.erase(request->context);
+    response->success = true;
+  }
+}
+
+void
+ProblemExpertNode::get_problem_contexts_service_callback(
+  const std::shared_ptr<rmw_request_id_t> request_header,
+  const std::shared_ptr<plansys2_msgs::srv::GetProblemContexts::Request> request,
+  const std::shared_ptr<plansys2_msgs::srv::GetProblemContexts::Response> response)
+{
+  std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+
+  if (contexts_.empty()) {
+    response->success = false;
+    response->error_info = "Requesting service in non-active state";
+    RCLCPP_WARN(get_logger(), "Requesting service in non-active state");
+  } else {
+    response->success = true;
+    response->contexts.reserve(contexts_.size());
+    for (const auto & context : contexts_) {
+      response->contexts.push_back(context.first);
+    }
+  }
+}
+
+std::shared_ptr<ProblemExpertNode::ProblemContext>
+ProblemExpertNode::create_context(
+  const std::string & id, std::shared_ptr<ProblemExpert> problem_expert)
+{
+  auto context = std::make_shared<ProblemContext>();
+  context->id = id;
+  // Its revisions start from scratch, so the clients must not compare them with the ones
+  // of a previous context with this id, of a previous configuration, or of a previous run
+  context->epoch = new_epoch();
+  context->problem_expert = problem_expert;
+  context->problem_expert->setDeltaTracking(true);
+  context->watcher = std::make_shared<ConditionWatcher>(problem_expert);
+  context->goal_tracker = std::make_shared<GoalTracker>(problem_expert);
+  context->goal_tracker->setGoal(problem_expert->getGoal());
+  return context;
+}
+
+std::shared_ptr<ProblemExpertNode::ProblemContext>
+ProblemExpertNode::get_context(const std::string & id, std::string & error_info)
+{
+  if (contexts_.empty()) {
+    error_info = "Requesting service in non-active state";
+    return nullptr;
+  }
+
+  auto it = contexts_.find(id);
+  if (it == contexts_.end()) {
+    error_info = "Unknown problem context " + id;
+    return nullptr;
+  }
+  return it->second;
+}
+
+void
+ProblemExpertNode::publish_knowledge_update(ProblemContext & context)
+{
+  update_pub_->publish(std_msgs::msg::Empty());
+
+  auto delta = context.problem_expert->takeDelta();
+  delta.epoch = context.epoch;
+  delta.context = context.id;
+  if (delta.revision != delta.base_revision) {
+    // Only the default context is persistent
+    if (storage_ != nullptr && context.id.empty() && !storage_->append(delta)) {
+      RCLCPP_ERROR(get_logger(), "[%s] Error writing to the knowledge log", get_name());
+    }
+    knowledge_delta_pub_->publish(delta);
+
+    for (const auto & change : context.watcher->update(delta)) {
+      plansys2_msgs::msg::WatchEvent event;
+      event.id = change.first;
+      event.value = change.second;
+      event.revision = delta.revision;
+      event.epoch = context.epoch;
+      event.context = context.id;
+      watch_pub_->publish(event);
+    }
+
+    if (context.goal_tracker->update(delta)) {
+      publish_goal_status(context);
+    }
+
+    if (context.action_tracker != nullptr) {
+      context.action_tracker->update(delta);
+    }
+  }
+
+  if (publish_knowledge_) {
+    knowledge_pub_->publish(*get_knowledge_as_msg(context.id));
+  }
+}
+
+void
+ProblemExpertNode::publish_goal_status(ProblemContext & context)
+{
+  auto status = context.goal_tracker->getStatus();
+  status.revision = context.problem_expert->getRevision();
+  status.epoch = context.epoch;
+  status.context = context.id;
+  goal_status_pub_->publish(status);
+}
+
+void
+ProblemExpertNode::function_updates_callback(
+  const plansys2_msgs::msg::FunctionUpdates::SharedPtr msg)
+{
+  // Messages received while deactivating are dropped
+  if (!accepting_function_updates_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pending_functions_mutex_);
+    for (const auto & function : msg->functions) {
+      // A function that was never interned cannot be in the problem
+      auto fact = findGroundedFact(function);
+      if (fact.has_value()) {
+        pending_functions_[msg->context][fact.value()] = function.value;
+      }
+    }
+  }
+
+  if (!batch_function_updates_) {
+    apply_function_updates();
+  }
+}
+
+void
+ProblemExpertNode::apply_function_updates()
+{
+  std::map<std::string, std::unordered_map<GroundedFact, double, GroundedFactHash>> pending;
+  {
+    std::lock_guard<std::mutex> lock(pending_functions_mutex_);
+    pending.swap(pending_functions_);
+  }
+
+  if (pending.empty()) {
+    return;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+  for (const auto & context_functions : pending) {
+    // Values for a context that does not exist are dropped
+    auto context = contexts_.find(context_functions.first);
+    if (context == contexts_.end()) {
+      continue;
+    }
+
+    std::vector<GroundedFact> functions;
+    functions.reserve(context_functions.second.size());
+    for (const auto & function : context_functions.second) {
+      functions.push_back(function.first);
+      functions.back().setValue(function.second);
+    }
+
+    if (context->second->problem_expert->setFunctionValues(functions) > 0) {
+      publish_knowledge_update(*context->second);
+    }
+  }
+}
+
+void
+ProblemExpertNode::expire_watches()
+{
+  auto node_names = get_node_names();
+  std::unordered_set<std::string> live_owners(node_names.begin(), node_names.end());
+
+  std::unique_lock<std::shared_mutex> lock(problem_mutex_);
+  for (const auto & context : contexts_) {
+    auto expired = context.second->watcher->expireWatches(live_owners);
+    if (!expired.empty()) {
+      RCLCPP_INFO(
+        get_logger(), "[%s] Removed %zu watches of nodes that are gone from context [%s]",
+        get_name(), expired.size(), context.first.c_str());
+    }
+  }
+}
+
+bool
+ProblemExpertNode::configure_storage()
+{
+  storage_sync_timer_ = nullptr;
+  storage_snapshot_timer_ = nullptr;
+  storage_ = nullptr;
+
+  auto persistence_dir = get_parameter("persistence_dir").get_value<std::string>();
+  if (persistence_dir.empty()) {
+    return true;
+  }
+
+  auto durability = KnowledgeStorage::getDurability(
+    get_parameter("persistence_durability").get_value<std::string>());
+  if (!durability) {
+    RCLCPP_ERROR(
+      get_logger(), "[%s] persistence_durability must be none, batch or always", get_name());
+    return false;
+  }
+
+  std::chrono::duration<double> sync_period(
+    get_parameter("persistence_sync_period").get_value<double>());
+  storage_ = std::make_shared<KnowledgeStorage>(
+    persistence_dir, durability.value(),
+    std::chrono::duration_cast<std::chrono::nanoseconds>(sync_period));
+
+  // Flushes the deltas appended since the last write, so none waits more than sync_period
+  if (durability.value() == KnowledgeStorage::Durability::BATCH && sync_period.count() > 0.0) {
+    storage_sync_timer_ = create_wall_timer(
+      sync_period, [this]() {storage_->sync();}, write_callback_group_);
+  }
+
+  // Compacts the log, so that loading does not replay a long history
+  auto snapshot_period = get_parameter("persistence_snapshot_period").get_value<double>();
+  if (snapshot_period > 0.0) {
+    storage_snapshot_timer_ = create_wall_timer(
+      std::chrono::duration<double>(snapshot_period),
+      [this]() {
+        std::shared_lock<std::shared_mutex> lock(problem_mutex_);
+        auto context = contexts_.find("");
+        if (context != contexts_.end() && storage_->getLogSize() > 0 &&
+        !storage_->writeSnapshot(context->second->problem_expert->getSnapshot()))
+        {
+          RCLCPP_ERROR(get_logger(), "[%s] Error writing the knowledge snapshot", get_name());
+        }
+      }, read_callback_group_);
+  }
+
+  return true;
+}
+
 plansys2_msgs::msg::Knowledge::SharedPtr
-ProblemExpertNode::get_knowledge_as_msg() const
+ProblemExpertNode::get_knowledge_as_msg(const std::string & context) const
 {
+  auto it = contexts_.find(context);
+  if (it == contexts_.end()) {
+    return nullptr;
+  }
+  const auto & problem_expert = it->second->problem_expert;
+
   auto ret_msgs = std::make_shared<plansys2_msgs::msg::Knowledge>();
+  ret_msgs->context = context;
 
-  for (const auto & instance : problem_expert_->getInstances()) {
+  auto instances = problem_expert->getInstancesSnapshot();
+  ret_msgs->instances.reserve(instances->size());
+  for (const auto & instance : *instances) {
     ret_msgs->instances.push_back(instance.name);
   }
 
-  for (const auto & predicate : problem_expert_->getPredicates()) {
+  auto predicates = problem_expert->getPredicatesSnapshot();
+  ret_msgs->predicates.reserve(predicates->size());
+  for (const auto & predicate : *predicates) {
     ret_msgs->predicates.push_back(parser::pddl::toString(predicate));
   }
 
-  for (const auto & function : problem_expert_->getFunctions()) {
+  auto functions = problem_expert->getFunctionsSnapshot();
+  ret_msgs->functions.reserve(functions->size());
+  for (const auto & function : *functions) {
     ret_msgs->functions.push_back(parser::pddl::toString(function));
   }
 
-  auto goal = problem_expert_->getGoal();
+  auto goal = problem_expert->getGoal();
   ret_msgs->goal = parser::pddl::toString(goal);
 
   return ret_msgs;
@@ -0,0 +1,324 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/ProblemStateFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "plansys2_core/GroundedFact.hpp"
+#include "plansys2_core/SymbolTable.hpp"
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+namespace plansys2
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'P', 'S', '2', 'S', 'T', 'A', 'T', 'E'};
+const uint32_t FORMAT_VERSION = 1;
+
+// The header is followed by these sections, in this order:
+//   uint64_t symbol_offsets[n_symbols + 1]  (symbol i is strings[offsets[i], offsets[i + 1]))
+//   double function_values[n_functions]
+//   InstanceRecord instances[n_instances]
+//   FactRecord facts[n_predicates + n_functions]  (predicates first)
+//   uint32_t args[n_args]
+//   char strings[strings_size]
+//   char goal[goal_size]
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t n_symbols;
+  uint32_t n_instances;
+  uint32_t n_predicates;
+  uint32_t n_functions;
+  uint32_t n_args;
+  uint64_t strings_size;
+  uint64_t goal_size;
+};
+
+struct InstanceRecord
+{
+  uint32_t name;
+  uint32_t type;
+};
+
+struct FactRecord
+{
+  uint32_t name;
+  uint32_t first_arg;
+  uint32_t arity;
+};
+
+// Read-only view of a whole file, unmapped when destroyed
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string & path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      void * data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char *>(data);
+        size_ = st.st_size;
+      }
+    }
+    ::close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  const char * data() const {return data_;}
+  std::size_t size() const {return size_;}
+
+private:
+  const char * data_ {nullptr};
+  std::size_t size_ {0};
+};
+
+template<class T>
+void append(std::string & data, const T & value)
+{
+  data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+}  // namespace
+
+bool
+ProblemStateFile::write(const std::string & path, ProblemExpert & problem_expert)
+{
+  std::vector<std::string> symbols;
+  std::unordered_map<std::string, uint32_t> symbol_ids;
+  auto get_symbol = [&](const std::string & name) {
+      auto it = symbol_ids.find(name);
+      if (it == symbol_ids.end()) {
+        it = symbol_ids.emplace(name, static_cast<uint32_t>(symbols.size())).first;
+        symbols.push_back(name);
+      }
+      return it->second;
+    };
+
+  auto instances = problem_expert.getInstancesSnapshot();
+  auto predicates = problem_expert.getPredicatesSnapshot();
+  auto functions = problem_expert.getFunctionsSnapshot();
+
+  std::vector<InstanceRecord> instance_records;
+  instance_records.reserve(instances->size());
+  for (const auto & instance : *instances) {
+    instance_records.push_back({get_symbol(instance.name), get_symbol(instance.type)});
+  }
+
+  std::vector<FactRecord> fact_records;
+  std::vector<uint32_t> args;
+  std::vector<double> values;
+  auto add_fact = [&](const plansys2_msgs::msg::Node & node) {
+      FactRecord record {get_symbol(node.name), static_cast<uint32_t>(args.size()),
+        static_cast<uint32_t>(node.parameters.size())};
+      for (const auto & param : node.parameters) {
+        args.push_back(get_symbol(param.name));
+      }
+      fact_records.push_back(record);
+    };
+  for (const auto & predicate : *predicates) {
+    add_fact(predicate);
+  }
+  for (const auto & function : *functions) {
+    add_fact(function);
+    values.push_back(function.value);
+  }
+
+  auto goal = problem_expert.getGoal();
+  std::string goal_str = goal.nodes.empty() ? "" : parser::pddl::toString(goal);
+
+  std::string strings;
+  std::vector<uint64_t> offsets {0};
+  for (const auto & symbol : symbols) {
+    strings += symbol;
+    offsets.push_back(strings.size());
+  }
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = FORMAT_VERSION;
+  header.n_symbols = symbols.size();
+  header.n_instances = instance_records.size();
+  header.n_predicates = predicates->size();
+  header.n_functions = functions->size();
+  header.n_args = args.size();
+  header.strings_size = strings.size();
+  header.goal_size = goal_str.size();
+
+  std::string data;
+  append(data, header);
+  data.append(
+    reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+  data.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double));
+  data.append(
+    reinterpret_cast<const char *>(instance_records.data()),
+    instance_records.size() * sizeof(InstanceRecord));
+  data.append(
+    reinterpret_cast<const char *>(fact_records.data()),
+    fact_records.size() * sizeof(FactRecord));
+  data.append(reinterpret_cast<const char *>(args.data()), args.size() * sizeof(uint32_t));
+  data += strings;
+  data += goal_str;
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(data.data(), data.size());
+  ofs.close();
+  return !ofs.fail();
+}
+
+bool
+ProblemStateFile::load(const std::string & path, ProblemExpert & problem_expert)
+{
+  MappedFile file(path);
+  if (file.data() == nullptr || file.size() < sizeof(Header)) {
+    return false;
+  }
+
+  Header header;
+  std::memcpy(&header, file.data(), sizeof(Header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+    header.version != FORMAT_VERSION)
+  {
+    return false;
+  }
+
+  // The counts are 32 bits, so none of these can overflow
+  uint64_t n_facts = uint64_t(header.n_predicates) + header.n_functions;
+  uint64_t offsets_pos = sizeof(Header);
+  uint64_t values_pos = offsets_pos + (uint64_t(header.n_symbols) + 1) * sizeof(uint64_t);
+  uint64_t instances_pos = values_pos + uint64_t(header.n_functions) * sizeof(double);
+  uint64_t facts_pos = instances_pos + uint64_t(header.n_instances) * sizeof(InstanceRecord);
+  uint64_t args_pos = facts_pos + n_facts * sizeof(FactRecord);
+  uint64_t strings_pos = args_pos + uint64_t(header.n_args) * sizeof(uint32_t);
+  if (strings_pos > file.size() ||
+    header.strings_size > file.size() - strings_pos ||
+    header.goal_size != file.size() - strings_pos - header.strings_size)
+  {
+    return false;
+  }
+
+  // Sections are 4 or 8 bytes aligned in the file, and mmap returns a page aligned address
+  auto offsets = reinterpret_cast<const uint64_t *>(file.data() + offsets_pos);
+  auto values = reinterpret_cast<const double *>(file.data() + values_pos);
+  auto instance_records = reinterpret_cast<const InstanceRecord *>(file.data() + instances_pos);
+  auto fact_records = reinterpret_cast<const FactRecord *>(file.data() + facts_pos);
+  auto args = reinterpret_cast<const uint32_t *>(file.data() + args_pos);
+  const char * strings = file.data() + strings_pos;
+
+  if (offsets[0] != 0 || offsets[header.n_symbols] != header.strings_size) {
+    return false;
+  }
+  for (uint32_t i = 0; i < header.n_symbols; i++) {
+    if (offsets[i] > offsets[i + 1]) {
+      return false;
+    }
+  }
+
+  auto get_name = [&](uint32_t symbol) {
+      return std::string(strings + offsets[symbol], offsets[symbol + 1] - offsets[symbol]);
+    };
+
+  // Each symbol of the file is interned once, when it is first used
+  auto & symbol_table = SymbolTable::getInstance();
+  std::vector<SymbolTable::Id> symbols(header.n_symbols, SymbolTable::npos);
+  auto intern = [&](uint32_t symbol) {
+      if (symbols[symbol] == SymbolTable::npos) {
+        symbols[symbol] = symbol_table.intern(get_name(symbol));
+      }
+      return symbols[symbol];
+    };
+
+  std::vector<plansys2::Instance> instances(header.n_instances);
+  for (uint32_t i = 0; i < header.n_instances; i++) {
+    const auto & record = instance_records[i];
+    if (record.name >= header.n_symbols || record.type >= header.n_symbols) {
+      return false;
+    }
+    instances[i].name = get_name(record.name);
+    instances[i].type = get_name(record.type);
+  }
+
+  std::vector<GroundedFact> predicates;
+  std::vector<GroundedFact> functions;
+  predicates.reserve(header.n_predicates);
+  functions.reserve(header.n_functions);
+
+  std::vector<SymbolTable::Id> fact_args;
+  for (uint64_t i = 0; i < n_facts; i++) {
+    const auto & record = fact_records[i];
+    if (record.name >= header.n_symbols ||
+      uint64_t(record.first_arg) + record.arity > header.n_args)
+    {
+      return false;
+    }
+
+    fact_args.clear();
+    for (uint32_t j = 0; j < record.arity; j++) {
+      uint32_t arg = args[record.first_arg + j];
+      if (arg >= header.n_symbols) {
+        return false;
+      }
+      fact_args.push_back(intern(arg));
+    }
+
+    if (i < header.n_predicates) {
+      predicates.emplace_back(
+        plansys2_msgs::msg::Node::PREDICATE, intern(record.name), fact_args);
+    } else {
+      functions.emplace_back(
+        plansys2_msgs::msg::Node::FUNCTION, intern(record.name), fact_args,
+        values[i - header.n_predicates]);
+    }
+  }
+
+  if (!problem_expert.addFacts(instances, predicates, functions)) {
+    return false;
+  }
+
+  if (header.goal_size > 0) {
+    std::string goal(strings + header.strings_size, header.goal_size);
+    return problem_expert.setGoal(plansys2::Goal(goal));
+  }
+  return true;
+}
+
+}  // namespace plansys2
@@ -0,0 +1,219 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plansys2_problem_expert/State.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace plansys2
+{
+
+State::State(
+  const std::vector<plansys2::Predicate> & predicates,
+  const std::vector<plansys2::Function> & functions)
+{
+  predicates_.reserve(predicates.size());
+  for (const auto & predicate : predicates) {
+    predicates_.insert(toGroundedFact(predicate));
+  }
+  functions_.reserve(functions.size());
+  for (const auto & function : functions) {
+    functions_[toGroundedFact(function)] = function.value;
+  }
+}
+
+bool
+State::existPredicate(const GroundedFact & predicate) const
+{
+  return predicates_.contains(predicate);
+}
+
+bool
+State::existPredicate(const plansys2_msgs::msg::Node & predicate) const
+{
+  // A predicate with symbols never interned cannot be in any state
+  auto fact = findGroundedFact(predicate);
+  return fact.has_value() && existPredicate(fact.value());
+}
+
+void
+State::addPredicate(const GroundedFact & predicate)
+{
+  predicates_.insert(predicate);
+}
+
+void
+State::addPredicate(const plansys2_msgs::msg::Node & predicate)
+{
+  predicates_.insert(toGroundedFact(predicate));
+}
+
+void
+State::removePredicate(const GroundedFact & predicate)
+{
+  predicates_.erase(predicate);
+}
+
+void
+State::removePredicate(const plansys2_msgs::msg::Node & predicate)
+{
+  auto fact = findGroundedFact(predicate);
+  if (fact.has_value()) {
+    removePredicate(fact.value());
+  }
+}
+
+std::optional<double>
+State::getFunctionValue(const GroundedFact & function) const
+{
+  auto it = functions_.find(function);
+  if (it == functions_.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+std::optional<double>
+State::getFunctionValue(const plansys2_msgs::msg::Node & function) const
+{
+  auto fact = findGroundedFact(function);
+  if (!fact.has_value()) {
+    return {};
+  }
+  return getFunctionValue(fact.value());
+}
+
+void
+State::setFunctionValue(const GroundedFact & function, double value)
+{
+  functions_[function] = value;
+}
+
+void
+State::setFunctionValue(const plansys2_msgs::msg::Node & function, double value)
+{
+  setFunctionValue(toGroundedFact(function), value);
+}
+
+std::vector<plansys2::Predicate>
+State::getPredicates() const
+{
+  std::vector<plansys2::Predicate> ret;
+  ret.reserve(predicates_.size());
+  for (const auto & predicate : predicates_) {
+    ret.push_back(toNode(predicate));
+  }
+  return ret;
+}
+
+std::vector<plansys2::Function>
+State::getFunctions() const
+{
+  std::vector<plansys2::Function> ret;
+  ret.reserve(functions_.size());
+  for (const auto & function : functions_) {
+    ret.push_back(toNode(function.first));
+    ret.back().value = function.second;
+  }
+  return ret;
+}
+
+bool
+isValidTree(const plansys2_msgs::msg::Tree & tree, uint32_t node_id, std::string * error)
+{
+  auto fail = [error](const std::string & reason) {
+      if (error) {
+        *error = reason;
+      }
+      return false;
+    };
+
+  if (tree.nodes.empty()) {  // No expression
+    return true;
+  }
+
+  // Each node is checked when it is first reached, so a node shared by two parents is only
+  // checked once, and a node reached again while its children are visited is in a cycle
+  enum Mark : uint8_t {NOT_REACHED, IN_PATH, DONE};
+  std::vector<Mark> marks(tree.nodes.size(), NOT_REACHED);
+  auto check_node = [&](uint32_t id, uint32_t parent_id) {
+      if (id >= tree.nodes.size()) {
+        return fail(
+          "node " + std::to_string(parent_id) + " has child " + std::to_string(id) +
+          ", out of the " + std::to_string(tree.nodes.size()) + " nodes of the tree");
+      }
+
+      std::size_t expected_children = 0;
+      switch (tree.nodes[id].node_type) {
+        case plansys2_msgs::msg::Node::NOT:
+          expected_children = 1;
+          break;
+        case plansys2_msgs::msg::Node::EXPRESSION:
+        case plansys2_msgs::msg::Node::FUNCTION_MODIFIER:
+          expected_children = 2;
+          break;
+        default:  // AND and OR have any number of children, and the rest are not evaluated
+          return true;
+      }
+      if (tree.nodes[id].children.size() != expected_children) {
+        return fail(
+          "node " + std::to_string(id) + " has " +
+          std::to_string(tree.nodes[id].children.size()) + " children instead of " +
+          std::to_string(expected_children));
+      }
+      return true;
+    };
+
+  if (node_id >= tree.nodes.size()) {
+    return fail(
+      "root node " + std::to_string(node_id) + " is out of the " +
+      std::to_string(tree.nodes.size()) + " nodes of the tree");
+  }
+  if (!check_node(node_id, node_id)) {
+    return false;
+  }
+
+  // Depth-first, with an explicit stack of (node, next child), so a deep tree cannot
+  // overflow the call stack here
+  std::vector<std::pair<uint32_t, std::size_t>> path {{node_id, 0}};
+  marks[node_id] = IN_PATH;
+  while (!path.empty()) {
+    uint32_t id = path.back().first;
+    std::size_t next = path.back().second++;
+    const auto & children = tree.nodes[id].children;
+    if (next == children.size()) {
+      marks[id] = DONE;
+      path.pop_back();
+      continue;
+    }
+
+    uint32_t child = children[next];
+    if (child >= tree.nodes.size() || marks[child] == NOT_REACHED) {
+      if (!check_node(child, id)) {
+        return false;
+      }
+      marks[child] = IN_PATH;
+      path.emplace_back(child, 0);
+    } else if (marks[child] == IN_PATH) {
+      return fail("node " + std::to_string(child) + " is its own descendant");
+    }
+  }
+  return true;
+}
+
+}  // namespace plansys2
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <functional>
+#include <optional>
 #include <tuple>
 #include <memory>
 #include <string>
@@ -26,56 +29,96 @@
 namespace plansys2
 {
 
-std::tuple<bool, bool, double> evaluate(
+namespace
+{
+
+template<class T>
+typename std::vector<T>::iterator
+find(std::vector<T> & facts, const plansys2_msgs::msg::Node & node)
+{
+  return std::find_if(
+    facts.begin(), facts.end(),
+    std::bind(&parser::pddl::checkNodeEquality, std::placeholders::_1, node));
+}
+
+// Adapts the vectors of the evaluate overloads to evaluateInState. Facts are found by
+// scanning the vectors, which are changed in place, so their order is kept
+class VectorState
+{
+public:
+  VectorState(
+    std::vector<plansys2::Predicate> & predicates, std::vector<plansys2::Function> & functions)
+  : predicates_(predicates), functions_(functions) {}
+
+  bool existPredicate(const plansys2_msgs::msg::Node & predicate) const
+  {
+    return find(predicates_, predicate) != predicates_.end();
+  }
+
+  void addPredicate(const plansys2_msgs::msg::Node & predicate)
+  {
+    if (find(predicates_, predicate) == predicates_.end()) {
+      predicates_.push_back(predicate);
+    }
+  }
+
+  void removePredicate(const plansys2_msgs::msg::Node & predicate)
+  {
+    auto it = find(predicates_, predicate);
+    if (it != predicates_.end()) {
+      predicates_.erase(it);
+    }
+  }
+
+  std::optional<double> getFunctionValue(const plansys2_msgs::msg::Node & function) const
+  {
+    auto it = find(functions_, function);
+    if (it == functions_.end()) {
+      return {};
+    }
+    return it->value;
+  }
+
+  void setFunctionValue(const plansys2_msgs::msg::Node & function, double value)
+  {
+    auto it = find(functions_, function);
+    if (it != functions_.end()) {
+      it->value = value;
+    } else {
+      functions_.push_back(function);
+      functions_.back().value = value;
+    }
+  }
+
+private:
+  std::vector<plansys2::Predicate> & predicates_;
+  std::vector<plansys2::Function> & functions_;
+};
+
+// Evaluate an expression on a problem expert, or a client of it
+std::tuple<bool, bool, double> evaluateInterface(
   const plansys2_msgs::msg::Tree & tree,
-  std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
-  std::vector<plansys2::Predicate> & predicates,
-  std::vector<plansys2::Function> & functions,
+  std::shared_ptr<plansys2::ProblemExpertInterface> & problem_client,
   bool apply,
-  bool use_state,
-  uint8_t node_id,
-  bool negate)
+  uint32_t node_id,
+  bool negate,
+  EvaluationStats * stats)
 {
   if (tree.nodes.empty()) {  // No expression
     return std::make_tuple(true, true, 0);
   }
 
   switch (tree.nodes[node_id].node_type) {
-    case plansys2_msgs::msg::Node::AND: {
-        bool success = true;
-        bool truth_value = true;
-
-        for (auto & child_id : tree.nodes[node_id].children) {
-          std::tuple<bool, bool, double> result =
-            evaluate(
-            tree, problem_client, predicates, functions, apply, use_state, child_id,
-            negate);
-          success = success && std::get<0>(result);
-          truth_value = truth_value && std::get<1>(result);
-        }
-        return std::make_tuple(success, truth_value, 0);
-      }
-
-    case plansys2_msgs::msg::Node::OR: {
-        bool success = true;
-        bool truth_value = false;
-
-        for (auto & child_id : tree.nodes[node_id].children) {
-          std::tuple<bool, bool, double> result =
-            evaluate(
-            tree, problem_client, predicates, functions, apply, use_state, child_id,
-            negate);
-          success = success && std::get<0>(result);
-          truth_value = truth_value || std::get<1>(result);
-        }
-        return std::make_tuple(success, truth_value, 0);
-      }
+    case plansys2_msgs::msg::Node::AND:
+    case plansys2_msgs::msg::Node::OR:
+      return evaluateAndOr(
+        tree, node_id, apply, negate, stats, [&](uint32_t child_id) {
+          return evaluateInterface(tree, problem_client, apply, child_id, negate, stats);
+        });
 
     case plansys2_msgs::msg::Node::NOT: {
-        return evaluate(
-          tree, problem_client, predicates, functions, apply, use_state,
-          tree.nodes[node_id].children[0],
-          !negate);
+        return evaluateInterface(
+          tree, problem_client, apply, tree.nodes[node_id].children[0], !negate, stats);
       }
 
     case plansys2_msgs::msg::Node::PREDICATE: {
@@ -83,30 +126,11 @@ std::tuple<bool, bool, double> evaluate(
         bool value = true;
 
         if (apply) {
-          if (use_state) {
-            auto it =
-              std::find_if(
-              predicates.begin(), predicates.end(),
-              std::bind(
-                &parser::pddl::checkNodeEquality, std::placeholders::_1,
-                tree.nodes[node_id]));
-            if (negate) {
-              if (it != predicates.end()) {
-                predicates.erase(it);
-              }
-              value = false;
-            } else {
-              if (it == predicates.end()) {
-                predicates.push_back(tree.nodes[node_id]);
-              }
-            }
+          if (negate) {
+            success = success && problem_client->removePredicate(tree.nodes[node_id]);
+            value = false;
           } else {
-            if (negate) {
-              success = success && problem_client->removePredicate(tree.nodes[node_id]);
-              value = false;
-            } else {
-              success = success && problem_client->addPredicate(tree.nodes[node_id]);
-            }
+            success = success && problem_client->addPredicate(tree.nodes[node_id]);
           }
         } else {
           // negate | exist | output
@@ -114,16 +138,7 @@ std::tuple<bool, bool, double> evaluate(
           //   F    |   T   |   T
           //   T    |   F   |   T
           //   T    |   T   |   F
-          if (use_state) {
-            value = negate ^
-              (std::find_if(
-                predicates.begin(), predicates.end(),
-                std::bind(
-                  &parser::pddl::checkNodeEquality, std::placeholders::_1,
-                  tree.nodes[node_id])) != predicates.end());
-          } else {
-            value = negate ^ problem_client->existPredicate(tree.nodes[node_id]);
-          }
+          value = negate ^ problem_client->existPredicate(tree.nodes[node_id]);
         }
 
         return std::make_tuple(success, value, 0);
@@ -133,39 +148,23 @@ std::tuple<bool, bool, double> evaluate(
         bool success = true;
         double value = 0;
 
-        if (use_state) {
-          auto it =
-            std::find_if(
-            functions.begin(), functions.end(),
-            std::bind(
-              &parser::pddl::checkNodeEquality, std::placeholders::_1,
-              tree.nodes[node_id]));
-          if (it != functions.end()) {
-            value = it->value;
-          } else {
-            success = false;
-          }
-        } else {
-          std::optional<plansys2_msgs::msg::Node> func =
-            problem_client->getFunction(parser::pddl::toString(tree, node_id));
+        std::optional<plansys2_msgs::msg::Node> func =
+          problem_client->getFunction(parser::pddl::toString(tree, node_id));
 
-          if (func.has_value()) {
-            value = func.value().value;
-          } else {
-            success = false;
-          }
+        if (func.has_value()) {
+          value = func.value().value;
+        } else {
+          success = false;
         }
 
         return std::make_tuple(success, false, value);
       }
 
     case plansys2_msgs::msg::Node::EXPRESSION: {
-        std::tuple<bool, bool, double> left = evaluate(
-          tree, problem_client, predicates,
-          functions, apply, use_state, tree.nodes[node_id].children[0], negate);
-        std::tuple<bool, bool, double> right = evaluate(
-          tree, problem_client, predicates,
-          functions, apply, use_state, tree.nodes[node_id].children[1], negate);
+        std::tuple<bool, bool, double> left = evaluateInterface(
+          tree, problem_client, apply, tree.nodes[node_id].children[0], negate, stats);
+        std::tuple<bool, bool, double> right = evaluateInterface(
+          tree, problem_client, apply, tree.nodes[node_id].children[1], negate, stats);
 
         if (!std::get<0>(left) || !std::get<0>(right)) {
           return std::make_tuple(false, false, 0);
@@ -225,13 +224,10 @@ std::tuple<bool, bool, double> evaluate(
       }
 
     case plansys2_msgs::msg::Node::FUNCTION_MODIFIER: {
-        std::tuple<bool, bool, double> left = evaluate(
-          tree, problem_client, predicates,
-          functions, apply, use_state, tree.nodes[node_id].children[0], negate);
-        std::tuple<bool, bool, double> right = evaluate(
-          tree, problem_client,
-          predicates, functions, apply, use_state, tree.nodes[node_id].children[1],
-          negate);
+        std::tuple<bool, bool, double> left = evaluateInterface(
+          tree, problem_client, apply, tree.nodes[node_id].children[0], negate, stats);
+        std::tuple<bool, bool, double> right = evaluateInterface(
+          tree, problem_client, apply, tree.nodes[node_id].children[1], negate, stats);
 
         if (!std::get<0>(left) || !std::get<0>(right)) {
           return std::make_tuple(false, false, 0);
@@ -267,24 +263,10 @@ std::tuple<bool, bool, double> evaluate(
         }
 
         if (success && apply) {
-          uint8_t left_id = tree.nodes[node_id].children[0];
-          if (use_state) {
-            auto it =
-              std::find_if(
-              functions.begin(), functions.end(),
-              std::bind(
-                &parser::pddl::checkNodeEquality, std::placeholders::_1,
-                tree.nodes[left_id]));
-            if (it != functions.end()) {
-              it->value = value;
-            } else {
-              success = false;
-            }
-          } else {
-            std::stringstream ss;
-            ss << "(= " << parser::pddl::toString(tree, left_id) << " " << value << ")";
-            problem_client->updateFunction(parser::pddl::fromStringFunction(ss.str()));
-          }
+          uint32_t left_id = tree.nodes[node_id].children[0];
+          std::stringstream ss;
+          ss << "(= " << parser::pddl::toString(tree, left_id) << " " << value << ")";
+          problem_client->updateFunction(parser::pddl::fromStringFunction(ss.str()));
         }
 
         return std::make_tuple(success, false, value);
@@ -302,15 +284,42 @@ std::tuple<bool, bool, double> evaluate(
   return std::make_tuple(false, false, 0);
 }
 
+}  // namespace
+
+std::tuple<bool, bool, double> evaluate(
+  const plansys2_msgs::msg::Tree & tree,
+  std::shared_ptr<plansys2::ProblemExpertInterface> problem_client,
+  std::vector<plansys2::Predicate> & predicates,
+  std::vector<plansys2::Function> & functions,
+  bool apply,
+  bool use_state,
+  uint32_t node_id,
+  bool negate,
+  EvaluationStats * stats)
+{
+  if (!use_state) {
+    std::string error;
+    if (!isValidTree(tree, node_id, &error)) {
+      std::cerr << "evaluate: Invalid expression: " << error << std::endl;
+      return std::make_tuple(false, false, 0);
+    }
+    return evaluateInterface(tree, problem_client, apply, node_id, negate, stats);
+  }
+
+  VectorState state(predicates, functions);
+  return evaluateInState(tree, state, apply, node_id, negate, stats);
+}
+
 std::tuple<bool, bool, double> evaluate(
   const plansys2_msgs::msg::Tree & tree,
   std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
   bool apply,
   uint32_t node_id)
 {
-  std::vector<plansys2::Predicate> predicates;
-  std::vector<plansys2::Function> functions;
-  return evaluate(tree, problem_client, predicates, functions, apply, false, node_id);
+  if (tree.nodes.empty()) {  // No expression
+    return std::make_tuple(true, true, 0);
+  }
+  return problem_client->evaluate(tree, apply, node_id);
 }
 
 std::tuple<bool, bool, double> evaluate(
@@ -324,6 +333,16 @@ std::tuple<bool, bool, double> evaluate(
   return evaluate(tree, problem_client, predicates, functions, apply, true, node_id);
 }
 
+std::tuple<bool, bool, double> evaluate(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  bool apply,
+  uint32_t node_id,
+  EvaluationStats * stats)
+{
+  return evaluateInState(tree, state, apply, node_id, false, stats);
+}
+
 bool check(
   const plansys2_msgs::msg::Tree & tree,
   std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
@@ -345,6 +364,16 @@ bool check(
   return std::get<1>(ret);
 }
 
+bool check(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  uint32_t node_id)
+{
+  std::tuple<bool, bool, double> ret = evaluate(tree, state, false, node_id);
+
+  return std::get<1>(ret);
+}
+
 bool apply(
   const plansys2_msgs::msg::Tree & tree,
   std::shared_ptr<plansys2::ProblemExpertClient> problem_client,
@@ -366,6 +395,16 @@ bool apply(
   return std::get<0>(ret);
 }
 
+bool apply(
+  const plansys2_msgs::msg::Tree & tree,
+  State & state,
+  uint32_t node_id)
+{
+  std::tuple<bool, bool, double> ret = evaluate(tree, state, true, node_id);
+
+  return std::get<0>(ret);
+}
+
 std::pair<std::string, int> parse_action(const std::string & input)
 {
   std::string action = parser::pddl::getReducedString(input);
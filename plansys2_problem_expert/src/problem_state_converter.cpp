@@ -0,0 +1,62 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include "plansys2_core/Utils.hpp"
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_problem_expert/ProblemStateFile.hpp"
+
+std::string read_file(const std::string & path)
+{
+  std::ifstream ifs(path);
+  return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+// Convert a PDDL problem to the binary format of ProblemStateFile
+int main(int argc, char ** argv)
+{
+  if (argc != 4) {
+    std::cerr << "Usage: problem_state_converter <domain.pddl[:domain2.pddl...]> " <<
+      "<problem.pddl> <output_file>" << std::endl;
+    return 1;
+  }
+
+  auto model_files = plansys2::tokenize(argv[1], ":");
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(read_file(model_files[0]));
+  for (size_t i = 1; i < model_files.size(); i++) {
+    domain_expert->extendDomain(read_file(model_files[i]));
+  }
+
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  if (!problem_expert.addProblem(read_file(argv[2]))) {
+    std::cerr << "Error parsing the problem " << argv[2] << std::endl;
+    return 1;
+  }
+
+  if (!plansys2::ProblemStateFile::write(argv[3], problem_expert)) {
+    std::cerr << "Error writing " << argv[3] << std::endl;
+    return 1;
+  }
+
+  std::cerr << "Written " << problem_expert.getInstancesSnapshot()->size() << " instances, " <<
+    problem_expert.getPredicatesSnapshot()->size() << " predicates and " <<
+    problem_expert.getFunctionsSnapshot()->size() << " functions to " << argv[3] << std::endl;
+  return 0;
+}
@@ -0,0 +1,651 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "benchmark/benchmark.h"
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ApplicableActionTracker.hpp"
+#include "plansys2_problem_expert/CompiledTree.hpp"
+#include "plansys2_problem_expert/ConditionWatcher.hpp"
+#include "plansys2_problem_expert/HypotheticalState.hpp"
+#include "plansys2_problem_expert/KnowledgeStorage.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_problem_expert/ProblemStateFile.hpp"
+#include "plansys2_problem_expert/State.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
+
+std::shared_ptr<plansys2::DomainExpert> getDomainExpert()
+{
+  static std::shared_ptr<plansys2::DomainExpert> domain_expert;
+
+  if (domain_expert == nullptr) {
+    std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+    std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+    std::string domain_str((
+        std::istreambuf_iterator<char>(domain_ifs)),
+      std::istreambuf_iterator<char>());
+
+    domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  }
+  return domain_expert;
+}
+
+// (connected wp_i wp_j) facts over the smallest square grid of waypoints holding n facts
+std::vector<plansys2::Predicate> getConnectedPredicates(int n)
+{
+  int side = static_cast<int>(std::ceil(std::sqrt(n)));
+
+  std::vector<plansys2::Predicate> ret;
+  ret.reserve(n);
+  for (int i = 0; i < n; i++) {
+    plansys2_msgs::msg::Node predicate;
+    predicate.node_type = plansys2_msgs::msg::Node::PREDICATE;
+    predicate.name = "connected";
+    predicate.parameters.push_back(
+      parser::pddl::fromStringParam("wp" + std::to_string(i / side), "waypoint"));
+    predicate.parameters.push_back(
+      parser::pddl::fromStringParam("wp" + std::to_string(i % side), "waypoint"));
+    ret.push_back(predicate);
+  }
+  return ret;
+}
+
+std::unique_ptr<plansys2::ProblemExpert> getProblemExpert(int n)
+{
+  auto domain_expert = getDomainExpert();
+  auto problem_expert = std::make_unique<plansys2::ProblemExpert>(domain_expert);
+
+  int side = static_cast<int>(std::ceil(std::sqrt(n)));
+  for (int i = 0; i < side; i++) {
+    problem_expert->addInstance(
+      parser::pddl::fromStringParam("wp" + std::to_string(i), "waypoint"));
+  }
+  return problem_expert;
+}
+
+static void BM_add_predicate(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto problem_expert = getProblemExpert(state.range(0));
+    state.ResumeTiming();
+
+    for (const auto & predicate : predicates) {
+      problem_expert->addPredicate(predicate);
+    }
+
+    state.PauseTiming();
+    problem_expert.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_exist_predicate(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : predicates) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  for (auto _ : state) {
+    for (const auto & predicate : predicates) {
+      benchmark::DoNotOptimize(problem_expert->existPredicate(predicate));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_remove_predicate(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto problem_expert = getProblemExpert(state.range(0));
+    for (const auto & predicate : predicates) {
+      problem_expert->addPredicate(predicate);
+    }
+    state.ResumeTiming();
+
+    for (const auto & predicate : predicates) {
+      problem_expert->removePredicate(predicate);
+    }
+
+    state.PauseTiming();
+    problem_expert.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_get_predicates(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : predicates) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(problem_expert->getPredicates());
+  }
+}
+
+static void BM_get_predicates_snapshot(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : predicates) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(problem_expert->getPredicatesSnapshot());
+  }
+}
+
+// Queries from several threads at once on the ProblemExpert, as the reentrant services of
+// ProblemExpertNode do. Items per second should grow with the number of threads. The test
+// problem_expert_node.concurrent_queries runs clients and a writer against the node itself
+static void BM_concurrent_exist_predicate(benchmark::State & state)
+{
+  static const int n = 100000;
+  static auto predicates = getConnectedPredicates(n);
+  static auto problem_expert = [] {
+      auto ret = getProblemExpert(n);
+      for (const auto & predicate : predicates) {
+        ret->addPredicate(predicate);
+      }
+      return ret;
+    }();
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(problem_expert->existPredicate(predicates[i]));
+    i = (i + 7919) % predicates.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_add_problem(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : getConnectedPredicates(state.range(0))) {
+    problem_expert->addPredicate(predicate);
+  }
+  // getProblem names the domain as the merged domains of DomainExpert
+  auto problem = std::regex_replace(
+    problem_expert->getProblem(), std::regex(":domain [^)]*"), ":domain charging ");
+
+  auto domain_expert = getDomainExpert();
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto loaded_problem_expert = std::make_unique<plansys2::ProblemExpert>(domain_expert);
+    state.ResumeTiming();
+
+    loaded_problem_expert->addProblem(problem);
+
+    state.PauseTiming();
+    loaded_problem_expert.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_load_storage(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : getConnectedPredicates(state.range(0))) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  auto dir = std::filesystem::temp_directory_path() / "plansys2_problem_expert_benchmark";
+  plansys2::KnowledgeStorage storage(dir.string());
+  storage.writeSnapshot(problem_expert->getSnapshot());
+
+  auto domain_expert = getDomainExpert();
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto loaded_problem_expert = std::make_unique<plansys2::ProblemExpert>(domain_expert);
+    state.ResumeTiming();
+
+    storage.load(*loaded_problem_expert);
+
+    state.PauseTiming();
+    loaded_problem_expert.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+
+  std::filesystem::remove_all(dir);
+}
+
+static void BM_load_problem_state(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : getConnectedPredicates(state.range(0))) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  auto path = std::filesystem::temp_directory_path() / "plansys2_problem_expert_benchmark.bin";
+  plansys2::ProblemStateFile::write(path.string(), *problem_expert);
+
+  auto domain_expert = getDomainExpert();
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto loaded_problem_expert = std::make_unique<plansys2::ProblemExpert>(domain_expert);
+    state.ResumeTiming();
+
+    plansys2::ProblemStateFile::load(path.string(), *loaded_problem_expert);
+
+    state.PauseTiming();
+    loaded_problem_expert.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+
+  std::filesystem::remove(path);
+}
+
+static void BM_get_problem(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : getConnectedPredicates(state.range(0))) {
+    problem_expert->addPredicate(predicate);
+  }
+  problem_expert->addInstance(parser::pddl::fromStringParam("r2d2", "robot"));
+  problem_expert->addFunction(plansys2::Function("(= (state_of_charge r2d2) 100.0)"));
+
+  // A replan after a change of the world, as the battery of the robot
+  double charge = 100.0;
+  for (auto _ : state) {
+    charge = charge > 0.0 ? charge - 1.0 : 100.0;
+    problem_expert->updateFunction(
+      plansys2::Function("(= (state_of_charge r2d2) " + std::to_string(charge) + ")"));
+    benchmark::DoNotOptimize(problem_expert->getProblem());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_query_predicates(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  for (const auto & predicate : getConnectedPredicates(state.range(0))) {
+    problem_expert->addPredicate(predicate);
+  }
+
+  // Everything connected to a waypoint
+  plansys2::Predicate pattern("(connected ?from wp0)");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(problem_expert->queryPredicates(pattern));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// (distance wp_i wp_j) functions over the same grid as getConnectedPredicates
+std::vector<plansys2::Function> getDistanceFunctions(int n)
+{
+  std::vector<plansys2::Function> ret;
+  ret.reserve(n);
+  for (const auto & predicate : getConnectedPredicates(n)) {
+    plansys2_msgs::msg::Node function = predicate;
+    function.node_type = plansys2_msgs::msg::Node::FUNCTION;
+    function.name = "distance";
+    ret.push_back(function);
+  }
+  return ret;
+}
+
+static void BM_update_function(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  auto functions = getDistanceFunctions(state.range(0));
+  for (const auto & function : functions) {
+    problem_expert->addFunction(function);
+  }
+
+  int i = 0;
+  for (auto _ : state) {
+    auto & function = functions[i++ % functions.size()];
+    function.value += 1.0;
+    problem_expert->updateFunction(function);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_set_function_values(benchmark::State & state)
+{
+  auto problem_expert = getProblemExpert(state.range(0));
+  std::vector<plansys2::GroundedFact> functions;
+  for (const auto & function : getDistanceFunctions(state.range(0))) {
+    problem_expert->addFunction(function);
+    functions.push_back(plansys2::toGroundedFact(function));
+  }
+
+  int i = 0;
+  for (auto _ : state) {
+    auto & function = functions[i++ % functions.size()];
+    function.setValue(function.getValue() + 1.0);
+    problem_expert->setFunctionValues({function});
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Cost of an update that flips one watch, among state.range(0) watches of other facts
+static void BM_update_watches(benchmark::State & state)
+{
+  std::shared_ptr<plansys2::ProblemExpert> problem_expert = getProblemExpert(state.range(0));
+  problem_expert->setDeltaTracking(true);
+  auto predicates = getConnectedPredicates(state.range(0));
+
+  plansys2::ConditionWatcher watcher(problem_expert);
+  for (const auto & predicate : predicates) {
+    plansys2_msgs::msg::Tree condition;
+    parser::pddl::fromString(condition, "(and " + parser::pddl::toString(predicate) + ")");
+    watcher.addWatch(condition);
+  }
+  problem_expert->takeDelta();
+
+  for (auto _ : state) {
+    problem_expert->addPredicate(predicates[0]);
+    benchmark::DoNotOptimize(watcher.update(problem_expert->takeDelta()));
+    problem_expert->removePredicate(predicates[0]);
+    benchmark::DoNotOptimize(watcher.update(problem_expert->takeDelta()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// A robot in the first of state.range(0) waypoints, all of them connected and charged
+std::shared_ptr<plansys2::ProblemExpert> getChargingProblemExpert(int n)
+{
+  auto domain_expert = getDomainExpert();
+  auto problem_expert = std::make_shared<plansys2::ProblemExpert>(domain_expert);
+  std::vector<plansys2::Instance> instances {parser::pddl::fromStringParam("r2d2", "robot")};
+  std::vector<plansys2::GroundedFact> predicates;
+  std::vector<plansys2::GroundedFact> functions {
+    plansys2::toGroundedFact(plansys2::Function("(= (state_of_charge r2d2) 100)")),
+    plansys2::toGroundedFact(plansys2::Function("(= (max_range r2d2) 100)"))};
+  for (int i = 0; i < n; i++) {
+    instances.push_back(parser::pddl::fromStringParam("wp" + std::to_string(i), "waypoint"));
+    predicates.push_back(
+      plansys2::toGroundedFact(plansys2::Predicate("(charger_at wp" + std::to_string(i) + ")")));
+    for (int j = 0; j < n; j++) {
+      auto pair = "wp" + std::to_string(i) + " wp" + std::to_string(j);
+      predicates.push_back(
+        plansys2::toGroundedFact(plansys2::Predicate("(connected " + pair + ")")));
+      functions.push_back(
+        plansys2::toGroundedFact(plansys2::Function("(= (distance " + pair + ") 1)")));
+    }
+  }
+  predicates.push_back(plansys2::toGroundedFact(plansys2::Predicate("(robot_at r2d2 wp0)")));
+  problem_expert->addFacts(instances, predicates, functions);
+  return problem_expert;
+}
+
+// Applicable actions after the robot moves, among the n^2 + 2n grounded actions of
+// state.range(0) waypoints: from the tracker, updated with the delta of the move, and by
+// grounding every action and checking its requirements
+static void BM_applicable_actions_tracker(benchmark::State & state)
+{
+  auto problem_expert = getChargingProblemExpert(state.range(0));
+  problem_expert->setDeltaTracking(true);
+  plansys2::ApplicableActionTracker tracker(getDomainExpert(), problem_expert);
+  problem_expert->takeDelta();
+
+  plansys2::Predicate at_wp0("(robot_at r2d2 wp0)");
+  plansys2::Predicate at_wp1("(robot_at r2d2 wp1)");
+  for (auto _ : state) {
+    problem_expert->removePredicate(at_wp0);
+    problem_expert->addPredicate(at_wp1);
+    tracker.update(problem_expert->takeDelta());
+    benchmark::DoNotOptimize(tracker.getApplicableActions());
+    problem_expert->removePredicate(at_wp1);
+    problem_expert->addPredicate(at_wp0);
+    tracker.update(problem_expert->takeDelta());
+    benchmark::DoNotOptimize(tracker.getApplicableActions());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Ground every durative action and check its requirements on the facts of a problem
+std::vector<std::string> checkAllActions(
+  std::shared_ptr<plansys2::DomainExpert> domain_expert,
+  std::shared_ptr<plansys2::ProblemExpert> problem_expert)
+{
+  plansys2::State facts(problem_expert->getPredicates(), problem_expert->getFunctions());
+  auto instances = problem_expert->getInstances();
+
+  std::vector<std::string> ret;
+  for (const auto & name : domain_expert->getDurativeActions()) {
+    std::vector<std::vector<std::string>> groundings {{}};
+    for (const auto & parameter : domain_expert->getDurativeAction(name)->parameters) {
+      std::vector<std::vector<std::string>> next;
+      for (const auto & grounding : groundings) {
+        for (const auto & instance : instances) {
+          if (domain_expert->isSubtype(instance.type, parameter.type)) {
+            next.push_back(grounding);
+            next.back().push_back(instance.name);
+          }
+        }
+      }
+      groundings = next;
+    }
+
+    for (const auto & arguments : groundings) {
+      auto action = domain_expert->getDurativeAction(name, arguments);
+      if (plansys2::check(action->at_start_requirements, facts) &&
+        plansys2::check(action->over_all_requirements, facts))
+      {
+        ret.push_back("(" + parser::pddl::nameActionsToString(action) + ")");
+      }
+    }
+  }
+  return ret;
+}
+
+static void BM_applicable_actions_check(benchmark::State & state)
+{
+  auto domain_expert = getDomainExpert();
+  auto problem_expert = getChargingProblemExpert(state.range(0));
+
+  plansys2::Predicate at_wp0("(robot_at r2d2 wp0)");
+  plansys2::Predicate at_wp1("(robot_at r2d2 wp1)");
+  for (auto _ : state) {
+    problem_expert->removePredicate(at_wp0);
+    problem_expert->addPredicate(at_wp1);
+    benchmark::DoNotOptimize(checkAllActions(domain_expert, problem_expert));
+    problem_expert->removePredicate(at_wp1);
+    problem_expert->addPredicate(at_wp0);
+    benchmark::DoNotOptimize(checkAllActions(domain_expert, problem_expert));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Simulation of an action on a copy of a state of state.range(0) facts: copying the vectors
+// and applying the action with plansys2::apply, or forking a HypotheticalState
+static void BM_simulate_action_vectors(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  std::vector<plansys2::Function> functions {
+    plansys2::Function("(= (state_of_charge r2d2) 100)")};
+  auto precondition = parser::pddl::fromString("(and (robot_at r2d2 wp0) (connected wp0 wp1))");
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp0)) (robot_at r2d2 wp1) (decrease (state_of_charge r2d2) 1))");
+
+  for (auto _ : state) {
+    auto branch_predicates = predicates;
+    auto branch_functions = functions;
+    benchmark::DoNotOptimize(plansys2::check(precondition, branch_predicates, branch_functions));
+    benchmark::DoNotOptimize(plansys2::apply(effect, branch_predicates, branch_functions));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_simulate_action_fork(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  plansys2::HypotheticalState root(
+    predicates, {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+  auto precondition = parser::pddl::fromString("(and (robot_at r2d2 wp0) (connected wp0 wp1))");
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp0)) (robot_at r2d2 wp1) (decrease (state_of_charge r2d2) 1))");
+
+  for (auto _ : state) {
+    auto branch = root.fork();
+    benchmark::DoNotOptimize(branch.check(precondition));
+    benchmark::DoNotOptimize(branch.apply(effect));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Check of the preconditions and application of the effects of an action, on a state of
+// state.range(0) facts: with plansys2::evaluate on vectors, searched in O(facts) for each
+// fact of the expression, on a State, in O(size of the expression), with the recursive
+// evaluation of a HypotheticalState, and with the program compiled once from the same trees
+const char kActionPrecondition[] =
+  "(and (robot_at r2d2 wp0) (connected wp0 wp1) (not (robot_at r2d2 wp1)) "
+  "(> (state_of_charge r2d2) (* 2 (distance wp0 wp1))))";
+const char kActionEffect[] =
+  "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp0) "
+  "(decrease (state_of_charge r2d2) (* 0 (distance wp0 wp1))))";
+
+std::vector<plansys2::Function> getActionFunctions()
+{
+  return {
+    plansys2::Function("(= (state_of_charge r2d2) 100)"),
+    plansys2::Function("(= (distance wp0 wp1) 10)")};
+}
+
+static void BM_evaluate_vectors(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  auto functions = getActionFunctions();
+  auto precondition = parser::pddl::fromString(kActionPrecondition);
+  auto effect = parser::pddl::fromString(kActionEffect);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plansys2::check(precondition, predicates, functions));
+    benchmark::DoNotOptimize(plansys2::apply(effect, predicates, functions));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_evaluate_state(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  plansys2::State facts(predicates, getActionFunctions());
+  auto precondition = parser::pddl::fromString(kActionPrecondition);
+  auto effect = parser::pddl::fromString(kActionEffect);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plansys2::check(precondition, facts));
+    benchmark::DoNotOptimize(plansys2::apply(effect, facts));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_evaluate_recursive(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  plansys2::HypotheticalState facts(predicates, getActionFunctions());
+  auto precondition = parser::pddl::fromString(kActionPrecondition);
+  auto effect = parser::pddl::fromString(kActionEffect);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(facts.check(precondition));
+    benchmark::DoNotOptimize(facts.apply(effect));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_evaluate_compiled(benchmark::State & state)
+{
+  auto predicates = getConnectedPredicates(state.range(0));
+  predicates.push_back(plansys2::Predicate("(robot_at r2d2 wp0)"));
+  plansys2::HypotheticalState facts(predicates, getActionFunctions());
+  plansys2::CompiledTree precondition(parser::pddl::fromString(kActionPrecondition));
+  plansys2::CompiledTree effect(parser::pddl::fromString(kActionEffect));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(precondition.check(facts));
+    benchmark::DoNotOptimize(effect.apply(facts));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_add_predicate)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_exist_predicate)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_remove_predicate)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_get_predicates)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_get_predicates_snapshot)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_query_predicates)->RangeMultiplier(10)->Range(1000, 1000000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_update_function)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_set_function_values)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_update_watches)->RangeMultiplier(10)->Range(10, 10000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_applicable_actions_tracker)->RangeMultiplier(2)->Range(8, 64)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_applicable_actions_check)->RangeMultiplier(2)->Range(8, 64)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_simulate_action_vectors)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_simulate_action_fork)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_evaluate_vectors)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_evaluate_state)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_evaluate_recursive)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_evaluate_compiled)->RangeMultiplier(10)->Range(100, 100000)
+->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_get_problem)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_concurrent_exist_predicate)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_add_problem)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_load_storage)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_load_problem_state)->RangeMultiplier(10)->Range(1000, 100000)
+->Unit(benchmark::kMillisecond);
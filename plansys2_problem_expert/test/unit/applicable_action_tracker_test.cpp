@@ -0,0 +1,194 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ApplicableActionTracker.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
+
+// Ground every action and check its conditions, sorted to compare with the tracker
+std::vector<std::string> checkAllActions(
+  std::shared_ptr<plansys2::DomainExpert> domain_expert,
+  std::shared_ptr<plansys2::ProblemExpert> problem_expert)
+{
+  std::vector<std::string> ret;
+  auto instances = problem_expert->getInstances();
+  plansys2::State state(problem_expert->getPredicates(), problem_expert->getFunctions());
+
+  for (const auto & name : domain_expert->getDurativeActions()) {
+    auto parameters = domain_expert->getDurativeAction(name)->parameters;
+    std::vector<std::vector<std::string>> groundings {{}};
+    for (const auto & parameter : parameters) {
+      std::vector<std::vector<std::string>> next;
+      for (const auto & grounding : groundings) {
+        for (const auto & instance : instances) {
+          if (domain_expert->isSubtype(instance.type, parameter.type)) {
+            next.push_back(grounding);
+            next.back().push_back(instance.name);
+          }
+        }
+      }
+      groundings = next;
+    }
+
+    for (const auto & arguments : groundings) {
+      auto action = domain_expert->getDurativeAction(name, arguments);
+      if (plansys2::check(action->at_start_requirements, state) &&
+        plansys2::check(action->over_all_requirements, state))
+      {
+        std::string action_str = "(" + name;
+        for (const auto & argument : arguments) {
+          action_str += " " + argument;
+        }
+        ret.push_back(action_str + ")");
+      }
+    }
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+std::vector<std::string> getSorted(const plansys2::ApplicableActionTracker & tracker)
+{
+  auto ret = tracker.getApplicableActions();
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+TEST(applicable_action_tracker, track_actions)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  auto problem_expert = std::make_shared<plansys2::ProblemExpert>(domain_expert);
+  problem_expert->setDeltaTracking(true);
+
+  plansys2::ApplicableActionTracker tracker(domain_expert, problem_expert);
+  ASSERT_EQ(tracker.size(), 0u);
+  ASSERT_TRUE(tracker.getApplicableActions().empty());
+
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert->addFunction(plansys2::Function("(= (state_of_charge r2d2) 100)")));
+  ASSERT_TRUE(problem_expert->addFunction(plansys2::Function("(= (max_range r2d2) 100)")));
+  ASSERT_TRUE(problem_expert->addFunction(plansys2::Function("(= (distance wp1 wp2) 10)")));
+  tracker.update(problem_expert->takeDelta());
+
+  // move: 1 robot * 2 * 2 waypoints, patrol and charge: 1 robot * 2 waypoints
+  ASSERT_EQ(tracker.size(), 8u);
+  std::vector<std::string> expected {"(move r2d2 wp1 wp2)", "(patrol r2d2 wp1)"};
+  ASSERT_EQ(getSorted(tracker), expected);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+  ASSERT_EQ(tracker.getUnsatisfied("(charge r2d2 wp1)"), 1u);
+  ASSERT_EQ(tracker.getUnsatisfied("(move r2d2 wp2 wp1)"), 3u);
+  ASSERT_FALSE(tracker.getUnsatisfied("(move r2d2 wp3 wp1)").has_value());
+
+  // Only the conjuncts that refer to the changed facts are evaluated
+  auto evaluations = tracker.getEvaluations();
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(patrolled wp1)")));
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.getEvaluations(), evaluations);
+
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(charger_at wp1)")));
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.getEvaluations(), evaluations + 1);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+  ASSERT_EQ(tracker.getUnsatisfied("(charge r2d2 wp1)"), 0u);
+
+  ASSERT_TRUE(problem_expert->removePredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  tracker.update(problem_expert->takeDelta());
+  expected = {"(patrol r2d2 wp2)"};
+  ASSERT_EQ(getSorted(tracker), expected);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+
+  // A new instance grounds only the actions that have it as argument
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp3", "waypoint")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(connected wp2 wp3)")));
+  ASSERT_TRUE(problem_expert->addFunction(plansys2::Function("(= (distance wp2 wp3) 20)")));
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.size(), 15u);
+  expected = {"(move r2d2 wp2 wp3)", "(patrol r2d2 wp2)"};
+  ASSERT_EQ(getSorted(tracker), expected);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+
+  ASSERT_TRUE(problem_expert->updateFunction(plansys2::Function("(= (state_of_charge r2d2) 5)")));
+  tracker.update(problem_expert->takeDelta());
+  expected = {"(patrol r2d2 wp2)"};
+  ASSERT_EQ(getSorted(tracker), expected);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+
+  ASSERT_TRUE(problem_expert->updateFunction(plansys2::Function("(= (state_of_charge r2d2) 50)")));
+  ASSERT_TRUE(problem_expert->removeInstance(plansys2::Instance("wp3", "waypoint")));
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.size(), 8u);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp3", "waypoint")));
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.size(), 15u);
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+
+  ASSERT_TRUE(problem_expert->clearKnowledge());
+  tracker.update(problem_expert->takeDelta());
+  ASSERT_EQ(tracker.size(), 0u);
+  ASSERT_TRUE(tracker.getApplicableActions().empty());
+}
+
+TEST(applicable_action_tracker, ground_existing_problem)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+  std::ifstream problem_ifs(pkgpath + "/pddl/problem_charging.pddl");
+  std::string problem_str((
+      std::istreambuf_iterator<char>(problem_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  auto problem_expert = std::make_shared<plansys2::ProblemExpert>(domain_expert);
+  ASSERT_TRUE(problem_expert->addProblem(problem_str));
+
+  plansys2::ApplicableActionTracker tracker(domain_expert, problem_expert);
+  ASSERT_GT(tracker.size(), 0u);
+  ASSERT_FALSE(tracker.getApplicableActions().empty());
+  ASSERT_EQ(getSorted(tracker), checkAllActions(domain_expert, problem_expert));
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,156 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/CompiledTree.hpp"
+#include "plansys2_problem_expert/HypotheticalState.hpp"
+
+plansys2::HypotheticalState getState()
+{
+  return plansys2::HypotheticalState(
+    {plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)"),
+      plansys2::Function("(= (speed r2d2) 2)")});
+}
+
+// The facts of a state as sorted strings, to compare states
+std::vector<std::string> getFacts(const plansys2::HypotheticalState & state)
+{
+  std::vector<std::string> ret;
+  for (const auto & predicate : state.getPredicates()) {
+    ret.push_back(parser::pddl::toString(predicate));
+  }
+  for (const auto & function : state.getFunctions()) {
+    ret.push_back(parser::pddl::toString(function) + " = " + std::to_string(function.value));
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+TEST(compiled_tree, same_as_evaluate)
+{
+  std::vector<std::string> expressions {
+    "(and (robot_at r2d2 wp1) (connected wp1 wp2))",
+    "(and (robot_at r2d2 wp2))",
+    "(or (robot_at r2d2 wp2) (not (connected wp2 wp1)))",
+    "(not (and (robot_at r2d2 wp1) (robot_at r2d2 wp2)))",
+    "(and (> (state_of_charge r2d2) 50) (< (* (speed r2d2) 10) 30))",
+    "(and (>= (/ (state_of_charge r2d2) 0) 1))",
+    "(and (> (unknown r2d2) 1))",
+    "(and (robot_at r2d2 wp2) (> (unknown r2d2) 1))",
+    "(or (connected wp1 wp2) (> (unknown r2d2) 1) (robot_at r2d2 wp2))",
+    "(and (or (robot_at r2d2 wp2) (connected wp1 wp2)) (not (connected wp1 wp2)) (> 1 0))",
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))",
+    "(and (increase (state_of_charge r2d2) (* (speed r2d2) 3)) (assign (speed r2d2) 4))",
+    "(and (scale-down (speed r2d2) 0))",
+    "(and (increase (unknown r2d2) 1))",
+  };
+
+  for (const auto & expression : expressions) {
+    auto tree = parser::pddl::fromString(expression);
+    plansys2::CompiledTree program(tree);
+
+    for (bool apply : {false, true}) {
+      auto expected_state = getState();
+      auto state = getState();
+      auto expected = expected_state.evaluate(tree, apply);
+      ASSERT_EQ(program.evaluate(state, apply), expected) << expression;
+      ASSERT_EQ(getFacts(state), getFacts(expected_state)) << expression;
+    }
+  }
+}
+
+TEST(compiled_tree, check_and_apply)
+{
+  auto state = getState();
+
+  plansys2::CompiledTree empty;
+  ASSERT_TRUE(empty.check(state));
+  ASSERT_TRUE(empty.apply(state));
+  ASSERT_EQ(empty.size(), 0u);
+
+  auto tree = parser::pddl::fromString("(and (robot_at r2d2 wp1) (robot_at r2d2 wp2))");
+  ASSERT_FALSE(plansys2::CompiledTree(tree).check(state));
+  ASSERT_TRUE(plansys2::CompiledTree(tree, 1).check(state));
+  ASSERT_FALSE(plansys2::CompiledTree(tree, 2).check(state));
+
+  // Negations are resolved when compiling
+  plansys2::CompiledTree negated(parser::pddl::fromString("(not (not (robot_at r2d2 wp1)))"));
+  ASSERT_EQ(negated.size(), 1u);
+  ASSERT_TRUE(negated.check(state));
+
+  plansys2::CompiledTree move(
+    parser::pddl::fromString(
+      "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))"));
+  ASSERT_TRUE(move.apply(state));
+  ASSERT_TRUE(move.apply(state));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 80.0);
+}
+
+TEST(compiled_tree, large_expression)
+{
+  std::vector<plansys2::Predicate> predicates;
+  std::string expression = "(and";
+  for (int i = 0; i < 100; i++) {
+    auto predicate = "(robot_at r2d2 wp" + std::to_string(i) + ")";
+    predicates.push_back(plansys2::Predicate(predicate));
+    expression += " " + predicate;
+  }
+  expression += ")";
+
+  plansys2::HypotheticalState state(predicates, {});
+  auto tree = parser::pddl::fromString(expression);
+  plansys2::CompiledTree program(tree);
+
+  ASSERT_TRUE(program.check(state));
+  state.removePredicate(plansys2::toGroundedFact(predicates.back()));
+  ASSERT_FALSE(program.check(state));
+}
+
+TEST(compiled_tree, durative_action)
+{
+  plansys2_msgs::msg::DurativeAction action;
+  action.at_start_requirements = parser::pddl::fromString("(and (robot_at r2d2 wp1))");
+  action.over_all_requirements = parser::pddl::fromString("(and (connected wp1 wp2))");
+  action.at_start_effects = parser::pddl::fromString("(and (not (robot_at r2d2 wp1)))");
+  action.at_end_effects = parser::pddl::fromString("(and (robot_at r2d2 wp2))");
+
+  plansys2::CompiledDurativeAction compiled(action);
+  auto state = getState();
+
+  ASSERT_TRUE(compiled.at_start_requirements.check(state));
+  ASSERT_TRUE(compiled.over_all_requirements.check(state));
+  ASSERT_TRUE(compiled.at_end_requirements.check(state));
+  ASSERT_TRUE(compiled.at_start_effects.apply(state));
+  ASSERT_TRUE(compiled.at_end_effects.apply(state));
+  ASSERT_FALSE(compiled.at_start_requirements.check(state));
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
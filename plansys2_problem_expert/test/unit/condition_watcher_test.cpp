@@ -0,0 +1,179 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ConditionWatcher.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+std::shared_ptr<plansys2::ProblemExpert> getChargingProblemExpert()
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  auto problem_expert = std::make_shared<plansys2::ProblemExpert>(domain_expert);
+  problem_expert->setDeltaTracking(true);
+  return problem_expert;
+}
+
+plansys2_msgs::msg::Tree getCondition(const std::string & expr)
+{
+  plansys2_msgs::msg::Tree condition;
+  parser::pddl::fromString(condition, expr);
+  return condition;
+}
+
+TEST(condition_watcher, notify_flips)
+{
+  auto problem_expert = getChargingProblemExpert();
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert->addFunction(plansys2::Function("(= (state_of_charge r2d2) 80)")));
+  problem_expert->takeDelta();
+
+  plansys2::ConditionWatcher watcher(problem_expert);
+  auto at_wp1 = watcher.addWatch(getCondition("(and (robot_at r2d2 wp1))"));
+  auto at_wp2_charged = watcher.addWatch(
+    getCondition("(and (robot_at r2d2 wp2) (> (state_of_charge r2d2) 50))"));
+  auto not_patrolled = watcher.addWatch(getCondition("(and (not (patrolled wp2)))"));
+  ASSERT_EQ(watcher.size(), 3u);
+  ASSERT_TRUE(watcher.getValue(at_wp1).value());
+  ASSERT_FALSE(watcher.getValue(at_wp2_charged).value());
+  ASSERT_TRUE(watcher.getValue(not_patrolled).value());
+
+  ASSERT_TRUE(problem_expert->removePredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  auto changes = watcher.update(problem_expert->takeDelta());
+  std::vector<std::pair<uint64_t, bool>> expected {{at_wp1, false}, {at_wp2_charged, true}};
+  ASSERT_EQ(changes, expected);
+  ASSERT_EQ(watcher.getEvaluations(), 2u);
+
+  // Only the flips are notified
+  ASSERT_TRUE(problem_expert->updateFunction(plansys2::Function("(= (state_of_charge r2d2) 60)")));
+  ASSERT_TRUE(watcher.update(problem_expert->takeDelta()).empty());
+  ASSERT_TRUE(problem_expert->updateFunction(plansys2::Function("(= (state_of_charge r2d2) 40)")));
+  expected = {{at_wp2_charged, false}};
+  ASSERT_EQ(watcher.update(problem_expert->takeDelta()), expected);
+
+  // Facts not referred by any watch do not evaluate anything
+  auto evaluations = watcher.getEvaluations();
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(patrolled wp1)")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(watcher.update(problem_expert->takeDelta()).empty());
+  ASSERT_EQ(watcher.getEvaluations(), evaluations);
+
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(patrolled wp2)")));
+  expected = {{not_patrolled, false}};
+  ASSERT_EQ(watcher.update(problem_expert->takeDelta()), expected);
+
+  ASSERT_TRUE(watcher.removeWatch(not_patrolled));
+  ASSERT_FALSE(watcher.removeWatch(not_patrolled));
+  ASSERT_FALSE(watcher.getValue(not_patrolled).has_value());
+  ASSERT_TRUE(problem_expert->removePredicate(plansys2::Predicate("(patrolled wp2)")));
+  ASSERT_TRUE(watcher.update(problem_expert->takeDelta()).empty());
+
+  // A reset evaluates all the watches
+  ASSERT_TRUE(problem_expert->clearKnowledge());
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  expected = {{at_wp1, true}};
+  ASSERT_EQ(watcher.update(problem_expert->takeDelta()), expected);
+}
+
+TEST(condition_watcher, unrelated_watches)
+{
+  auto problem_expert = getChargingProblemExpert();
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  for (int i = 0; i < 500; i++) {
+    ASSERT_TRUE(
+      problem_expert->addInstance(plansys2::Instance("wp" + std::to_string(i), "waypoint")));
+  }
+  problem_expert->takeDelta();
+
+  plansys2::ConditionWatcher watcher(problem_expert);
+  std::vector<uint64_t> ids;
+  for (int i = 0; i < 500; i++) {
+    ids.push_back(
+      watcher.addWatch(getCondition("(and (robot_at r2d2 wp" + std::to_string(i) + "))")));
+  }
+
+  for (int i = 0; i < 500; i++) {
+    ASSERT_TRUE(
+      problem_expert->addPredicate(
+        plansys2::Predicate("(robot_at r2d2 wp" + std::to_string(i) + ")")));
+    std::vector<std::pair<uint64_t, bool>> expected {{ids[i], true}};
+    ASSERT_EQ(watcher.update(problem_expert->takeDelta()), expected);
+  }
+  ASSERT_EQ(watcher.getEvaluations(), 500u);
+}
+
+TEST(condition_watcher, expire_watches)
+{
+  auto problem_expert = getChargingProblemExpert();
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp1", "waypoint")));
+  problem_expert->takeDelta();
+
+  plansys2::ConditionWatcher watcher(problem_expert);
+  auto condition = getCondition("(and (robot_at r2d2 wp1))");
+  auto unowned = watcher.addWatch(condition);
+  auto of_monitor = watcher.addWatch(condition, "/monitor");
+  auto of_crashed = watcher.addWatch(condition, "/crashed");
+  auto of_crashed_2 = watcher.addWatch(condition, "/crashed");
+
+  // An owner missing once is given another chance, as it may not be known yet
+  ASSERT_TRUE(watcher.expireWatches({"/crashed"}).empty());
+  ASSERT_TRUE(watcher.expireWatches({"/monitor"}).empty());
+  ASSERT_EQ(watcher.size(), 4u);
+
+  std::vector<uint64_t> expected {of_crashed, of_crashed_2};
+  ASSERT_EQ(watcher.expireWatches({"/monitor"}), expected);
+  ASSERT_EQ(watcher.size(), 2u);
+  ASSERT_FALSE(watcher.getValue(of_crashed).has_value());
+  ASSERT_TRUE(watcher.getValue(of_monitor).has_value());
+
+  // Watches without owner are never expired, and the expired ones are not updated anymore
+  ASSERT_TRUE(watcher.expireWatches({}).empty());
+  expected = {of_monitor};
+  ASSERT_EQ(watcher.expireWatches({}), expected);
+  ASSERT_TRUE(watcher.getValue(unowned).has_value());
+
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  std::vector<std::pair<uint64_t, bool>> changes {{unowned, true}};
+  ASSERT_EQ(watcher.update(problem_expert->takeDelta()), changes);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/EvaluationStats.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
+
+using namespace std::chrono_literals;
+
+// Check an expression on a state, recording it in stats
+std::tuple<bool, bool, double> check(
+  const std::string & expression,
+  std::vector<plansys2::Predicate> & predicates,
+  std::vector<plansys2::Function> & functions,
+  plansys2::EvaluationStats & stats)
+{
+  std::shared_ptr<plansys2::ProblemExpertInterface> problem_expert;
+  return plansys2::evaluate(
+    parser::pddl::fromString(expression), problem_expert, predicates, functions,
+    false, true, 0, false, &stats);
+}
+
+TEST(evaluation_stats, short_circuit)
+{
+  std::vector<plansys2::Predicate> predicates {
+    plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")};
+  std::vector<plansys2::Function> functions;
+  plansys2::EvaluationStats stats(false);
+
+  ASSERT_EQ(
+    check("(and (robot_at r2d2 wp2) (connected wp1 wp2) (connected wp2 wp1))",
+    predicates, functions, stats),
+    std::make_tuple(true, false, 0));
+  ASSERT_EQ(stats.getEvaluations(), 1u);
+  ASSERT_EQ(stats.getSkipped(), 2u);
+
+  ASSERT_EQ(
+    check("(or (robot_at r2d2 wp2) (connected wp1 wp2) (connected wp2 wp1))",
+    predicates, functions, stats),
+    std::make_tuple(true, true, 0));
+  ASSERT_EQ(stats.getEvaluations(), 3u);
+  ASSERT_EQ(stats.getSkipped(), 3u);
+
+  // A child after the one that decides the result is not evaluated, so it can not fail
+  ASSERT_EQ(
+    check("(and (robot_at r2d2 wp2) (> (unknown r2d2) 1))", predicates, functions, stats),
+    std::make_tuple(true, false, 0));
+  ASSERT_EQ(
+    check("(and (robot_at r2d2 wp1) (> (unknown r2d2) 1))", predicates, functions, stats),
+    std::make_tuple(false, false, 0));
+
+  auto entry = stats.getEntry("(robot_at r2d2 wp2)");
+  ASSERT_TRUE(entry.has_value());
+  ASSERT_EQ(entry.value().evaluations, 3u);
+  ASSERT_EQ(entry.value().true_count, 0u);
+  ASSERT_FALSE(stats.getEntry("(connected wp2 wp1)").has_value());
+
+  stats.reset();
+  ASSERT_EQ(stats.getEvaluations(), 0u);
+  ASSERT_EQ(stats.getSkipped(), 0u);
+  ASSERT_TRUE(stats.getEntries().empty());
+}
+
+TEST(evaluation_stats, apply_all)
+{
+  std::vector<plansys2::Predicate> predicates {plansys2::Predicate("(robot_at r2d2 wp1)")};
+  std::vector<plansys2::Function> functions;
+  plansys2::EvaluationStats stats;
+
+  std::shared_ptr<plansys2::ProblemExpertInterface> problem_expert;
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (connected wp1 wp2))");
+  ASSERT_TRUE(
+    std::get<0>(
+      plansys2::evaluate(
+        effect, problem_expert, predicates, functions, true, true, 0, false, &stats)));
+
+  ASSERT_EQ(predicates.size(), 2u);
+  ASSERT_EQ(stats.getEvaluations(), 0u);
+  ASSERT_EQ(stats.getSkipped(), 0u);
+}
+
+TEST(evaluation_stats, order)
+{
+  plansys2::EvaluationStats stats;
+  std::vector<std::string> keys {"(a)", "(b)", "(c)", "(d)"};
+
+  // Without statistics, the original order
+  ASSERT_EQ(stats.getOrder(keys, false), std::vector<std::size_t>({0, 1, 2, 3}));
+
+  // (a) is cheap and always true, (b) expensive and always false, (c) cheap and always false
+  for (int i = 0; i < 10; i++) {
+    stats.record("(a)", true, 10ns);
+    stats.record("(b)", false, 1000ns);
+    stats.record("(c)", false, 10ns);
+  }
+
+  // Children without statistics first, then the cheapest to decide
+  ASSERT_EQ(stats.getOrder(keys, false), std::vector<std::size_t>({3, 2, 0, 1}));
+  ASSERT_EQ(stats.getOrder(keys, true), std::vector<std::size_t>({3, 0, 2, 1}));
+
+  stats.setReorder(false);
+  ASSERT_EQ(stats.getOrder(keys, false), std::vector<std::size_t>({0, 1, 2, 3}));
+}
+
+TEST(evaluation_stats, reorder)
+{
+  std::vector<plansys2::Predicate> predicates {
+    plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")};
+  std::vector<plansys2::Function> functions;
+  plansys2::EvaluationStats stats;
+
+  stats.record("(connected wp2 wp1)", false, 10ns);
+  for (int i = 0; i < 10; i++) {
+    stats.record("(robot_at r2d2 wp1)", true, 1000ns);
+    stats.record("(connected wp1 wp2)", true, 1000ns);
+  }
+  auto evaluations = stats.getEvaluations();
+
+  ASSERT_EQ(
+    check("(and (robot_at r2d2 wp1) (connected wp1 wp2) (connected wp2 wp1))",
+    predicates, functions, stats),
+    std::make_tuple(true, false, 0));
+  ASSERT_EQ(stats.getEvaluations(), evaluations + 1);
+  ASSERT_EQ(stats.getSkipped(), 2u);
+  ASSERT_EQ(stats.getEntry("(connected wp2 wp1)").value().evaluations, 2u);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
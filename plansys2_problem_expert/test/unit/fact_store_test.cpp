@@ -0,0 +1,109 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "plansys2_msgs/msg/node.hpp"
+#include "plansys2_msgs/msg/param.hpp"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_problem_expert/FactStore.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+using PredicateStore = plansys2::FactStore<plansys2::Predicate, plansys2::NodeHash,
+    plansys2::NodeEqual>;
+
+std::vector<std::string> getNames(const PredicateStore & store)
+{
+  std::vector<std::string> ret;
+  for (const auto & predicate : store) {
+    ret.push_back(parser::pddl::toString(predicate));
+  }
+  return ret;
+}
+
+TEST(fact_store, insert_find_erase)
+{
+  PredicateStore store;
+
+  auto pred_1 = parser::pddl::fromStringPredicate("(robot_at r2d2 kitchen)");
+  auto pred_2 = parser::pddl::fromStringPredicate("(robot_at r2d2 bedroom)");
+  auto pred_3 = parser::pddl::fromStringPredicate("(robot_at kitchen r2d2)");
+
+  ASSERT_TRUE(store.empty());
+  ASSERT_EQ(store.find(pred_1), PredicateStore::npos);
+
+  auto res_1 = store.insert(pred_1);
+  ASSERT_TRUE(res_1.second);
+  auto res_2 = store.insert(pred_1);
+  ASSERT_FALSE(res_2.second);
+  ASSERT_EQ(res_1.first, res_2.first);
+  ASSERT_EQ(store.size(), 1u);
+
+  ASSERT_TRUE(store.insert(pred_2).second);
+  ASSERT_TRUE(store.contains(pred_1));
+  ASSERT_TRUE(store.contains(pred_2));
+  ASSERT_FALSE(store.contains(pred_3));
+
+  ASSERT_TRUE(store.erase(pred_1));
+  ASSERT_FALSE(store.erase(pred_1));
+  ASSERT_FALSE(store.contains(pred_1));
+  ASSERT_FALSE(store.alive(res_1.first));
+  ASSERT_EQ(store.size(), 1u);
+
+  store.clear();
+  ASSERT_TRUE(store.empty());
+  ASSERT_FALSE(store.contains(pred_2));
+}
+
+TEST(fact_store, insertion_order)
+{
+  PredicateStore store;
+
+  store.insert(parser::pddl::fromStringPredicate("(p a)"));
+  auto id_b = store.insert(parser::pddl::fromStringPredicate("(p b)")).first;
+  store.insert(parser::pddl::fromStringPredicate("(p c)"));
+  store.insert(parser::pddl::fromStringPredicate("(p d)"));
+
+  ASSERT_EQ(
+    getNames(store),
+    std::vector<std::string>({"(p a)", "(p b)", "(p c)", "(p d)"}));
+
+  store.erase(parser::pddl::fromStringPredicate("(p a)"));
+  store.erase(parser::pddl::fromStringPredicate("(p c)"));
+  ASSERT_EQ(getNames(store), std::vector<std::string>({"(p b)", "(p d)"}));
+
+  // Free slots are reused, but new items are still placed at the end
+  store.insert(parser::pddl::fromStringPredicate("(p e)"));
+  store.insert(parser::pddl::fromStringPredicate("(p f)"));
+  ASSERT_EQ(getNames(store), std::vector<std::string>({"(p b)", "(p d)", "(p e)", "(p f)"}));
+
+  store.moveToBack(id_b);
+  ASSERT_EQ(getNames(store), std::vector<std::string>({"(p d)", "(p e)", "(p f)", "(p b)"}));
+  ASSERT_EQ(store.find(parser::pddl::fromStringPredicate("(p b)")), id_b);
+
+  auto values = store.values();
+  ASSERT_EQ(values.size(), 4u);
+  ASSERT_EQ(parser::pddl::toString(values[0]), "(p d)");
+  ASSERT_EQ(parser::pddl::toString(values[3]), "(p b)");
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/GoalTracker.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+TEST(goal_tracker, track_subgoals)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  auto problem_expert = std::make_shared<plansys2::ProblemExpert>(domain_expert);
+  problem_expert->setDeltaTracking(true);
+
+  plansys2::GoalTracker tracker(problem_expert);
+  ASSERT_FALSE(tracker.isSatisfied());
+  ASSERT_TRUE(tracker.getStatus().satisfied_subgoals.empty());
+  ASSERT_TRUE(tracker.getStatus().unsatisfied_subgoals.empty());
+
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert->addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(patrolled wp1)")));
+  ASSERT_TRUE(
+    problem_expert->setGoal(plansys2::Goal("(and (patrolled wp1) (patrolled wp2))")));
+  ASSERT_TRUE(tracker.update(problem_expert->takeDelta()));
+
+  auto status = tracker.getStatus();
+  ASSERT_FALSE(status.satisfied);
+  ASSERT_EQ(status.satisfied_subgoals.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(status.satisfied_subgoals[0]), "(and (patrolled wp1))");
+  ASSERT_EQ(status.unsatisfied_subgoals.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(status.unsatisfied_subgoals[0]), "(and (patrolled wp2))");
+
+  // Changes to facts out of the goal do not change its status
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_FALSE(tracker.update(problem_expert->takeDelta()));
+
+  ASSERT_TRUE(problem_expert->addPredicate(plansys2::Predicate("(patrolled wp2)")));
+  ASSERT_TRUE(tracker.update(problem_expert->takeDelta()));
+  ASSERT_TRUE(tracker.isSatisfied());
+  status = tracker.getStatus();
+  ASSERT_TRUE(status.satisfied);
+  ASSERT_EQ(status.satisfied_subgoals.size(), 2u);
+  ASSERT_TRUE(status.unsatisfied_subgoals.empty());
+  ASSERT_EQ(tracker.isSatisfied(), problem_expert->isGoalSatisfied(problem_expert->getGoal()));
+
+  ASSERT_TRUE(problem_expert->removePredicate(plansys2::Predicate("(patrolled wp1)")));
+  ASSERT_TRUE(tracker.update(problem_expert->takeDelta()));
+  ASSERT_FALSE(tracker.isSatisfied());
+  ASSERT_EQ(tracker.isSatisfied(), problem_expert->isGoalSatisfied(problem_expert->getGoal()));
+
+  // A goal that is not a conjunction is a single subgoal
+  ASSERT_TRUE(problem_expert->setGoal(plansys2::Goal("(or (patrolled wp1) (patrolled wp2))")));
+  ASSERT_TRUE(tracker.update(problem_expert->takeDelta()));
+  ASSERT_TRUE(tracker.isSatisfied());
+  ASSERT_EQ(tracker.getStatus().satisfied_subgoals.size(), 1u);
+
+  ASSERT_TRUE(problem_expert->clearGoal());
+  ASSERT_TRUE(tracker.update(problem_expert->takeDelta()));
+  ASSERT_FALSE(tracker.isSatisfied());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,119 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/HypotheticalState.hpp"
+
+TEST(hypothetical_state, check_and_apply)
+{
+  plansys2::HypotheticalState state(
+    {plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+
+  auto move = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))");
+
+  ASSERT_TRUE(
+    state.check(parser::pddl::fromString("(and (robot_at r2d2 wp1) (connected wp1 wp2))")));
+  ASSERT_FALSE(state.check(parser::pddl::fromString("(and (robot_at r2d2 wp2))")));
+  ASSERT_TRUE(state.check(parser::pddl::fromString("(and (> (state_of_charge r2d2) 50))")));
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at unknown_robot wp1)")));
+
+  ASSERT_TRUE(state.apply(move));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 90.0);
+  ASSERT_EQ(state.getPredicates().size(), 2u);
+  ASSERT_EQ(state.getFunctions().size(), 1u);
+  ASSERT_EQ(state.getFunctions()[0].value, 90.0);
+
+  // Functions that the state does not have cannot be modified
+  ASSERT_FALSE(state.apply(parser::pddl::fromString("(and (increase (speed r2d2) 1))")));
+}
+
+TEST(hypothetical_state, fork)
+{
+  plansys2::HypotheticalState state(
+    {plansys2::Predicate("(robot_at r2d2 wp1)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+
+  auto to_wp2 = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))");
+  auto to_wp3 = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp3) (decrease (state_of_charge r2d2) 30))");
+
+  auto branch_2 = state.fork();
+  auto branch_3 = state.fork();
+  ASSERT_TRUE(branch_2.apply(to_wp2));
+  ASSERT_TRUE(branch_3.apply(to_wp3));
+
+  // Each branch only sees its own changes
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 100.0);
+  ASSERT_TRUE(branch_2.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_FALSE(branch_2.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_FALSE(branch_2.existPredicate(plansys2::Predicate("(robot_at r2d2 wp3)")));
+  ASSERT_EQ(branch_2.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 90.0);
+  ASSERT_TRUE(branch_3.existPredicate(plansys2::Predicate("(robot_at r2d2 wp3)")));
+  ASSERT_EQ(branch_3.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 70.0);
+
+  // Changes after a fork do not reach it
+  auto sub_branch = branch_2.fork();
+  ASSERT_TRUE(branch_2.apply(parser::pddl::fromString("(and (not (robot_at r2d2 wp2)))")));
+  ASSERT_TRUE(sub_branch.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_FALSE(branch_2.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+}
+
+TEST(hypothetical_state, merge_layers)
+{
+  plansys2::HypotheticalState state(
+    {plansys2::Predicate("(robot_at r2d2 wp0)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+
+  // A long sequence of actions, forking before each of them
+  for (int i = 0; i < 100; i++) {
+    auto next = state.fork();
+    auto move = parser::pddl::fromString(
+      "(and (not (robot_at r2d2 wp" + std::to_string(i) + ")) (robot_at r2d2 wp" +
+      std::to_string(i + 1) + ") (decrease (state_of_charge r2d2) 1))");
+    ASSERT_TRUE(next.apply(move));
+    state = next;
+    ASSERT_LE(state.getDepth(), plansys2::HypotheticalState::kMaxDepth);
+
+    // The layers are merged on top of the initial one, which is kept shared
+    if (i > 0) {
+      ASSERT_GE(state.getDepth(), 2u);
+    }
+  }
+
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp100)")));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp0)")));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp50)")));
+  ASSERT_EQ(state.getPredicates().size(), 1u);
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(state_of_charge r2d2)")), 0.0);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,168 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/KnowledgeReplica.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+TEST(knowledge_replica, follow_deltas)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  problem_expert.setDeltaTracking(true);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+  auto first_delta = problem_expert.takeDelta();
+
+  plansys2::KnowledgeReplica replica;
+  ASSERT_FALSE(replica.isSynced());
+
+  // A delta is useless until the replica has a snapshot
+  ASSERT_FALSE(replica.apply(first_delta));
+  ASSERT_FALSE(replica.isSynced());
+
+  ASSERT_TRUE(replica.apply(problem_expert.getSnapshot()));
+  ASSERT_TRUE(replica.isSynced());
+  ASSERT_EQ(replica.getRevision(), problem_expert.getRevision());
+  ASSERT_EQ(replica.getInstances().size(), 3u);
+  ASSERT_TRUE(replica.getInstance("wp1").has_value());
+  ASSERT_EQ(replica.getInstance("wp1").value().type, "waypoint");
+  ASSERT_TRUE(replica.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_EQ(replica.getFunction("(speed r2d2)").value().value, 1.0);
+
+  // Deltas already included in the replica are ignored
+  ASSERT_TRUE(replica.apply(first_delta));
+  ASSERT_EQ(replica.getInstances().size(), 3u);
+
+  ASSERT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.updateFunction(plansys2::Function("(= (speed r2d2) 3.0)")));
+  ASSERT_TRUE(problem_expert.setGoal(plansys2::Goal("(and (robot_at r2d2 wp1))")));
+
+  ASSERT_TRUE(replica.apply(problem_expert.takeDelta()));
+  ASSERT_EQ(replica.getRevision(), problem_expert.getRevision());
+  ASSERT_FALSE(replica.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(replica.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_EQ(replica.getPredicates().size(), 2u);
+  ASSERT_EQ(replica.getFunctions().size(), 1u);
+  ASSERT_EQ(replica.getFunction("(speed r2d2)").value().value, 3.0);
+  ASSERT_EQ(replica.getFunctionValue(plansys2::Function("(= (speed r2d2) 0.0)")), 3.0);
+  ASSERT_FALSE(replica.getFunctionValue(plansys2::Function("(= (speed c3po) 0.0)")).has_value());
+  ASSERT_EQ(parser::pddl::toString(replica.getGoal()), "(and (robot_at r2d2 wp1))");
+
+  // Removing an instance removes the facts that refer to it
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(replica.apply(problem_expert.takeDelta()));
+  ASSERT_EQ(replica.getInstances().size(), 2u);
+  ASSERT_TRUE(replica.getPredicates().empty());
+
+  // A missing delta makes the replica unsynced until the next snapshot
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp3", "waypoint")));
+  problem_expert.takeDelta();
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp4", "waypoint")));
+  ASSERT_FALSE(replica.apply(problem_expert.takeDelta()));
+  ASSERT_FALSE(replica.isSynced());
+
+  ASSERT_TRUE(replica.apply(problem_expert.getSnapshot()));
+  ASSERT_TRUE(replica.isSynced());
+  ASSERT_EQ(replica.getInstances().size(), 4u);
+
+  ASSERT_TRUE(problem_expert.clearKnowledge());
+  ASSERT_TRUE(replica.apply(problem_expert.takeDelta()));
+  ASSERT_TRUE(replica.getInstances().empty());
+  ASSERT_TRUE(replica.getFunctions().empty());
+}
+
+TEST(knowledge_replica, new_epoch)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  problem_expert.setDeltaTracking(true);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+
+  plansys2::KnowledgeReplica replica;
+  auto snapshot = problem_expert.getSnapshot();
+  snapshot.epoch = 1;
+  ASSERT_TRUE(replica.apply(snapshot));
+  ASSERT_EQ(replica.getEpoch(), 1u);
+  ASSERT_EQ(replica.getRevision(), 4u);
+
+  // A restarted problem expert numbers its revisions from scratch
+  plansys2::ProblemExpert restarted_expert(domain_expert);
+  restarted_expert.setDeltaTracking(true);
+  ASSERT_TRUE(restarted_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  auto first_delta = restarted_expert.takeDelta();
+  first_delta.epoch = 2;
+  ASSERT_TRUE(restarted_expert.addInstance(plansys2::Instance("wp3", "waypoint")));
+  auto second_delta = restarted_expert.takeDelta();
+  second_delta.epoch = 2;
+
+  // Its deltas are not taken as old ones, but as a gap
+  ASSERT_FALSE(replica.apply(first_delta));
+  ASSERT_FALSE(replica.isSynced());
+
+  // Its snapshots are applied, even if their revision is lower
+  snapshot = restarted_expert.getSnapshot();
+  snapshot.epoch = 2;
+  ASSERT_TRUE(replica.apply(snapshot));
+  ASSERT_TRUE(replica.isSynced());
+  ASSERT_EQ(replica.getEpoch(), 2u);
+  ASSERT_EQ(replica.getRevision(), 2u);
+  ASSERT_EQ(replica.getInstances().size(), 2u);
+  ASSERT_TRUE(replica.getPredicates().empty());
+
+  // Deltas of the previous epoch are not applied on top of it
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  auto old_delta = problem_expert.takeDelta();
+  old_delta.epoch = 1;
+  ASSERT_FALSE(replica.apply(old_delta));
+  ASSERT_FALSE(replica.isSynced());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
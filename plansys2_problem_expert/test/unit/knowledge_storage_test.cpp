@@ -0,0 +1,162 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/KnowledgeStorage.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+std::shared_ptr<plansys2::DomainExpert> getDomainExpert()
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  return std::make_shared<plansys2::DomainExpert>(domain_str);
+}
+
+std::string getStorageDir()
+{
+  auto dir = std::filesystem::temp_directory_path() / "plansys2_knowledge_storage_test";
+  std::filesystem::remove_all(dir);
+  return dir.string();
+}
+
+TEST(knowledge_storage, encode_decode)
+{
+  auto domain_expert = getDomainExpert();
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.5)")));
+  ASSERT_TRUE(problem_expert.setGoal(plansys2::Goal("(and (robot_at r2d2 wp1))")));
+
+  auto snapshot = problem_expert.getSnapshot();
+  auto encoded = plansys2::KnowledgeStorage::encode(snapshot);
+  auto decoded = plansys2::KnowledgeStorage::decode(encoded);
+
+  ASSERT_TRUE(decoded.has_value());
+  ASSERT_EQ(decoded.value(), snapshot);
+
+  ASSERT_FALSE(plansys2::KnowledgeStorage::decode(encoded.substr(0, encoded.size() - 1)));
+  ASSERT_FALSE(plansys2::KnowledgeStorage::decode(encoded + "x"));
+}
+
+TEST(knowledge_storage, log_and_load)
+{
+  auto domain_expert = getDomainExpert();
+  auto dir = getStorageDir();
+
+  {
+    plansys2::ProblemExpert problem_expert(domain_expert);
+    plansys2::KnowledgeStorage storage(dir, plansys2::KnowledgeStorage::Durability::ALWAYS);
+    ASSERT_FALSE(storage.exists());
+
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+    problem_expert.setDeltaTracking(true);
+    ASSERT_TRUE(storage.writeSnapshot(problem_expert.getSnapshot()));
+    ASSERT_TRUE(storage.exists());
+
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+    ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+    ASSERT_TRUE(storage.append(problem_expert.takeDelta()));
+
+    ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+    ASSERT_TRUE(problem_expert.updateFunction(plansys2::Function("(= (speed r2d2) 3.0)")));
+    ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+    ASSERT_TRUE(problem_expert.setGoal(plansys2::Goal("(and (robot_at r2d2 wp2))")));
+    ASSERT_TRUE(storage.append(problem_expert.takeDelta()));
+
+    // Added and removed in the same delta
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp3", "waypoint")));
+    ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp2 wp3)")));
+    ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp3", "waypoint")));
+    ASSERT_TRUE(storage.append(problem_expert.takeDelta()));
+
+    ASSERT_EQ(storage.getLogSize(), 3u);
+  }
+
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  plansys2::KnowledgeStorage storage(dir);
+  ASSERT_TRUE(storage.load(problem_expert));
+  ASSERT_EQ(storage.getLogSize(), 3u);
+
+  ASSERT_EQ(problem_expert.getInstances().size(), 3u);
+  ASSERT_FALSE(problem_expert.getInstance("wp3").has_value());
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_EQ(problem_expert.getFunction("(speed r2d2)").value().value, 3.0);
+  ASSERT_EQ(parser::pddl::toString(problem_expert.getGoal()), "(and (robot_at r2d2 wp2))");
+
+  // Compacting leaves everything in the snapshot
+  ASSERT_TRUE(storage.writeSnapshot(problem_expert.getSnapshot()));
+  ASSERT_EQ(storage.getLogSize(), 0u);
+
+  plansys2::ProblemExpert problem_expert_2(domain_expert);
+  ASSERT_TRUE(storage.load(problem_expert_2));
+  ASSERT_EQ(problem_expert_2.getPredicates().size(), 2u);
+  ASSERT_EQ(problem_expert_2.getFunction("(speed r2d2)").value().value, 3.0);
+}
+
+TEST(knowledge_storage, torn_log)
+{
+  auto domain_expert = getDomainExpert();
+  auto dir = getStorageDir();
+
+  {
+    plansys2::ProblemExpert problem_expert(domain_expert);
+    plansys2::KnowledgeStorage storage(dir, plansys2::KnowledgeStorage::Durability::NONE);
+
+    problem_expert.setDeltaTracking(true);
+    ASSERT_TRUE(storage.writeSnapshot(problem_expert.getSnapshot()));
+
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+    ASSERT_TRUE(storage.append(problem_expert.takeDelta()));
+    ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+    ASSERT_TRUE(storage.append(problem_expert.takeDelta()));
+  }
+
+  // The last record is cut in the middle, as if the process died while writing it
+  auto log_path = std::filesystem::path(dir) / "knowledge.wal";
+  std::filesystem::resize_file(log_path, std::filesystem::file_size(log_path) - 3);
+
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  plansys2::KnowledgeStorage storage(dir);
+  ASSERT_TRUE(storage.load(problem_expert));
+  ASSERT_EQ(storage.getLogSize(), 1u);
+  ASSERT_EQ(problem_expert.getInstances().size(), 1u);
+  ASSERT_TRUE(problem_expert.getInstance("r2d2").has_value());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
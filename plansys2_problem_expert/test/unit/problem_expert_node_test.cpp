@@ -12,10 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <set>
 #include <string>
 #include <vector>
 #include <memory>
 #include <thread>
+#include <tuple>
 
 #include "ament_index_cpp/get_package_share_directory.hpp"
 
@@ -30,8 +34,16 @@
 #include "plansys2_domain_expert/DomainExpertNode.hpp"
 #include "plansys2_problem_expert/ProblemExpertNode.hpp"
 #include "plansys2_problem_expert/ProblemExpertClient.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
 
+#include "plansys2_msgs/msg/goal_status.hpp"
 #include "plansys2_msgs/msg/knowledge.hpp"
+#include "plansys2_msgs/msg/knowledge_delta.hpp"
+#include "plansys2_msgs/msg/watch_event.hpp"
+#include "plansys2_msgs/srv/add_watch.hpp"
+#include "plansys2_msgs/srv/affect_context.hpp"
+#include "plansys2_msgs/srv/evaluate_tree.hpp"
+#include "plansys2_msgs/srv/get_problem_contexts.hpp"
 
 TEST(problem_expert_node, addget_instances)
 {
@@ -691,6 +703,1018 @@ TEST(problem_expert_node, addget_goal_is_satisfied)
   t.join();
 }
 
+TEST(problem_expert_node, update_knowledge)
+{
+  auto test_node = rclcpp::Node::make_shared("test_problem_expert_node");
+  auto test_node_2 = rclcpp::Node::make_shared("test_problem_expert_node_2");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node_2->get_node_base_interface());
+
+  plansys2_msgs::msg::Knowledge last_knowledge_msg;
+  int knowledge_msg_counter = 0;
+  auto knowledge_sub = test_node_2->create_subscription<plansys2_msgs::msg::Knowledge>(
+    "problem_expert/knowledge", rclcpp::QoS(100).transient_local(),
+    [&last_knowledge_msg, &knowledge_msg_counter]
+      (const plansys2_msgs::msg::Knowledge::SharedPtr msg) {
+      last_knowledge_msg = *msg;
+      knowledge_msg_counter++;
+    });
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(
+    problem_client->addInstances(
+      {plansys2::Instance("leia", "robot"),
+        plansys2::Instance("Jack", "person"),
+        plansys2::Instance("bedroom", "room"),
+        plansys2::Instance("kitchen", "room")}));
+  ASSERT_FALSE(problem_client->addInstances({plansys2::Instance("m1", "SCIENTIFIC")}));
+
+  plansys2::KnowledgeUpdate update;
+  update.add_predicates = {
+    plansys2::Predicate("(robot_at leia kitchen)"),
+    plansys2::Predicate("(person_at Jack bedroom)")};
+  update.add_functions = {plansys2::Function("(= (room_distance kitchen bedroom) 2.0)")};
+  ASSERT_TRUE(problem_client->updateKnowledge(update));
+
+  ASSERT_FALSE(
+    problem_client->addPredicates(
+      {plansys2::Predicate("(robot_at leia bedroom)"),
+        plansys2::Predicate("(robot_at leia bathroom)")}));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia bedroom)")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_EQ(knowledge_msg_counter, 2);
+  ASSERT_EQ(last_knowledge_msg.instances.size(), 4u);
+  ASSERT_EQ(last_knowledge_msg.predicates.size(), 2u);
+  ASSERT_EQ(last_knowledge_msg.predicates[0], "(robot_at leia kitchen)");
+  ASSERT_EQ(last_knowledge_msg.predicates[1], "(person_at Jack bedroom)");
+  ASSERT_EQ(last_knowledge_msg.functions.size(), 1u);
+
+  ASSERT_TRUE(problem_client->removeInstances({plansys2::Instance("kitchen", "room")}));
+  ASSERT_EQ(problem_client->getPredicates().size(), 1u);
+  ASSERT_TRUE(problem_client->getFunctions().empty());
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, knowledge_delta)
+{
+  auto test_node = rclcpp::Node::make_shared("test_problem_expert_node");
+  auto test_node_2 = rclcpp::Node::make_shared("test_problem_expert_node_2");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"publish_knowledge", false});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node_2->get_node_base_interface());
+
+  std::vector<plansys2_msgs::msg::KnowledgeDelta> deltas;
+  auto delta_sub = test_node_2->create_subscription<plansys2_msgs::msg::KnowledgeDelta>(
+    "problem_expert/knowledge_delta", rclcpp::QoS(100),
+    [&deltas](const plansys2_msgs::msg::KnowledgeDelta::SharedPtr msg) {
+      deltas.push_back(*msg);
+    });
+
+  int knowledge_msg_counter = 0;
+  auto knowledge_sub = test_node_2->create_subscription<plansys2_msgs::msg::Knowledge>(
+    "problem_expert/knowledge", rclcpp::QoS(100).transient_local(),
+    [&knowledge_msg_counter](const plansys2_msgs::msg::Knowledge::SharedPtr msg) {
+      knowledge_msg_counter++;
+    });
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("leia", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_TRUE(problem_client->removeInstance(plansys2::Instance("kitchen", "room")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_EQ(knowledge_msg_counter, 0);
+  ASSERT_EQ(deltas.size(), 4u);
+  for (size_t i = 1; i < deltas.size(); i++) {
+    ASSERT_EQ(deltas[i].base_revision, deltas[i - 1].revision);
+  }
+  ASSERT_EQ(deltas[2].added_predicates.size(), 1u);
+  ASSERT_EQ(deltas[3].removed_instances.size(), 1u);
+  ASSERT_EQ(deltas[3].removed_predicates.size(), 1u);
+
+  auto snapshot_client =
+    test_node->create_client<plansys2_msgs::srv::GetKnowledgeSnapshot>(
+    "problem_expert/get_knowledge_snapshot");
+  auto future_result = snapshot_client->async_send_request(
+    std::make_shared<plansys2_msgs::srv::GetKnowledgeSnapshot::Request>());
+  ASSERT_EQ(
+    rclcpp::spin_until_future_complete(test_node, future_result, std::chrono::seconds(1)),
+    rclcpp::FutureReturnCode::SUCCESS);
+
+  auto snapshot = future_result.get()->snapshot;
+  ASSERT_TRUE(snapshot.reset);
+  ASSERT_EQ(snapshot.revision, deltas.back().revision);
+  ASSERT_EQ(snapshot.added_instances.size(), 1u);
+  ASSERT_TRUE(snapshot.added_predicates.empty());
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, conditional_fetch)
+{
+  auto test_node = rclcpp::Node::make_shared("test_problem_expert_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("leia", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+
+  auto predicates_client = test_node->create_client<plansys2_msgs::srv::GetStates>(
+    "problem_expert/get_problem_predicates");
+
+  auto get_predicates = [&](uint64_t if_newer_than) {
+      auto request = std::make_shared<plansys2_msgs::srv::GetStates::Request>();
+      request->if_newer_than = if_newer_than;
+      auto future_result = predicates_client->async_send_request(request);
+      EXPECT_EQ(
+        rclcpp::spin_until_future_complete(test_node, future_result, std::chrono::seconds(1)),
+        rclcpp::FutureReturnCode::SUCCESS);
+      return future_result.get();
+    };
+
+  auto response = get_predicates(0);
+  ASSERT_TRUE(response->success);
+  ASSERT_FALSE(response->unchanged);
+  ASSERT_EQ(response->states.size(), 1u);
+  auto revision = response->revision;
+
+  response = get_predicates(revision);
+  ASSERT_TRUE(response->success);
+  ASSERT_TRUE(response->unchanged);
+  ASSERT_TRUE(response->states.empty());
+  ASSERT_EQ(response->revision, revision);
+
+  ASSERT_TRUE(problem_client->removePredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+
+  response = get_predicates(revision);
+  ASSERT_FALSE(response->unchanged);
+  ASSERT_TRUE(response->states.empty());
+  ASSERT_GT(response->revision, revision);
+
+  // The client reuses its last result when the revision has not changed
+  ASSERT_TRUE(problem_client->getPredicates().empty());
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_EQ(problem_client->getPredicates().size(), 1u);
+  ASSERT_EQ(problem_client->getPredicates().size(), 1u);
+  auto problem = problem_client->getProblem();
+  ASSERT_FALSE(problem.empty());
+  ASSERT_EQ(problem_client->getProblem(), problem);
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, query_predicates)
+{
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  plansys2::KnowledgeUpdate update;
+  update.add_instances = {
+    plansys2::Instance("leia", "robot"), plansys2::Instance("r2d2", "robot"),
+    plansys2::Instance("kitchen", "room"), plansys2::Instance("bedroom", "room")};
+  update.add_predicates = {
+    plansys2::Predicate("(robot_at leia kitchen)"),
+    plansys2::Predicate("(robot_at r2d2 kitchen)"),
+    plansys2::Predicate("(is_teleporter_destination bedroom)")};
+  ASSERT_TRUE(problem_client->updateKnowledge(update));
+
+  std::size_t total;
+  auto matches = problem_client->queryPredicates(
+    plansys2::Predicate("(robot_at ?r kitchen)"), 0, 0, &total);
+  ASSERT_EQ(matches.size(), 2u);
+  ASSERT_EQ(total, 2u);
+  ASSERT_EQ(matches[0].name, "robot_at");
+  ASSERT_EQ(matches[0].parameters[1].name, "kitchen");
+
+  matches = problem_client->queryPredicates(
+    plansys2::Predicate("(robot_at ?r kitchen)"), 1, 1, &total);
+  ASSERT_EQ(matches.size(), 1u);
+  ASSERT_EQ(total, 2u);
+
+  ASSERT_EQ(
+    problem_client->queryPredicates(plansys2::Predicate("(robot_at leia ?room)")).size(), 1u);
+  ASSERT_TRUE(
+    problem_client->queryPredicates(plansys2::Predicate("(robot_at leia bedroom)")).empty());
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, evaluate_and_apply)
+{
+  auto test_node = rclcpp::Node::make_shared("test_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node);
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  plansys2::KnowledgeUpdate update;
+  update.add_instances = {
+    plansys2::Instance("leia", "robot"),
+    plansys2::Instance("kitchen", "room"), plansys2::Instance("bedroom", "room")};
+  update.add_predicates = {plansys2::Predicate("(robot_at leia kitchen)")};
+  update.add_functions = {plansys2::Function("(= (room_distance kitchen bedroom) 2.0)")};
+  ASSERT_TRUE(problem_client->updateKnowledge(update));
+
+  auto requirement = parser::pddl::fromString(
+    "(and (robot_at leia kitchen) (not (robot_at leia bedroom)) "
+    "(> (room_distance kitchen bedroom) 1))");
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at leia kitchen)) (robot_at leia bedroom) "
+    "(increase (room_distance kitchen bedroom) 3))");
+
+  ASSERT_TRUE(plansys2::check(requirement, problem_client));
+  ASSERT_TRUE(plansys2::check(requirement, problem_client, 1));
+  ASSERT_EQ(
+    problem_client->evaluate(parser::pddl::fromString("(* (room_distance kitchen bedroom) 3)")),
+    std::make_tuple(true, false, 6.0));
+
+  ASSERT_TRUE(plansys2::apply(effect, problem_client));
+  ASSERT_FALSE(plansys2::check(requirement, problem_client));
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia bedroom)")));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  auto distance = problem_client->getFunction("(room_distance kitchen bedroom)");
+  ASSERT_TRUE(distance.has_value());
+  ASSERT_DOUBLE_EQ(distance.value().value, 5.0);
+
+  // Effects on functions that do not exist fail, and the rest of the effect is not applied
+  ASSERT_FALSE(
+    plansys2::apply(
+      parser::pddl::fromString(
+        "(and (robot_at leia kitchen) (increase (room_distance bedroom kitchen) 1))"),
+      problem_client));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+
+  // Trees with nodes out of range, or without the children of their type, are rejected
+  // before any of their nodes is read
+  auto evaluate_client = test_node->create_client<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/evaluate");
+  auto apply_client = test_node->create_client<plansys2_msgs::srv::EvaluateTree>(
+    "problem_expert/apply");
+  ASSERT_TRUE(evaluate_client->wait_for_service(std::chrono::seconds(5)));
+  ASSERT_TRUE(apply_client->wait_for_service(std::chrono::seconds(5)));
+
+  auto valid_tree = parser::pddl::fromString(
+    "(and (robot_at leia kitchen) (not (robot_at leia bedroom)))");
+  std::vector<plansys2_msgs::msg::Tree> invalid_trees(3, valid_tree);
+  invalid_trees[0].nodes[0].children.push_back(42);
+  invalid_trees[1].nodes[2].children.clear();
+  invalid_trees[2].nodes[2].children = {0};
+
+  for (auto client : {evaluate_client, apply_client}) {
+    for (const auto & tree : invalid_trees) {
+      auto request = std::make_shared<plansys2_msgs::srv::EvaluateTree::Request>();
+      request->tree = tree;
+      auto response = client->async_send_request(request).get();
+      ASSERT_FALSE(response->success);
+      ASSERT_FALSE(response->error_info.empty());
+    }
+
+    auto request = std::make_shared<plansys2_msgs::srv::EvaluateTree::Request>();
+    request->tree = valid_tree;
+    request->node_id = valid_tree.nodes.size();
+    auto response = client->async_send_request(request).get();
+    ASSERT_FALSE(response->success);
+    ASSERT_FALSE(response->error_info.empty());
+  }
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia bedroom)")));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, watches)
+{
+  auto test_node = rclcpp::Node::make_shared("test_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"watch_expiration_period", 0.1});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node);
+
+  std::vector<plansys2_msgs::msg::WatchEvent> events;
+  auto watch_sub = test_node->create_subscription<plansys2_msgs::msg::WatchEvent>(
+    "problem_expert/watch_events", rclcpp::QoS(100),
+    [&events](const plansys2_msgs::msg::WatchEvent::SharedPtr msg) {
+      events.push_back(*msg);
+    });
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("bedroom", "room")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+
+  plansys2_msgs::msg::Tree condition;
+  parser::pddl::fromString(condition, "(and (robot_at r2d2 bedroom))");
+  bool value = true;
+  auto id = problem_client->addWatch(condition, &value);
+  ASSERT_TRUE(id.has_value());
+  ASSERT_FALSE(value);
+
+  ASSERT_TRUE(problem_client->removePredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 bedroom)")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_EQ(events.size(), 1u);
+  ASSERT_EQ(events[0].id, id.value());
+  ASSERT_TRUE(events[0].value);
+
+  ASSERT_TRUE(problem_client->removeWatch(id.value()));
+  ASSERT_FALSE(problem_client->removeWatch(id.value()));
+
+  // The watches of a node that is not in the graph, as a crashed one, are removed. The ones
+  // of the client are kept while its node lives
+  auto add_watch_client = test_node->create_client<plansys2_msgs::srv::AddWatch>(
+    "problem_expert/add_watch");
+  auto request = std::make_shared<plansys2_msgs::srv::AddWatch::Request>();
+  request->condition = condition;
+  request->owner = "/crashed_monitor";
+  ASSERT_TRUE(add_watch_client->wait_for_service(std::chrono::seconds(5)));
+  auto orphan_id = add_watch_client->async_send_request(request).get()->id;
+  id = problem_client->addWatch(condition);
+  ASSERT_TRUE(id.has_value());
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_FALSE(problem_client->removeWatch(orphan_id));
+  ASSERT_TRUE(problem_client->removeWatch(id.value()));
+
+  // Each client owns its watches, so when one of two clients dies only its watches are
+  // removed
+  auto problem_client_2 = std::make_shared<plansys2::ProblemExpertClient>();
+  id = problem_client->addWatch(condition);
+  auto id_2 = problem_client_2->addWatch(condition);
+  ASSERT_TRUE(id.has_value());
+  ASSERT_TRUE(id_2.has_value());
+  problem_client_2.reset();
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 1.0) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_FALSE(problem_client->removeWatch(id_2.value()));
+  ASSERT_TRUE(problem_client->removeWatch(id.value()));
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, applicable_actions)
+{
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->getApplicableActions().empty());
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(
+    problem_client->addInstance(plansys2::Instance("bedroom", "room_with_teleporter")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+
+  auto actions = problem_client->getApplicableActions();
+  std::sort(actions.begin(), actions.end());
+  std::vector<std::string> expected {"(move r2d2 kitchen bedroom)", "(move r2d2 kitchen kitchen)"};
+  ASSERT_EQ(actions, expected);
+
+  // The tracker of the context is updated by each change from then on
+  ASSERT_TRUE(problem_client->removePredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 bedroom)")));
+
+  actions = problem_client->getApplicableActions();
+  std::sort(actions.begin(), actions.end());
+  expected = {"(move r2d2 bedroom bedroom)", "(move r2d2 bedroom kitchen)"};
+  ASSERT_EQ(actions, expected);
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, function_updates)
+{
+  auto test_node = rclcpp::Node::make_shared("test_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_charging.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_charging.pddl"});
+  problem_node->set_parameter({"function_updates_period", 0.2});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node);
+
+  int delta_counter = 0;
+  auto delta_sub = test_node->create_subscription<plansys2_msgs::msg::KnowledgeDelta>(
+    "problem_expert/knowledge_delta", rclcpp::QoS(100),
+    [&delta_counter](const plansys2_msgs::msg::KnowledgeDelta::SharedPtr msg) {
+      delta_counter++;
+    });
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_client->addFunction(plansys2::Function("(= (state_of_charge r2d2) 100)")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+  delta_counter = 0;
+
+  // Values sent in the same period are coalesced in a single update with the last one
+  for (int i = 99; i >= 90; i--) {
+    problem_client->publishFunctions(
+      {plansys2::Function("(= (state_of_charge r2d2) " + std::to_string(i) + ")")});
+  }
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_LE(delta_counter, 2);
+  ASSERT_EQ(problem_client->getFunction("(state_of_charge r2d2)").value().value, 90.0);
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, goal_status)
+{
+  auto test_node = rclcpp::Node::make_shared("test_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node);
+
+  plansys2_msgs::msg::GoalStatus last_status;
+  int status_counter = 0;
+  auto status_sub = test_node->create_subscription<plansys2_msgs::msg::GoalStatus>(
+    "problem_expert/goal_status", rclcpp::QoS(1).transient_local(),
+    [&last_status, &status_counter](const plansys2_msgs::msg::GoalStatus::SharedPtr msg) {
+      last_status = *msg;
+      status_counter++;
+    });
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("bedroom", "room")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_TRUE(
+    problem_client->setGoal(
+      plansys2::Goal("(and (robot_at r2d2 kitchen) (is_teleporter_destination bedroom))")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_FALSE(last_status.satisfied);
+  ASSERT_EQ(last_status.satisfied_subgoals.size(), 1u);
+  ASSERT_EQ(last_status.unsatisfied_subgoals.size(), 1u);
+  auto counter = status_counter;
+
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("bathroom", "room")));
+  ASSERT_TRUE(
+    problem_client->addPredicate(plansys2::Predicate("(is_teleporter_destination bedroom)")));
+
+  {
+    rclcpp::Rate rate(10);
+    auto start = test_node->now();
+    while ((test_node->now() - start).seconds() < 0.5) {
+      rate.sleep();
+    }
+  }
+
+  ASSERT_EQ(status_counter, counter + 1);
+  ASSERT_TRUE(last_status.satisfied);
+  ASSERT_EQ(last_status.satisfied_subgoals.size(), 2u);
+  ASSERT_TRUE(problem_client->isGoalSatisfied(problem_client->getGoal()));
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, cached_client)
+{
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>(true);
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  // Reads after writes of the same client see them, from the replica or from the server
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("leia", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_EQ(problem_client->getInstances().size(), 2u);
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_TRUE(problem_client->removeInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_TRUE(problem_client->getInstance("leia").has_value());
+  ASSERT_FALSE(problem_client->getInstance("kitchen").has_value());
+
+  // Changes from other clients reach the replica
+  auto problem_client_2 = std::make_shared<plansys2::ProblemExpertClient>();
+  ASSERT_TRUE(problem_client_2->addInstance(plansys2::Instance("bedroom", "room")));
+  {
+    rclcpp::Rate rate(10);
+    auto start = std::chrono::steady_clock::now();
+    while (problem_client->getInstances().size() != 2u &&
+      std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+    {
+      rate.sleep();
+    }
+  }
+  ASSERT_TRUE(problem_client->getInstance("bedroom").has_value());
+
+  // Expressions are evaluated on the replica, and see the effects applied by the client
+  auto requirement = parser::pddl::fromString("(and (robot_at leia bedroom))");
+  ASSERT_FALSE(plansys2::check(requirement, problem_client));
+  ASSERT_TRUE(plansys2::apply(requirement, problem_client));
+  ASSERT_TRUE(plansys2::check(requirement, problem_client));
+  ASSERT_EQ(
+    problem_client->evaluate(parser::pddl::fromString("(robot_at leia kitchen)")),
+    std::make_tuple(true, false, 0.0));
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, contexts)
+{
+  auto test_node = rclcpp::Node::make_shared("test_node");
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+  auto what_if_client = std::make_shared<plansys2::ProblemExpertClient>(
+    false, std::chrono::milliseconds(100), "what_if");
+  auto cached_what_if_client = std::make_shared<plansys2::ProblemExpertClient>(
+    true, std::chrono::milliseconds(100), "what_if");
+  auto other_client = std::make_shared<plansys2::ProblemExpertClient>(
+    false, std::chrono::milliseconds(100), "other");
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"contexts", std::vector<std::string>{"what_if"}});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+  exe.add_node(test_node);
+
+  auto add_context_client = test_node->create_client<plansys2_msgs::srv::AffectContext>(
+    "problem_expert/add_problem_context");
+  auto remove_context_client = test_node->create_client<plansys2_msgs::srv::AffectContext>(
+    "problem_expert/remove_problem_context");
+  auto get_contexts_client = test_node->create_client<plansys2_msgs::srv::GetProblemContexts>(
+    "problem_expert/get_problem_contexts");
+
+  bool finish = false;
+  std::thread t([&]() {
+      while (!finish) {exe.spin_some();}
+    });
+
+  // Each context has its own knowledge
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_TRUE(what_if_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(what_if_client->addInstance(plansys2::Instance("bedroom", "room")));
+  ASSERT_TRUE(what_if_client->addPredicate(plansys2::Predicate("(robot_at r2d2 bedroom)")));
+  ASSERT_FALSE(what_if_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+
+  ASSERT_EQ(problem_client->getInstances().size(), 2u);
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_FALSE(problem_client->existPredicate(plansys2::Predicate("(robot_at r2d2 bedroom)")));
+  ASSERT_TRUE(what_if_client->existPredicate(plansys2::Predicate("(robot_at r2d2 bedroom)")));
+  ASSERT_FALSE(what_if_client->existPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+
+  ASSERT_TRUE(what_if_client->setGoal(plansys2::Goal("(and (robot_at r2d2 bedroom))")));
+  ASSERT_TRUE(what_if_client->isGoalSatisfied(what_if_client->getGoal()));
+  ASSERT_EQ(parser::pddl::toString(problem_client->getGoal()), "");
+
+  // The replica of a cached client only follows its context
+  {
+    rclcpp::Rate rate(10);
+    auto start = std::chrono::steady_clock::now();
+    while (!cached_what_if_client->getInstance("bedroom").has_value() &&
+      std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+    {
+      rate.sleep();
+    }
+  }
+  ASSERT_TRUE(cached_what_if_client->getInstance("bedroom").has_value());
+  ASSERT_FALSE(cached_what_if_client->getInstance("kitchen").has_value());
+
+  // Contexts can be added and removed, except the default one
+  ASSERT_FALSE(other_client->addInstance(plansys2::Instance("r2d2", "robot")));
+
+  auto request = std::make_shared<plansys2_msgs::srv::AffectContext::Request>();
+  request->context = "other";
+  ASSERT_TRUE(add_context_client->wait_for_service(std::chrono::seconds(5)));
+  ASSERT_TRUE(add_context_client->async_send_request(request).get()->success);
+  ASSERT_FALSE(add_context_client->async_send_request(request).get()->success);
+  ASSERT_TRUE(other_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(other_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(other_client->addPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+  ASSERT_EQ(other_client->getInstances().size(), 2u);
+  ASSERT_EQ(other_client->getPredicates().size(), 1u);
+
+  auto contexts_request = std::make_shared<plansys2_msgs::srv::GetProblemContexts::Request>();
+  ASSERT_TRUE(get_contexts_client->wait_for_service(std::chrono::seconds(5)));
+  auto contexts = get_contexts_client->async_send_request(contexts_request).get()->contexts;
+  ASSERT_EQ(contexts, std::vector<std::string>({"", "other", "what_if"}));
+
+  ASSERT_TRUE(remove_context_client->wait_for_service(std::chrono::seconds(5)));
+  ASSERT_TRUE(remove_context_client->async_send_request(request).get()->success);
+  ASSERT_FALSE(other_client->addInstance(plansys2::Instance("c3po", "robot")));
+  request->context = "";
+  ASSERT_FALSE(remove_context_client->async_send_request(request).get()->success);
+  ASSERT_EQ(problem_client->getInstances().size(), 2u);
+
+  // A context added again starts from scratch, at the revision where the removed one got
+  // its predicate. The results of the removed one are not served for it
+  request->context = "other";
+  ASSERT_TRUE(add_context_client->async_send_request(request).get()->success);
+  ASSERT_TRUE(other_client->addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(other_client->addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(other_client->addInstance(plansys2::Instance("bedroom", "room")));
+  ASSERT_TRUE(other_client->getPredicates().empty());
+
+  finish = true;
+  t.join();
+}
+
+TEST(problem_expert_node, concurrent_queries)
+{
+  auto domain_node = std::make_shared<plansys2::DomainExpertNode>();
+  auto problem_node = std::make_shared<plansys2::ProblemExpertNode>();
+  auto problem_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+
+  domain_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+  problem_node->set_parameter({"model_file", pkgpath + "/pddl/domain_simple.pddl"});
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_CONFIGURE);
+
+  domain_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+  problem_node->trigger_transition(lifecycle_msgs::msg::Transition::TRANSITION_ACTIVATE);
+
+  rclcpp::executors::MultiThreadedExecutor exe(rclcpp::ExecutorOptions(), 8);
+
+  exe.add_node(domain_node->get_node_base_interface());
+  exe.add_node(problem_node->get_node_base_interface());
+
+  // spin() runs the callbacks in the threads of the executor, so the queries are served at
+  // the same time, while a loop of spin_some() would serve them one by one
+  std::thread t([&]() {exe.spin();});
+
+  plansys2::KnowledgeUpdate update;
+  update.add_instances = {
+    plansys2::Instance("leia", "robot"), plansys2::Instance("r2d2", "robot"),
+    plansys2::Instance("paco", "person"),
+    plansys2::Instance("kitchen", "room"), plansys2::Instance("bedroom", "room")};
+  update.add_predicates = {
+    plansys2::Predicate("(person_at paco kitchen)"),
+    plansys2::Predicate("(robot_at leia kitchen)"), plansys2::Predicate("(robot_at r2d2 kitchen)")};
+  ASSERT_TRUE(problem_client->updateKnowledge(update));
+
+  // Each thread has its own client, as a client is not thread safe. The writer moves both
+  // robots in each update, so the readers must see them in the same room, as the updates
+  // are never seen half applied
+  const int readers_count = 4;
+  std::vector<std::shared_ptr<plansys2::ProblemExpertClient>> reader_clients;
+  for (int i = 0; i < readers_count; i++) {
+    reader_clients.push_back(std::make_shared<plansys2::ProblemExpertClient>());
+  }
+  auto writer_client = std::make_shared<plansys2::ProblemExpertClient>();
+
+  std::atomic<bool> writing {true};
+  std::atomic<int> failures {0};
+  std::atomic<int> queries {0};
+  std::vector<std::thread> readers;
+  for (const auto & client : reader_clients) {
+    readers.emplace_back(
+      [&, client]() {
+        do {
+          if (!client->existPredicate(plansys2::Predicate("(person_at paco kitchen)"))) {
+            failures++;
+          }
+          std::set<std::string> rooms;
+          auto predicates = client->getPredicates();
+          for (const auto & predicate : predicates) {
+            if (predicate.name == "robot_at") {
+              rooms.insert(predicate.parameters[1].name);
+            }
+          }
+          if (predicates.size() != 3u || rooms.size() != 1u) {
+            failures++;
+          }
+          queries += 2;
+        } while (writing);
+      });
+  }
+
+  std::thread writer([&]() {
+      std::vector<std::string> rooms {"kitchen", "bedroom"};
+      for (int i = 0; i < 100; i++) {
+        const auto & from = rooms[i % 2];
+        const auto & to = rooms[(i + 1) % 2];
+        plansys2::KnowledgeUpdate move;
+        move.remove_predicates = {
+          plansys2::Predicate("(robot_at leia " + from + ")"),
+          plansys2::Predicate("(robot_at r2d2 " + from + ")")};
+        move.add_predicates = {
+          plansys2::Predicate("(robot_at leia " + to + ")"),
+          plansys2::Predicate("(robot_at r2d2 " + to + ")")};
+        if (!writer_client->updateKnowledge(move)) {
+          failures++;
+        }
+      }
+      writing = false;
+    });
+
+  writer.join();
+  for (auto & reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_EQ(failures, 0);
+  ASSERT_GE(queries, 2 * readers_count);
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+  ASSERT_TRUE(problem_client->existPredicate(plansys2::Predicate("(robot_at r2d2 kitchen)")));
+
+  exe.cancel();
+  t.join();
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -12,9 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
+#include <shared_mutex>
+#include <thread>
 
 #include "ament_index_cpp/get_package_share_directory.hpp"
 
@@ -405,6 +410,12 @@ TEST(problem_expert, addget_functions)
   functions = problem_expert.getFunctions();
   ASSERT_EQ(functions.size(), 2);
 
+  // An update to the value a function already has does not move it to the end
+  ASSERT_TRUE(problem_expert.updateFunction(function_1));
+  functions = problem_expert.getFunctions();
+  ASSERT_EQ(functions[0].name, "speed");
+  ASSERT_EQ(functions[1].name, "distance");
+
   auto func_2 = problem_expert.getFunction("(distance wp1 wp2)");
   ASSERT_TRUE(func_2);
   ASSERT_EQ(func_2.value().name, "distance");
@@ -422,6 +433,239 @@ TEST(problem_expert, addget_functions)
   ASSERT_EQ(functions.size(), 1);
 }
 
+TEST(problem_expert, remove_instance_cascade)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(parser::pddl::fromStringParam("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(parser::pddl::fromStringParam("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(parser::pddl::fromStringParam("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(parser::pddl::fromStringParam("wp3", "waypoint")));
+
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp2 wp3)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp1)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (distance wp1 wp2) 3.0)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (distance wp2 wp3) 5.0)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+
+  ASSERT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.removeInstance(parser::pddl::fromStringParam("wp1", "waypoint")));
+
+  auto predicates = problem_expert.getPredicates();
+  ASSERT_EQ(predicates.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(predicates[0]), "(connected wp2 wp3)");
+
+  auto functions = problem_expert.getFunctions();
+  ASSERT_EQ(functions.size(), 2u);
+  ASSERT_EQ(parser::pddl::toString(functions[0]), "(distance wp2 wp3)");
+  ASSERT_EQ(parser::pddl::toString(functions[1]), "(speed r2d2)");
+
+  ASSERT_TRUE(problem_expert.addInstance(parser::pddl::fromStringParam("wp1", "waypoint")));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+
+  ASSERT_TRUE(problem_expert.removeInstance(parser::pddl::fromStringParam("r2d2", "robot")));
+  predicates = problem_expert.getPredicates();
+  ASSERT_EQ(predicates.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(predicates[0]), "(connected wp2 wp3)");
+  functions = problem_expert.getFunctions();
+  ASSERT_EQ(functions.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(functions[0]), "(distance wp2 wp3)");
+}
+
+TEST(problem_expert, update_knowledge)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  plansys2::KnowledgeUpdate update;
+  update.add_instances = {
+    plansys2::Instance("r2d2", "robot"),
+    plansys2::Instance("wp1", "waypoint"),
+    plansys2::Instance("wp2", "waypoint")};
+  update.add_predicates = {
+    plansys2::Predicate("(robot_at r2d2 wp1)"),
+    plansys2::Predicate("(connected wp1 wp2)")};
+  update.add_functions = {plansys2::Function("(= (distance wp1 wp2) 3.0)")};
+
+  ASSERT_TRUE(problem_expert.updateKnowledge(update));
+  ASSERT_EQ(problem_expert.getInstances().size(), 3u);
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_EQ(problem_expert.getFunctions().size(), 1u);
+
+  // The last predicate refers to an unknown instance, so nothing is applied
+  plansys2::KnowledgeUpdate wrong_update;
+  wrong_update.add_instances = {plansys2::Instance("wp3", "waypoint")};
+  wrong_update.remove_predicates = {plansys2::Predicate("(robot_at r2d2 wp1)")};
+  wrong_update.add_predicates = {
+    plansys2::Predicate("(robot_at r2d2 wp3)"),
+    plansys2::Predicate("(connected wp3 wp4)")};
+
+  ASSERT_FALSE(problem_expert.updateKnowledge(wrong_update));
+  ASSERT_FALSE(problem_expert.existInstance("wp3"));
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp3)")));
+
+  wrong_update.add_predicates.pop_back();
+  ASSERT_TRUE(problem_expert.updateKnowledge(wrong_update));
+  ASSERT_TRUE(problem_expert.existInstance("wp3"));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp3)")));
+
+  // Facts can not refer to instances removed in the same update
+  plansys2::KnowledgeUpdate remove_update;
+  remove_update.remove_instances = {plansys2::Instance("wp2", "waypoint")};
+  remove_update.add_predicates = {plansys2::Predicate("(connected wp2 wp3)")};
+  ASSERT_FALSE(problem_expert.updateKnowledge(remove_update));
+  ASSERT_TRUE(problem_expert.existInstance("wp2"));
+
+  remove_update.add_predicates.clear();
+  ASSERT_TRUE(problem_expert.updateKnowledge(remove_update));
+  ASSERT_FALSE(problem_expert.existInstance("wp2"));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.getFunctions().empty());
+
+  // Removing an instance that does not exist, or adding an existing one, fails
+  ASSERT_FALSE(problem_expert.updateKnowledge(remove_update));
+  plansys2::KnowledgeUpdate add_update;
+  add_update.add_instances = {plansys2::Instance("wp1", "waypoint")};
+  ASSERT_FALSE(problem_expert.updateKnowledge(add_update));
+}
+
+TEST(problem_expert, apply_effect)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (state_of_charge r2d2) 10)")));
+
+  plansys2_msgs::msg::Tree effect;
+  parser::pddl::fromString(
+    effect, "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) "
+    "(decrease (state_of_charge r2d2) 4))");
+  auto revision = problem_expert.getRevision();
+  ASSERT_TRUE(std::get<0>(problem_expert.applyEffect(effect)));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_EQ(problem_expert.getFunction("(state_of_charge r2d2)").value().value, 6.0);
+  ASSERT_GT(problem_expert.getRevision(), revision);
+
+  // The last change refers to an unknown instance, so none of them is applied
+  plansys2_msgs::msg::Tree wrong_effect;
+  parser::pddl::fromString(
+    wrong_effect, "(and (not (robot_at r2d2 wp2)) (robot_at r2d2 wp1) "
+    "(decrease (state_of_charge r2d2) 4) (patrolled wp3))");
+  revision = problem_expert.getRevision();
+  ASSERT_FALSE(std::get<0>(problem_expert.applyEffect(wrong_effect)));
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_EQ(problem_expert.getFunction("(state_of_charge r2d2)").value().value, 6.0);
+  ASSERT_EQ(problem_expert.getRevision(), revision);
+
+  // So it is if a function to change does not exist
+  parser::pddl::fromString(
+    wrong_effect, "(and (robot_at r2d2 wp1) (increase (speed r2d2) 1))");
+  ASSERT_FALSE(std::get<0>(problem_expert.applyEffect(wrong_effect)));
+  ASSERT_FALSE(problem_expert.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_EQ(problem_expert.getRevision(), revision);
+}
+
+TEST(problem_expert, knowledge_delta)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_EQ(problem_expert.getRevision(), 1u);
+
+  problem_expert.setDeltaTracking(true);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 2.0)")));
+  ASSERT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+
+  auto delta = problem_expert.takeDelta();
+  ASSERT_EQ(delta.base_revision, 1u);
+  ASSERT_EQ(delta.revision, problem_expert.getRevision());
+  ASSERT_FALSE(delta.reset);
+  ASSERT_EQ(delta.added_instances.size(), 2u);
+  ASSERT_EQ(delta.added_predicates.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(delta.added_predicates[0]), "(connected wp1 wp2)");
+  ASSERT_EQ(delta.removed_predicates.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(delta.removed_predicates[0]), "(robot_at r2d2 wp1)");
+  ASSERT_EQ(delta.added_functions.size(), 1u);
+  ASSERT_EQ(delta.added_functions[0].value, 2.0);
+  ASSERT_FALSE(delta.goal_changed);
+
+  // Nothing changes, so the revision does not change either
+  auto revision = problem_expert.getRevision();
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 2.0)")));
+  delta = problem_expert.takeDelta();
+  ASSERT_EQ(delta.base_revision, revision);
+  ASSERT_EQ(delta.revision, revision);
+
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.setGoal(plansys2::Goal("(and (robot_at r2d2 wp1))")));
+  delta = problem_expert.takeDelta();
+  ASSERT_EQ(delta.base_revision, revision);
+  ASSERT_EQ(delta.removed_instances.size(), 1u);
+  ASSERT_EQ(delta.removed_instances[0].name, "wp2");
+  ASSERT_EQ(delta.removed_predicates.size(), 1u);
+  ASSERT_EQ(parser::pddl::toString(delta.removed_predicates[0]), "(connected wp1 wp2)");
+  ASSERT_TRUE(delta.goal_changed);
+  ASSERT_EQ(parser::pddl::toString(delta.goal), "(and (robot_at r2d2 wp1))");
+
+  ASSERT_TRUE(problem_expert.clearKnowledge());
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  delta = problem_expert.takeDelta();
+  ASSERT_TRUE(delta.reset);
+  ASSERT_EQ(delta.added_instances.size(), 1u);
+  ASSERT_TRUE(delta.removed_instances.empty());
+
+  auto snapshot = problem_expert.getSnapshot();
+  ASSERT_TRUE(snapshot.reset);
+  ASSERT_EQ(snapshot.revision, problem_expert.getRevision());
+  ASSERT_EQ(snapshot.added_instances.size(), 1u);
+  ASSERT_TRUE(snapshot.goal_changed);
+}
+
 TEST(problem_expert, addget_goals)
 {
   std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
@@ -550,6 +794,62 @@ TEST(problem_expert, get_problem)
   ASSERT_EQ(problem_expert.getInstances().size(), 0);
 }
 
+TEST(problem_expert, get_problem_incremental)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+
+  // The problem of an expert queried after every change has to be the same as the one of
+  // an expert queried only at the end
+  plansys2::ProblemExpert queried(domain_expert);
+  std::vector<std::function<bool(plansys2::ProblemExpert &)>> changes {
+    [](auto & pe) {return pe.addInstance(plansys2::Instance("r2d2", "robot"));},
+    [](auto & pe) {return pe.addInstance(plansys2::Instance("wp1", "waypoint"));},
+    [](auto & pe) {return pe.addInstance(plansys2::Instance("wp2", "waypoint"));},
+    [](auto & pe) {return pe.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)"));},
+    [](auto & pe) {return pe.addPredicate(plansys2::Predicate("(connected wp1 wp2)"));},
+    [](auto & pe) {return pe.addPredicate(plansys2::Predicate("(connected wp2 wp1)"));},
+    [](auto & pe) {return pe.removePredicate(plansys2::Predicate("(connected wp1 wp2)"));},
+    [](auto & pe) {return pe.addFunction(plansys2::Function("(= (speed r2d2) 1.0)"));},
+    [](auto & pe) {return pe.addFunction(plansys2::Function("(= (distance wp1 wp2) 5.5)"));},
+    [](auto & pe) {return pe.updateFunction(plansys2::Function("(= (speed r2d2) 2.5)"));},
+    [](auto & pe) {return pe.setGoal(plansys2::Goal("(and (robot_at r2d2 wp2))"));},
+    [](auto & pe) {return pe.addInstance(plansys2::Instance("wp3", "waypoint"));},
+    [](auto & pe) {return pe.addPredicate(plansys2::Predicate("(patrolled wp3)"));},
+    [](auto & pe) {return pe.removeInstance(plansys2::Instance("wp2", "waypoint"));},
+    [](auto & pe) {return pe.addPredicate(plansys2::Predicate("(patrolled wp1)"));},
+  };
+
+  for (size_t i = 0; i < changes.size(); i++) {
+    ASSERT_TRUE(changes[i](queried));
+
+    plansys2::ProblemExpert reference(domain_expert);
+    for (size_t j = 0; j <= i; j++) {
+      ASSERT_TRUE(changes[j](reference));
+    }
+    ASSERT_EQ(queried.getProblem(), reference.getProblem());
+  }
+
+  ASSERT_EQ(
+    queried.getProblem(),
+    std::string("( define ( problem problem_1 )\n( :domain plansys2 )\n") +
+    std::string("( :objects\n\tr2d2 - robot\n\twp1 wp3 - waypoint\n)\n") +
+    std::string("( :init\n\t( robot_at r2d2 wp1 )\n\t( patrolled wp3 )\n") +
+    std::string("\t( patrolled wp1 )\n\t( = ( speed r2d2 ) 2.5 )\n)\n") +
+    std::string("( :goal\n\t( and\n\t\t( robot_at r2d2 wp2 )\n\t)\n)\n)\n"));
+
+  ASSERT_TRUE(queried.clearKnowledge());
+  ASSERT_EQ(
+    queried.getProblem(),
+    std::string("( define ( problem problem_1 )\n( :domain plansys2 )\n( :objects\n)\n") +
+    std::string("( :init\n)\n( :goal\n\t( and\n\t\t( robot_at r2d2 wp2 )\n\t)\n)\n)\n"));
+}
+
 TEST(problem_expert, add_problem)
 {
   std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
@@ -635,6 +935,69 @@ TEST(problem_expert, add_problem)
   ASSERT_EQ(problem_expert.getInstances().size(), 0);
 }
 
+TEST(problem_expert, add_problem_existing_and_repeated)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_simple.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("leia", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("kitchen", "room")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at leia kitchen)")));
+
+  // Existing instances and facts are skipped, and repeated facts added once
+  ASSERT_TRUE(
+    problem_expert.addProblem(
+      "( define ( problem problem_1 )\n( :domain simple )\n"
+      "( :objects leia - robot kitchen bedroom - room )\n"
+      "( :init ( robot_at leia kitchen ) ( robot_at leia bedroom ) ( robot_at leia bedroom )\n"
+      "( = ( room_distance kitchen bedroom ) 10 ) ( = ( room_distance kitchen bedroom ) 20 ) )\n"
+      "( :goal ( and ( robot_at leia bedroom ) ) )\n)\n"));
+
+  ASSERT_EQ(problem_expert.getInstances().size(), 3u);
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_TRUE(
+    problem_expert.existPredicate(plansys2::Predicate("(robot_at leia bedroom)")));
+  ASSERT_EQ(problem_expert.getFunctions().size(), 1u);
+  ASSERT_EQ(
+    problem_expert.getFunction("(room_distance kitchen bedroom)").value().value, 20.0);
+}
+
+TEST(problem_expert, add_problem_subtype_objects)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_simple.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  // tele_room is a room_with_teleporter, a subtype of the room of robot_at and room_distance
+  ASSERT_TRUE(
+    problem_expert.addProblem(
+      "( define ( problem problem_1 )\n( :domain simple )\n"
+      "( :objects leia - robot kitchen - room tele_room - room_with_teleporter )\n"
+      "( :init ( robot_at leia tele_room ) ( is_teleporter_enabled tele_room )\n"
+      "( = ( room_distance kitchen tele_room ) 10 ) )\n"
+      "( :goal ( and ( robot_at leia kitchen ) ) )\n)\n"));
+
+  ASSERT_EQ(problem_expert.getInstances().size(), 3u);
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_TRUE(
+    problem_expert.existPredicate(plansys2::Predicate("(robot_at leia tele_room)")));
+  ASSERT_TRUE(
+    problem_expert.existPredicate(plansys2::Predicate("(is_teleporter_enabled tele_room)")));
+  ASSERT_EQ(
+    problem_expert.getFunction("(room_distance kitchen tele_room)").value().value, 10.0);
+}
+
 TEST(problem_expert, is_goal_satisfied)
 {
   std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
@@ -672,6 +1035,313 @@ TEST(problem_expert, is_goal_satisfied)
   ASSERT_TRUE(problem_expert.isGoalSatisfied(goal));
 }
 
+TEST(problem_expert, snapshots)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+
+  auto instances = problem_expert.getInstancesSnapshot();
+  auto predicates = problem_expert.getPredicatesSnapshot();
+  auto functions = problem_expert.getFunctionsSnapshot();
+
+  // Reads without changes in between share the same snapshot
+  ASSERT_EQ(problem_expert.getInstancesSnapshot(), instances);
+  ASSERT_EQ(problem_expert.getPredicatesSnapshot(), predicates);
+  ASSERT_EQ(problem_expert.getFunctionsSnapshot(), functions);
+
+  // A change creates a new version only of the changed items
+  ASSERT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_NE(problem_expert.getPredicatesSnapshot(), predicates);
+  ASSERT_EQ(problem_expert.getFunctionsSnapshot(), functions);
+  ASSERT_TRUE(problem_expert.getPredicatesSnapshot()->empty());
+
+  // Old snapshots are not modified
+  ASSERT_EQ(predicates->size(), 1u);
+  ASSERT_EQ(parser::pddl::toString((*predicates)[0]), "(robot_at r2d2 wp1)");
+  ASSERT_EQ((*predicates)[0].parameters[1].type, "waypoint");
+
+  ASSERT_TRUE(problem_expert.updateFunction(plansys2::Function("(= (speed r2d2) 2.0)")));
+  ASSERT_EQ((*functions)[0].value, 1.0);
+  ASSERT_EQ((*problem_expert.getFunctionsSnapshot())[0].value, 2.0);
+
+  // Instances that no fact refers to do not change the facts
+  predicates = problem_expert.getPredicatesSnapshot();
+  functions = problem_expert.getFunctionsSnapshot();
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp2", "waypoint")));
+  ASSERT_EQ(problem_expert.getPredicatesSnapshot(), predicates);
+  ASSERT_EQ(problem_expert.getFunctionsSnapshot(), functions);
+
+  // Removing an instance removes the facts that refer to it, and only those change
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_EQ(instances->size(), 2u);
+  ASSERT_EQ(problem_expert.getInstancesSnapshot()->size(), 1u);
+  ASSERT_EQ(problem_expert.getPredicatesSnapshot(), predicates);
+  ASSERT_NE(problem_expert.getFunctionsSnapshot(), functions);
+  ASSERT_TRUE(problem_expert.getFunctionsSnapshot()->empty());
+
+  ASSERT_TRUE(problem_expert.clearKnowledge());
+  ASSERT_TRUE(problem_expert.getInstancesSnapshot()->empty());
+  ASSERT_EQ(instances->size(), 2u);
+}
+
+TEST(problem_expert, set_function_values)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  problem_expert.setDeltaTracking(true);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("c3po", "robot")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed r2d2) 1.0)")));
+  ASSERT_TRUE(problem_expert.addFunction(plansys2::Function("(= (speed c3po) 2.0)")));
+  problem_expert.takeDelta();
+
+  auto function = [](const std::string & expr) {
+      return plansys2::toGroundedFact(plansys2::Function(expr));
+    };
+
+  auto revision = problem_expert.getRevision();
+  ASSERT_EQ(
+    problem_expert.setFunctionValues(
+      {function("(= (speed r2d2) 3.0)"), function("(= (speed c3po) 2.0)"),
+        function("(= (max_range r2d2) 5.0)")}), 1u);
+  ASSERT_GT(problem_expert.getRevision(), revision);
+  ASSERT_EQ(problem_expert.getFunction("(speed r2d2)").value().value, 3.0);
+  ASSERT_EQ(problem_expert.getFunction("(speed c3po)").value().value, 2.0);
+  ASSERT_FALSE(problem_expert.existFunction(plansys2::Function("(= (max_range r2d2) 5.0)")));
+
+  // Changed values are moved to the end, as with updateFunction
+  auto functions = problem_expert.getFunctions();
+  ASSERT_EQ(functions.size(), 2u);
+  ASSERT_EQ(parser::pddl::toString(functions[1]), "(speed r2d2)");
+
+  auto delta = problem_expert.takeDelta();
+  ASSERT_EQ(delta.added_functions.size(), 1u);
+  ASSERT_EQ(delta.added_functions[0].value, 3.0);
+
+  revision = problem_expert.getRevision();
+  ASSERT_EQ(problem_expert.setFunctionValues({function("(= (speed r2d2) 3.0)")}), 0u);
+  ASSERT_EQ(problem_expert.getRevision(), revision);
+}
+
+TEST(problem_expert, add_facts)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+
+  auto fact = [](const std::string & expr) {
+      return plansys2::toGroundedFact(plansys2::Predicate(expr));
+    };
+  auto function = [](const std::string & expr) {
+      return plansys2::toGroundedFact(plansys2::Function(expr));
+    };
+
+  std::vector<plansys2::Instance> instances {
+    plansys2::Instance("wp1", "waypoint"), plansys2::Instance("wp2", "waypoint")};
+  std::vector<plansys2::GroundedFact> predicates {
+    fact("(robot_at r2d2 wp1)"), fact("(connected wp1 wp2)"), fact("(connected wp1 wp2)")};
+  std::vector<plansys2::GroundedFact> functions {function("(= (distance wp1 wp2) 10.0)")};
+
+  // Nothing is added if anything is not valid
+  auto bad_predicates = predicates;
+  bad_predicates.push_back(fact("(robot_at wp1 r2d2)"));
+  ASSERT_FALSE(problem_expert.addFacts(instances, bad_predicates, functions));
+  ASSERT_FALSE(problem_expert.addFacts(instances, predicates, {function("(= (speed wp1) 1.0)")}));
+  ASSERT_FALSE(problem_expert.addFacts(instances, {fact("(robot_at r2d2 wp3)")}, {}));
+  ASSERT_FALSE(problem_expert.addFacts(instances, {fact("(robot_at r2d2)")}, {}));
+  ASSERT_FALSE(problem_expert.addFacts(instances, {fact("(unknown wp1)")}, {}));
+  ASSERT_FALSE(problem_expert.addFacts({plansys2::Instance("r2d2", "robot")}, {}, {}));
+  ASSERT_FALSE(problem_expert.addFacts({plansys2::Instance("wp3", "unknown")}, {}, {}));
+  ASSERT_EQ(problem_expert.getInstances().size(), 1u);
+  ASSERT_TRUE(problem_expert.getPredicates().empty());
+
+  ASSERT_TRUE(problem_expert.addFacts(instances, predicates, functions));
+  ASSERT_EQ(problem_expert.getInstances().size(), 3u);
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_TRUE(problem_expert.existPredicate(plansys2::Predicate("(connected wp1 wp2)")));
+  ASSERT_EQ(problem_expert.getFunction("(distance wp1 wp2)").value().value, 10.0);
+  ASSERT_EQ(
+    problem_expert.getPredicate("(robot_at r2d2 wp1)").value().parameters[1].type, "waypoint");
+
+  // Existing facts are kept, and existing functions get the new value
+  ASSERT_TRUE(
+    problem_expert.addFacts(
+      {}, {fact("(robot_at r2d2 wp1)")}, {function("(= (distance wp1 wp2) 20.0)")}));
+  ASSERT_EQ(problem_expert.getPredicates().size(), 2u);
+  ASSERT_EQ(problem_expert.getFunction("(distance wp1 wp2)").value().value, 20.0);
+
+  // Facts of removed instances go with them
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp1", "waypoint")));
+  ASSERT_TRUE(problem_expert.getPredicates().empty());
+  ASSERT_TRUE(problem_expert.getFunctions().empty());
+}
+
+TEST(problem_expert, query_predicates)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("c3po", "robot")));
+  for (int i = 1; i <= 4; i++) {
+    ASSERT_TRUE(
+      problem_expert.addInstance(plansys2::Instance("wp" + std::to_string(i), "waypoint")));
+  }
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at c3po wp2)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp1 wp3)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp3 wp1)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp2 wp3)")));
+  ASSERT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(connected wp4 wp4)")));
+
+  auto query = [&](const std::string & pattern) {
+      std::vector<std::string> ret;
+      for (const auto & match : problem_expert.queryPredicates(plansys2::Predicate(pattern))) {
+        ret.push_back(parser::pddl::toString(match));
+      }
+      std::sort(ret.begin(), ret.end());
+      return ret;
+    };
+
+  using Matches = std::vector<std::string>;
+  ASSERT_EQ(query("(robot_at r2d2 ?wp)"), Matches({"(robot_at r2d2 wp1)"}));
+  ASSERT_EQ(query("(robot_at ?r ?wp)"), Matches({"(robot_at c3po wp2)", "(robot_at r2d2 wp1)"}));
+  ASSERT_EQ(
+    query("(connected ?from wp3)"), Matches({"(connected wp1 wp3)", "(connected wp2 wp3)"}));
+  ASSERT_EQ(query("(connected wp3 wp1)"), Matches({"(connected wp3 wp1)"}));
+  ASSERT_EQ(query("(connected ?wp ?wp)"), Matches({"(connected wp4 wp4)"}));
+  ASSERT_TRUE(query("(connected wp1 wp2)").empty());
+  ASSERT_TRUE(query("(connected unknown ?wp)").empty());
+  ASSERT_TRUE(query("(patrolled ?wp)").empty());
+  ASSERT_TRUE(query("(unknown ?wp)").empty());
+  ASSERT_TRUE(query("(robot_at ?r)").empty());
+
+  // The types of the arguments are set as in getPredicates
+  auto matches = problem_expert.queryPredicates(plansys2::Predicate("(robot_at ?r wp2)"));
+  ASSERT_EQ(matches.size(), 1u);
+  ASSERT_EQ(matches[0].parameters[0].type, "robot");
+
+  // Pages of the same query do not overlap while the knowledge does not change
+  std::size_t total;
+  std::vector<std::string> pages;
+  for (std::size_t offset = 0; offset < 4; offset += 3) {
+    auto page = problem_expert.queryPredicates(
+      plansys2::Predicate("(connected ?from ?to)"), offset, 3, &total);
+    ASSERT_EQ(total, 4u);
+    ASSERT_EQ(page.size(), offset == 0 ? 3u : 1u);
+    for (const auto & match : page) {
+      pages.push_back(parser::pddl::toString(match));
+    }
+  }
+  std::sort(pages.begin(), pages.end());
+  ASSERT_EQ(pages, query("(connected ?from ?to)"));
+  ASSERT_TRUE(
+    problem_expert.queryPredicates(plansys2::Predicate("(connected ?a ?b)"), 4, 3).empty());
+
+  // The indexes follow the removals
+  ASSERT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(connected wp1 wp3)")));
+  ASSERT_EQ(query("(connected ?from wp3)"), Matches({"(connected wp2 wp3)"}));
+  ASSERT_TRUE(problem_expert.removeInstance(plansys2::Instance("wp3", "waypoint")));
+  ASSERT_EQ(query("(connected ?from ?to)"), Matches({"(connected wp4 wp4)"}));
+  ASSERT_TRUE(problem_expert.clearKnowledge());
+  ASSERT_TRUE(query("(robot_at ?r ?wp)").empty());
+}
+
+TEST(problem_expert, concurrent_readers)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  std::ifstream domain_ifs(pkgpath + "/pddl/domain_charging.pddl");
+  std::string domain_str((
+      std::istreambuf_iterator<char>(domain_ifs)),
+    std::istreambuf_iterator<char>());
+
+  auto domain_expert = std::make_shared<plansys2::DomainExpert>(domain_str);
+  plansys2::ProblemExpert problem_expert(domain_expert);
+
+  ASSERT_TRUE(problem_expert.addInstance(plansys2::Instance("r2d2", "robot")));
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(
+      problem_expert.addInstance(plansys2::Instance("wp" + std::to_string(i), "waypoint")));
+  }
+  for (int i = 1; i < 20; i++) {
+    ASSERT_TRUE(
+      problem_expert.addPredicate(
+        plansys2::Predicate("(connected wp0 wp" + std::to_string(i) + ")")));
+  }
+
+  // Same discipline as ProblemExpertNode: shared for queries, exclusive for updates
+  std::shared_mutex mutex;
+  std::atomic<int> errors {0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back(
+      [&]() {
+        // A fixed number of reads, as std::shared_mutex may starve the writer
+        for (int j = 0; j < 500; j++) {
+          std::shared_lock<std::shared_mutex> lock(mutex);
+          auto predicates = problem_expert.getPredicatesSnapshot();
+          bool robot_at = problem_expert.existPredicate(
+            plansys2::Predicate("(robot_at r2d2 wp0)"));
+          if (!problem_expert.existPredicate(plansys2::Predicate("(connected wp0 wp5)")) ||
+          predicates->size() != (robot_at ? 20u : 19u) ||
+          !problem_expert.getPredicate("(connected wp0 wp19)").has_value() ||
+          problem_expert.getInstances().size() != 21u)
+          {
+            errors++;
+          }
+        }
+      });
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (i % 2 == 0) {
+      EXPECT_TRUE(problem_expert.addPredicate(plansys2::Predicate("(robot_at r2d2 wp0)")));
+    } else {
+      EXPECT_TRUE(problem_expert.removePredicate(plansys2::Predicate("(robot_at r2d2 wp0)")));
+    }
+  }
+
+  for (auto & reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_EQ(errors, 0);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,136 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "ament_index_cpp/get_package_share_directory.hpp"
+
+#include "gtest/gtest.h"
+
+#include "plansys2_domain_expert/DomainExpert.hpp"
+#include "plansys2_problem_expert/ProblemExpert.hpp"
+#include "plansys2_problem_expert/ProblemStateFile.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+
+std::string readFile(const std::string & path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string & path, const std::string & data)
+{
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs << data;
+}
+
+std::shared_ptr<plansys2::DomainExpert> getDomainExpert(const std::string & domain)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  return std::make_shared<plansys2::DomainExpert>(readFile(pkgpath + "/pddl/" + domain));
+}
+
+std::string getStatePath()
+{
+  return (std::filesystem::temp_directory_path() / "plansys2_problem_state_test.bin").string();
+}
+
+TEST(problem_state_file, write_and_load)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  auto domain_expert = getDomainExpert("domain_charging.pddl");
+  auto path = getStatePath();
+
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  ASSERT_TRUE(problem_expert.addProblem(readFile(pkgpath + "/pddl/problem_charging.pddl")));
+  ASSERT_TRUE(plansys2::ProblemStateFile::write(path, problem_expert));
+
+  plansys2::ProblemExpert loaded(domain_expert);
+  ASSERT_TRUE(plansys2::ProblemStateFile::load(path, loaded));
+
+  ASSERT_EQ(loaded.getInstances(), problem_expert.getInstances());
+  ASSERT_EQ(loaded.getPredicates(), problem_expert.getPredicates());
+  ASSERT_EQ(loaded.getFunctions(), problem_expert.getFunctions());
+  ASSERT_EQ(
+    parser::pddl::toString(loaded.getGoal()),
+    parser::pddl::toString(problem_expert.getGoal()));
+  ASSERT_EQ(loaded.getFunction("(speed r2d2)").value().value, 3.0);
+
+  // The file adds to the existing knowledge, so loading it again is not valid
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, loaded));
+  ASSERT_EQ(loaded.getInstances(), problem_expert.getInstances());
+
+  std::filesystem::remove(path);
+}
+
+TEST(problem_state_file, invalid_files)
+{
+  std::string pkgpath = ament_index_cpp::get_package_share_directory("plansys2_problem_expert");
+  auto domain_expert = getDomainExpert("domain_charging.pddl");
+  auto path = getStatePath();
+
+  plansys2::ProblemExpert problem_expert(domain_expert);
+  ASSERT_TRUE(problem_expert.addProblem(readFile(pkgpath + "/pddl/problem_charging.pddl")));
+  ASSERT_TRUE(plansys2::ProblemStateFile::write(path, problem_expert));
+  auto data = readFile(path);
+
+  plansys2::ProblemExpert loaded(domain_expert);
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path + ".missing", loaded));
+
+  writeFile(path, data.substr(0, data.size() - 1));
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, loaded));
+
+  writeFile(path, data.substr(0, 20));
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, loaded));
+
+  auto bad_magic = data;
+  bad_magic[0] = 'X';
+  writeFile(path, bad_magic);
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, loaded));
+
+  // Symbol index out of range in the first instance, which follows the header (48 bytes),
+  // the symbol offsets and the function values
+  uint32_t n_symbols, n_functions;
+  std::memcpy(&n_symbols, data.data() + 12, sizeof(n_symbols));
+  std::memcpy(&n_functions, data.data() + 24, sizeof(n_functions));
+  auto bad_symbol = data;
+  std::memset(&bad_symbol[48 + 8 * (n_symbols + 1) + 8 * n_functions], 0xff, 4);
+  writeFile(path, bad_symbol);
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, loaded));
+
+  ASSERT_TRUE(loaded.getInstances().empty());
+  ASSERT_TRUE(loaded.getPredicates().empty());
+  ASSERT_TRUE(loaded.getFunctions().empty());
+
+  // Valid file, but of another domain
+  auto simple_domain_expert = getDomainExpert("domain_simple.pddl");
+  plansys2::ProblemExpert simple_problem_expert(simple_domain_expert);
+  writeFile(path, data);
+  ASSERT_FALSE(plansys2::ProblemStateFile::load(path, simple_problem_expert));
+  ASSERT_TRUE(simple_problem_expert.getInstances().empty());
+  ASSERT_TRUE(simple_problem_expert.getPredicates().empty());
+
+  std::filesystem::remove(path);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
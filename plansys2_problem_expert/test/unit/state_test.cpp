@@ -0,0 +1,193 @@
+// Copyright 2021 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "plansys2_core/Types.hpp"
+#include "plansys2_pddl_parser/Utils.h"
+#include "plansys2_problem_expert/CompiledTree.hpp"
+#include "plansys2_problem_expert/State.hpp"
+#include "plansys2_problem_expert/Utils.hpp"
+
+std::vector<std::string> toStrings(const std::vector<plansys2::Predicate> & predicates)
+{
+  std::vector<std::string> ret;
+  for (const auto & predicate : predicates) {
+    ret.push_back(parser::pddl::toString(predicate));
+  }
+  return ret;
+}
+
+TEST(state, facts)
+{
+  plansys2::State state(
+    {plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)"),
+      plansys2::Predicate("(connected wp2 wp1)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+
+  ASSERT_EQ(state.getNumPredicates(), 3u);
+  ASSERT_EQ(state.getNumFunctions(), 1u);
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  ASSERT_FALSE(state.existPredicate(plansys2::Predicate("(robot_at never_seen wp1)")));
+  ASSERT_EQ(
+    state.getFunctionValue(plansys2::Function("(= (state_of_charge r2d2) 0)")), 100.0);
+  ASSERT_FALSE(state.getFunctionValue(plansys2::Function("(= (speed r2d2) 0)")).has_value());
+
+  state.removePredicate(plansys2::toGroundedFact(plansys2::Predicate("(connected wp1 wp2)")));
+  state.addPredicate(plansys2::toGroundedFact(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  state.addPredicate(plansys2::toGroundedFact(plansys2::Predicate("(robot_at r2d2 wp2)")));
+  state.setFunctionValue(plansys2::toGroundedFact(plansys2::Function("(speed r2d2)")), 3);
+
+  // In insertion order, as the vectors of predicates
+  ASSERT_EQ(
+    toStrings(state.getPredicates()),
+    std::vector<std::string>(
+      {"(robot_at r2d2 wp1)", "(connected wp2 wp1)", "(robot_at r2d2 wp2)"}));
+  ASSERT_EQ(state.getNumFunctions(), 2u);
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(= (speed r2d2) 0)")), 3.0);
+}
+
+TEST(state, evaluate)
+{
+  std::vector<plansys2::Predicate> predicates {
+    plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")};
+  std::vector<plansys2::Function> functions {
+    plansys2::Function("(= (state_of_charge r2d2) 100)"),
+    plansys2::Function("(= (speed r2d2) 2)")};
+
+  std::vector<std::string> expressions {
+    "(and (robot_at r2d2 wp1) (connected wp1 wp2))",
+    "(or (robot_at r2d2 wp2) (not (connected wp2 wp1)))",
+    "(and (> (state_of_charge r2d2) 50) (< (* (speed r2d2) 10) 30))",
+    "(and (> (unknown r2d2) 1))",
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))",
+    "(and (scale-down (speed r2d2) 0))",
+    "(and (increase (unknown r2d2) 1))",
+  };
+
+  for (const auto & expression : expressions) {
+    auto tree = parser::pddl::fromString(expression);
+    for (bool apply : {false, true}) {
+      auto expected_predicates = predicates;
+      auto expected_functions = functions;
+      plansys2::State state(predicates, functions);
+      auto expected = plansys2::evaluate(tree, expected_predicates, expected_functions, apply);
+
+      ASSERT_EQ(plansys2::evaluate(tree, state, apply), expected) << expression;
+      ASSERT_EQ(toStrings(state.getPredicates()), toStrings(expected_predicates)) << expression;
+      for (const auto & function : expected_functions) {
+        ASSERT_EQ(state.getFunctionValue(function), function.value) << expression;
+      }
+
+      plansys2::State compiled_state(predicates, functions);
+      ASSERT_EQ(plansys2::CompiledTree(tree).evaluate(compiled_state, apply), expected);
+      ASSERT_EQ(toStrings(compiled_state.getPredicates()), toStrings(state.getPredicates()));
+    }
+  }
+}
+
+TEST(state, check_and_apply)
+{
+  plansys2::State state(
+    {plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+
+  auto precondition = parser::pddl::fromString("(and (robot_at r2d2 wp1) (connected wp1 wp2))");
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) (decrease (state_of_charge r2d2) 10))");
+
+  ASSERT_TRUE(plansys2::check(precondition, state));
+  auto copy = state;
+  ASSERT_TRUE(plansys2::apply(effect, copy));
+  ASSERT_FALSE(plansys2::check(precondition, copy));
+  ASSERT_TRUE(plansys2::check(precondition, state));
+  ASSERT_EQ(copy.getFunctionValue(plansys2::Function("(= (state_of_charge r2d2) 0)")), 90.0);
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(= (state_of_charge r2d2) 0)")), 100.0);
+
+  // The node id selects a subexpression
+  ASSERT_TRUE(plansys2::check(effect, copy, 3));
+  ASSERT_FALSE(plansys2::check(effect, state, 3));
+}
+
+TEST(state, vector_adapter)
+{
+  std::vector<plansys2::Predicate> predicates {
+    plansys2::Predicate("(robot_at r2d2 wp1)"), plansys2::Predicate("(connected wp1 wp2)"),
+    plansys2::Predicate("(connected wp2 wp1)")};
+  std::vector<plansys2::Function> functions {
+    plansys2::Function("(= (state_of_charge r2d2) 100)")};
+
+  // The order of the predicates is kept, and the new ones are at the end
+  ASSERT_TRUE(
+    plansys2::apply(
+      parser::pddl::fromString(
+        "(and (not (robot_at r2d2 wp1)) (robot_at r2d2 wp2) "
+        "(decrease (state_of_charge r2d2) 10))"),
+      predicates, functions));
+  ASSERT_EQ(
+    toStrings(predicates),
+    std::vector<std::string>(
+      {"(connected wp1 wp2)", "(connected wp2 wp1)", "(robot_at r2d2 wp2)"}));
+  ASSERT_EQ(functions.size(), 1u);
+  ASSERT_DOUBLE_EQ(functions[0].value, 90.0);
+}
+
+TEST(state, invalid_tree)
+{
+  plansys2::State state(
+    {plansys2::Predicate("(robot_at r2d2 wp1)")},
+    {plansys2::Function("(= (state_of_charge r2d2) 100)")});
+  std::vector<plansys2::Predicate> predicates = state.getPredicates();
+  std::vector<plansys2::Function> functions = state.getFunctions();
+
+  auto effect = parser::pddl::fromString(
+    "(and (not (robot_at r2d2 wp1)) (decrease (state_of_charge r2d2) 10))");
+  ASSERT_TRUE(plansys2::isValidTree(effect));
+  ASSERT_TRUE(plansys2::isValidTree(plansys2_msgs::msg::Tree(), 3));
+
+  std::vector<plansys2_msgs::msg::Tree> invalid_trees(4, effect);
+  invalid_trees[0].nodes[0].children.push_back(42);  // Child out of range
+  invalid_trees[1].nodes[1].children.clear();  // NOT without its child
+  invalid_trees[2].nodes[3].children.pop_back();  // Modifier with one child
+  invalid_trees[3].nodes[1].children = {0};  // NOT whose child is the root
+
+  for (const auto & tree : invalid_trees) {
+    std::string error;
+    ASSERT_FALSE(plansys2::isValidTree(tree, 0, &error));
+    ASSERT_FALSE(error.empty());
+
+    // Nothing is applied, on any kind of state
+    ASSERT_FALSE(plansys2::apply(tree, state));
+    ASSERT_FALSE(plansys2::apply(tree, predicates, functions));
+  }
+  ASSERT_FALSE(plansys2::isValidTree(effect, effect.nodes.size()));
+  ASSERT_FALSE(plansys2::check(effect, state, effect.nodes.size()));
+
+  ASSERT_TRUE(state.existPredicate(plansys2::Predicate("(robot_at r2d2 wp1)")));
+  ASSERT_EQ(state.getFunctionValue(plansys2::Function("(= (state_of_charge r2d2) 0)")), 100.0);
+  ASSERT_EQ(predicates.size(), 1u);
+  ASSERT_EQ(functions[0].value, 100.0);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}